@@ -9,11 +9,22 @@ LOCAL_SRC_FILES := $(OPTEE_CLIENT_PATH)/libs/$(TARGET_ARCH_ABI)/libteec.so
 LOCAL_EXPORT_C_INCLUDES := $(OPTEE_CLIENT_PATH)/public
 include $(PREBUILT_SHARED_LIBRARY)
 
+include $(CLEAR_VARS)
+LOCAL_MODULE := libaesperf
+LOCAL_SRC_FILES := host/aesperf.c
+LOCAL_CFLAGS := -Os -D_POSIX_C_SOURCE=200112L -D_GNU_SOURCE
+LOCAL_C_INCLUDES := $(LOCAL_PATH)/host $(LOCAL_PATH)/ta
+LOCAL_EXPORT_C_INCLUDES := $(LOCAL_PATH)/host $(LOCAL_PATH)/ta
+LOCAL_SHARED_LIBRARIES := teec
+include $(BUILD_STATIC_LIBRARY)
+
 include $(CLEAR_VARS)
 LOCAL_MODULE := aes-perf
-LOCAL_SRC_FILES := host/aes-perf.c
-LOCAL_CFLAGS := -Os -D_POSIX_C_SOURCE=200112L -DVERSION="$(VERSION)"
+LOCAL_SRC_FILES := host/aes-perf.c host/aes_ref.c host/hash_ref.c \
+	host/outliers.c host/plot.c host/results.c host/ring.c
+LOCAL_CFLAGS := -Os -D_POSIX_C_SOURCE=200112L -D_GNU_SOURCE -DVERSION="$(VERSION)"
 LOCAL_C_INCLUDES := $(LOCAL_PATH)/host $(LOCAL_PATH)/ta
+LOCAL_STATIC_LIBRARIES := libaesperf
 LOCAL_SHARED_LIBRARIES := teec
 LOCAL_LDLIBS += -lm
 include $(BUILD_EXECUTABLE)
@@ -0,0 +1,165 @@
+/*
+ * Copyright (c) 2015, Linaro Limited
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef TEE_API_H
+#define TEE_API_H
+
+#include <tee_api_defines.h>
+#include <tee_api_types.h>
+
+/*
+ * Subset of the GlobalPlatform TEE Internal API functions used by the TA, for
+ * the in-process emulation backend (CFG_TEE_EMU=y)
+ */
+
+/* Properties */
+
+TEE_Result TEE_GetPropertyAsBool(TEE_PropSetHandle propsetOrEnumerator,
+				 const char *name, bool *value);
+
+/* Memory */
+
+void *TEE_Malloc(uint32_t size, uint32_t hint);
+void TEE_Free(void *buffer);
+void TEE_MemMove(void *dest, const void *src, uint32_t size);
+
+/* Cancellation */
+
+bool TEE_GetCancellationFlag(void);
+bool TEE_UnmaskCancellation(void);
+bool TEE_MaskCancellation(void);
+
+/* Time */
+
+void TEE_GetSystemTime(TEE_Time *time);
+void TEE_GetREETime(TEE_Time *time);
+
+/* Random data */
+
+void TEE_GenerateRandom(void *randomBuffer, uint32_t randomBufferLen);
+
+/* Transient objects */
+
+TEE_Result TEE_AllocateTransientObject(uint32_t objectType,
+				       uint32_t maxObjectSize,
+				       TEE_ObjectHandle *object);
+void TEE_FreeTransientObject(TEE_ObjectHandle object);
+void TEE_ResetTransientObject(TEE_ObjectHandle object);
+TEE_Result TEE_PopulateTransientObject(TEE_ObjectHandle object,
+				       const TEE_Attribute *attrs,
+				       uint32_t attrCount);
+void TEE_InitRefAttribute(TEE_Attribute *attr, uint32_t attributeID,
+			  const void *buffer, uint32_t length);
+void TEE_InitValueAttribute(TEE_Attribute *attr, uint32_t attributeID,
+			    uint32_t a, uint32_t b);
+TEE_Result TEE_GenerateKey(TEE_ObjectHandle object, uint32_t keySize,
+			   const TEE_Attribute *params, uint32_t paramCount);
+TEE_Result TEE_GetObjectBufferAttribute(TEE_ObjectHandle object,
+					uint32_t attributeID, void *buffer,
+					uint32_t *size);
+
+/* Persistent objects and data streams */
+
+TEE_Result TEE_CreatePersistentObject(uint32_t storageID, const void *objectID,
+				      uint32_t objectIDLen, uint32_t flags,
+				      TEE_ObjectHandle attributes,
+				      const void *initialData,
+				      uint32_t initialDataLen,
+				      TEE_ObjectHandle *object);
+void TEE_CloseObject(TEE_ObjectHandle object);
+void TEE_CloseAndDeletePersistentObject(TEE_ObjectHandle object);
+TEE_Result TEE_ReadObjectData(TEE_ObjectHandle object, void *buffer,
+			      uint32_t size, uint32_t *count);
+TEE_Result TEE_WriteObjectData(TEE_ObjectHandle object, const void *buffer,
+			       uint32_t size);
+TEE_Result TEE_TruncateObjectData(TEE_ObjectHandle object, uint32_t size);
+TEE_Result TEE_SeekObjectData(TEE_ObjectHandle object, int32_t offset,
+			      TEE_Whence whence);
+
+/* Operations */
+
+TEE_Result TEE_AllocateOperation(TEE_OperationHandle *operation,
+				 uint32_t algorithm, uint32_t mode,
+				 uint32_t maxKeySize);
+void TEE_FreeOperation(TEE_OperationHandle operation);
+TEE_Result TEE_SetOperationKey(TEE_OperationHandle operation,
+			       TEE_ObjectHandle key);
+TEE_Result TEE_SetOperationKey2(TEE_OperationHandle operation,
+				TEE_ObjectHandle key1, TEE_ObjectHandle key2);
+
+/* Symmetric ciphers */
+
+void TEE_CipherInit(TEE_OperationHandle operation, const void *IV,
+		    uint32_t IVLen);
+TEE_Result TEE_CipherUpdate(TEE_OperationHandle operation,
+			    const void *srcData, uint32_t srcLen,
+			    void *destData, uint32_t *destLen);
+
+/* Message digests */
+
+void TEE_DigestUpdate(TEE_OperationHandle operation, const void *chunk,
+		      uint32_t chunkSize);
+TEE_Result TEE_DigestDoFinal(TEE_OperationHandle operation, const void *chunk,
+			     uint32_t chunkLen, void *hash, uint32_t *hashLen);
+
+/* MACs */
+
+void TEE_MACInit(TEE_OperationHandle operation, const void *IV,
+		 uint32_t IVLen);
+void TEE_MACUpdate(TEE_OperationHandle operation, const void *chunk,
+		   uint32_t chunkSize);
+TEE_Result TEE_MACComputeFinal(TEE_OperationHandle operation,
+			       const void *message, uint32_t messageLen,
+			       void *mac, uint32_t *macLen);
+
+/* Asymmetric operations and key derivation */
+
+TEE_Result TEE_AsymmetricEncrypt(TEE_OperationHandle operation,
+				 const TEE_Attribute *params,
+				 uint32_t paramCount, const void *srcData,
+				 uint32_t srcLen, void *destData,
+				 uint32_t *destLen);
+TEE_Result TEE_AsymmetricDecrypt(TEE_OperationHandle operation,
+				 const TEE_Attribute *params,
+				 uint32_t paramCount, const void *srcData,
+				 uint32_t srcLen, void *destData,
+				 uint32_t *destLen);
+TEE_Result TEE_AsymmetricSignDigest(TEE_OperationHandle operation,
+				    const TEE_Attribute *params,
+				    uint32_t paramCount, const void *digest,
+				    uint32_t digestLen, void *signature,
+				    uint32_t *signatureLen);
+TEE_Result TEE_AsymmetricVerifyDigest(TEE_OperationHandle operation,
+				      const TEE_Attribute *params,
+				      uint32_t paramCount, const void *digest,
+				      uint32_t digestLen, const void *signature,
+				      uint32_t signatureLen);
+void TEE_DeriveKey(TEE_OperationHandle operation,
+		   const TEE_Attribute *params, uint32_t paramCount,
+		   TEE_ObjectHandle derivedKey);
+
+#endif /* TEE_API_H */
@@ -0,0 +1,122 @@
+/*
+ * Copyright (c) 2015, Linaro Limited
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef TEE_API_DEFINES_H
+#define TEE_API_DEFINES_H
+
+/*
+ * Subset of the GlobalPlatform TEE Internal API constants used by the TA, for
+ * the in-process emulation backend (CFG_TEE_EMU=y). Values are those of the
+ * specification.
+ */
+
+#define TEE_HANDLE_NULL			0
+
+#define TEE_PROPSET_CURRENT_TA		((TEE_PropSetHandle)0xFFFFFFFF)
+
+#define TEE_SUCCESS			0x00000000
+#define TEE_ERROR_GENERIC		0xFFFF0000
+#define TEE_ERROR_ACCESS_DENIED		0xFFFF0001
+#define TEE_ERROR_CANCEL		0xFFFF0002
+#define TEE_ERROR_ACCESS_CONFLICT	0xFFFF0003
+#define TEE_ERROR_BAD_FORMAT		0xFFFF0005
+#define TEE_ERROR_BAD_PARAMETERS	0xFFFF0006
+#define TEE_ERROR_BAD_STATE		0xFFFF0007
+#define TEE_ERROR_ITEM_NOT_FOUND	0xFFFF0008
+#define TEE_ERROR_NOT_IMPLEMENTED	0xFFFF0009
+#define TEE_ERROR_NOT_SUPPORTED		0xFFFF000A
+#define TEE_ERROR_OUT_OF_MEMORY		0xFFFF000C
+#define TEE_ERROR_SHORT_BUFFER		0xFFFF0010
+#define TEE_ERROR_OVERFLOW		0xFFFF300F
+#define TEE_ERROR_STORAGE_NO_SPACE	0xFFFF3041
+#define TEE_ERROR_SIGNATURE_INVALID	0xFFFF3072
+
+#define TEE_PARAM_TYPE_NONE		0
+#define TEE_PARAM_TYPE_VALUE_INPUT	1
+#define TEE_PARAM_TYPE_VALUE_OUTPUT	2
+#define TEE_PARAM_TYPE_VALUE_INOUT	3
+#define TEE_PARAM_TYPE_MEMREF_INPUT	5
+#define TEE_PARAM_TYPE_MEMREF_OUTPUT	6
+#define TEE_PARAM_TYPE_MEMREF_INOUT	7
+
+#define TEE_PARAM_TYPES(t0, t1, t2, t3) \
+	((t0) | ((t1) << 4) | ((t2) << 8) | ((t3) << 12))
+#define TEE_PARAM_TYPE_GET(t, i) (((t) >> ((i) * 4)) & 0xF)
+
+#define TEE_MALLOC_FILL_ZERO		0x00000000
+
+#define TEE_MODE_ENCRYPT		0
+#define TEE_MODE_DECRYPT		1
+#define TEE_MODE_SIGN			2
+#define TEE_MODE_VERIFY			3
+#define TEE_MODE_MAC			4
+#define TEE_MODE_DIGEST			5
+#define TEE_MODE_DERIVE			6
+
+#define TEE_ALG_AES_ECB_NOPAD		0x10000010
+#define TEE_ALG_AES_CBC_NOPAD		0x10000110
+#define TEE_ALG_AES_CTR			0x10000210
+#define TEE_ALG_AES_XTS			0x10000410
+#define TEE_ALG_HMAC_SHA256		0x30000004
+#define TEE_ALG_AES_CMAC		0x30000610
+#define TEE_ALG_SHA1			0x50000002
+#define TEE_ALG_SHA256			0x50000004
+#define TEE_ALG_SHA512			0x50000006
+#define TEE_ALG_RSASSA_PKCS1_V1_5_SHA256	0x70004830
+#define TEE_ALG_RSAES_PKCS1_OAEP_MGF1_SHA256	0x60410230
+#define TEE_ALG_ECDSA_P256		0x70003041
+#define TEE_ALG_ECDSA_P384		0x70004041
+#define TEE_ALG_ECDH_P256		0x80003042
+
+#define TEE_TYPE_AES			0xA0000010
+#define TEE_TYPE_HMAC_SHA256		0xA0000004
+#define TEE_TYPE_GENERIC_SECRET		0xA0000000
+#define TEE_TYPE_RSA_KEYPAIR		0xA1000030
+#define TEE_TYPE_ECDSA_KEYPAIR		0xA1000041
+#define TEE_TYPE_ECDH_KEYPAIR		0xA1000042
+#define TEE_TYPE_DATA			0xA00000BF
+
+#define TEE_STORAGE_PRIVATE		0x00000001
+
+#define TEE_DATA_FLAG_ACCESS_READ	0x00000001
+#define TEE_DATA_FLAG_ACCESS_WRITE	0x00000002
+#define TEE_DATA_FLAG_ACCESS_WRITE_META	0x00000004
+#define TEE_DATA_FLAG_SHARE_READ	0x00000010
+#define TEE_DATA_FLAG_SHARE_WRITE	0x00000020
+#define TEE_DATA_FLAG_OVERWRITE		0x00000400
+
+#define TEE_OBJECT_ID_MAX_LEN		64
+
+#define TEE_ATTR_SECRET_VALUE		0xC0000000
+#define TEE_ATTR_ECC_PUBLIC_VALUE_X	0xD0000141
+#define TEE_ATTR_ECC_PUBLIC_VALUE_Y	0xD0000241
+#define TEE_ATTR_ECC_CURVE		0xF0000441
+
+#define TEE_ECC_CURVE_NIST_P256		0x00000003
+#define TEE_ECC_CURVE_NIST_P384		0x00000004
+
+#endif /* TEE_API_DEFINES_H */
@@ -0,0 +1,334 @@
+/*
+ * Copyright (c) 2015, Linaro Limited
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * In-process emulation of the TEE Client API (CFG_TEE_EMU=y)
+ *
+ * Sessions call the entry points of the TA, which is linked into the same
+ * binary. Shared memory is plain page-aligned memory. Each invocation can be
+ * made more expensive with a busy-wait of TEE_EMU_DELAY_NS nanoseconds
+ * (environment variable) to model the cost of a world switch round trip.
+ *
+ * Both variants of the TA are served by the same code. For the multi-instance
+ * one, a new instance is created for each session; for the single-instance
+ * one (TA_AES_PERF_SI_UUID), the instance is created by the first session and
+ * kept until the process exits. The TA tells the variants apart with the
+ * gpd.ta.singleInstance property. There is only one copy of the global
+ * variables of the TA in both cases, and calls into the TA are serialized
+ * like a real TEE does for a single instance. The world switch delay is spent
+ * outside of the lock.
+ *
+ * TEEC_RequestCancellation() sets a flag in the operation, which the TA sees
+ * through TEE_GetCancellationFlag() once it has unmasked cancellation. Like
+ * with libteec, requests made while the operation is not being invoked are
+ * dropped.
+ */
+
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <tee_client_api.h>
+#include <tee_internal_api.h>
+#include <tee_ta_api.h>
+#include "ta_aes_perf.h"
+
+static uint64_t switch_delay_ns;
+static pthread_mutex_t ta_lock = PTHREAD_MUTEX_INITIALIZER;
+static int si_created;		/* The single instance exists */
+
+static uint64_t now_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+static void world_switch(void)
+{
+	uint64_t end;
+
+	if (!switch_delay_ns)
+		return;
+	end = now_ns() + switch_delay_ns;
+	while (now_ns() < end)
+		;
+}
+
+/* Convert client parameters into TA parameters */
+static TEEC_Result to_tee_params(TEEC_Operation *op, uint32_t *types,
+				 TEE_Param *params)
+{
+	TEEC_SharedMemory *shm;
+	uint32_t t[TEEC_CONFIG_PAYLOAD_REF_COUNT];
+	int i;
+
+	memset(params, 0, 4 * sizeof(*params));
+	for (i = 0; i < TEEC_CONFIG_PAYLOAD_REF_COUNT; i++) {
+		t[i] = op ? TEEC_PARAM_TYPE_GET(op->paramTypes, i) : TEEC_NONE;
+		switch (t[i]) {
+		case TEEC_NONE:
+			break;
+		case TEEC_VALUE_INPUT:
+		case TEEC_VALUE_OUTPUT:
+		case TEEC_VALUE_INOUT:
+			params[i].value.a = op->params[i].value.a;
+			params[i].value.b = op->params[i].value.b;
+			break;
+		case TEEC_MEMREF_TEMP_INPUT:
+		case TEEC_MEMREF_TEMP_OUTPUT:
+		case TEEC_MEMREF_TEMP_INOUT:
+			params[i].memref.buffer = op->params[i].tmpref.buffer;
+			params[i].memref.size = op->params[i].tmpref.size;
+			break;
+		case TEEC_MEMREF_WHOLE:
+			shm = op->params[i].memref.parent;
+			params[i].memref.buffer = shm->buffer;
+			params[i].memref.size = shm->size;
+			if (shm->flags == TEEC_MEM_INPUT)
+				t[i] = TEE_PARAM_TYPE_MEMREF_INPUT;
+			else if (shm->flags == TEEC_MEM_OUTPUT)
+				t[i] = TEE_PARAM_TYPE_MEMREF_OUTPUT;
+			else
+				t[i] = TEE_PARAM_TYPE_MEMREF_INOUT;
+			break;
+		case TEEC_MEMREF_PARTIAL_INPUT:
+		case TEEC_MEMREF_PARTIAL_OUTPUT:
+		case TEEC_MEMREF_PARTIAL_INOUT:
+			shm = op->params[i].memref.parent;
+			if (op->params[i].memref.offset +
+			    op->params[i].memref.size > shm->size)
+				return TEEC_ERROR_BAD_PARAMETERS;
+			params[i].memref.buffer = (uint8_t *)shm->buffer +
+						  op->params[i].memref.offset;
+			params[i].memref.size = op->params[i].memref.size;
+			t[i] = t[i] - TEEC_MEMREF_PARTIAL_INPUT +
+			       TEE_PARAM_TYPE_MEMREF_INPUT;
+			break;
+		default:
+			return TEEC_ERROR_BAD_PARAMETERS;
+		}
+	}
+	*types = TEE_PARAM_TYPES(t[0], t[1], t[2], t[3]);
+	return TEEC_SUCCESS;
+}
+
+/* Copy output values and sizes back to the client parameters */
+static void from_tee_params(TEEC_Operation *op, TEE_Param *params)
+{
+	int i;
+
+	if (!op)
+		return;
+	for (i = 0; i < TEEC_CONFIG_PAYLOAD_REF_COUNT; i++) {
+		switch (TEEC_PARAM_TYPE_GET(op->paramTypes, i)) {
+		case TEEC_VALUE_OUTPUT:
+		case TEEC_VALUE_INOUT:
+			op->params[i].value.a = params[i].value.a;
+			op->params[i].value.b = params[i].value.b;
+			break;
+		case TEEC_MEMREF_TEMP_OUTPUT:
+		case TEEC_MEMREF_TEMP_INOUT:
+			op->params[i].tmpref.size = params[i].memref.size;
+			break;
+		case TEEC_MEMREF_PARTIAL_OUTPUT:
+		case TEEC_MEMREF_PARTIAL_INOUT:
+			op->params[i].memref.size = params[i].memref.size;
+			break;
+		default:
+			break;
+		}
+	}
+}
+
+/* The operation is being invoked, from the world switch on */
+static void op_start(TEEC_Operation *op)
+{
+	if (op)
+		__atomic_store_n(&op->cancel, EMU_CANCEL_RUNNING,
+				 __ATOMIC_RELAXED);
+}
+
+static void op_end(TEEC_Operation *op)
+{
+	if (op)
+		__atomic_store_n(&op->cancel, EMU_CANCEL_IDLE,
+				 __ATOMIC_RELAXED);
+}
+
+TEEC_Result TEEC_InitializeContext(const char *name, TEEC_Context *context)
+{
+	const char *s = getenv("TEE_EMU_DELAY_NS");
+
+	(void)name;
+	if (s)
+		switch_delay_ns = strtoull(s, NULL, 0);
+	context->fd = -1;
+	return TEEC_SUCCESS;
+}
+
+void TEEC_FinalizeContext(TEEC_Context *context)
+{
+	(void)context;
+}
+
+TEEC_Result TEEC_OpenSession(TEEC_Context *context, TEEC_Session *session,
+			     const TEEC_UUID *destination,
+			     uint32_t connectionMethod,
+			     const void *connectionData,
+			     TEEC_Operation *operation,
+			     uint32_t *returnOrigin)
+{
+	static const TEEC_UUID ta_uuid = TA_AES_PERF_UUID;
+	static const TEEC_UUID ta_si_uuid = TA_AES_PERF_SI_UUID;
+	TEE_Param params[4];
+	uint32_t types;
+	TEEC_Result res = TEE_SUCCESS;
+	int single;
+
+	(void)connectionMethod;
+	(void)connectionData;
+
+	if (returnOrigin)
+		*returnOrigin = TEEC_ORIGIN_API;
+	if (!memcmp(destination, &ta_uuid, sizeof(ta_uuid)))
+		single = 0;
+	else if (!memcmp(destination, &ta_si_uuid, sizeof(ta_si_uuid)))
+		single = 1;
+	else
+		return TEEC_ERROR_ITEM_NOT_FOUND;
+	res = to_tee_params(operation, &types, params);
+	if (res != TEEC_SUCCESS)
+		return res;
+
+	if (returnOrigin)
+		*returnOrigin = TEEC_ORIGIN_TRUSTED_APP;
+	op_start(operation);
+	world_switch();
+	pthread_mutex_lock(&ta_lock);
+	emu_enter_ta(operation ? &operation->cancel : NULL, single);
+	if (!single || !si_created)
+		res = TA_CreateEntryPoint();
+	if (res == TEE_SUCCESS) {
+		if (single)
+			si_created = 1;
+		res = TA_OpenSessionEntryPoint(types, params,
+					       &session->ta_ctx);
+		if (res != TEE_SUCCESS && !single)
+			TA_DestroyEntryPoint();
+	}
+	pthread_mutex_unlock(&ta_lock);
+	op_end(operation);
+	if (res != TEE_SUCCESS)
+		return res;
+	from_tee_params(operation, params);
+	session->ctx = context;
+	session->single = single;
+	return TEEC_SUCCESS;
+}
+
+void TEEC_CloseSession(TEEC_Session *session)
+{
+	world_switch();
+	pthread_mutex_lock(&ta_lock);
+	emu_enter_ta(NULL, session->single);
+	TA_CloseSessionEntryPoint(session->ta_ctx);
+	if (!session->single)
+		TA_DestroyEntryPoint();
+	pthread_mutex_unlock(&ta_lock);
+}
+
+TEEC_Result TEEC_InvokeCommand(TEEC_Session *session, uint32_t commandID,
+			       TEEC_Operation *operation,
+			       uint32_t *returnOrigin)
+{
+	TEE_Param params[4];
+	uint32_t types;
+	TEEC_Result res;
+
+	if (returnOrigin)
+		*returnOrigin = TEEC_ORIGIN_API;
+	res = to_tee_params(operation, &types, params);
+	if (res != TEEC_SUCCESS)
+		return res;
+
+	if (returnOrigin)
+		*returnOrigin = TEEC_ORIGIN_TRUSTED_APP;
+	op_start(operation);
+	world_switch();
+	pthread_mutex_lock(&ta_lock);
+	if (operation)
+		operation->session = session;
+	emu_enter_ta(operation ? &operation->cancel : NULL, session->single);
+	res = TA_InvokeCommandEntryPoint(session->ta_ctx, commandID, types,
+					 params);
+	pthread_mutex_unlock(&ta_lock);
+	op_end(operation);
+	from_tee_params(operation, params);
+	return res;
+}
+
+TEEC_Result TEEC_RegisterSharedMemory(TEEC_Context *context,
+				      TEEC_SharedMemory *sharedMem)
+{
+	(void)context;
+	sharedMem->allocated = 0;
+	return TEEC_SUCCESS;
+}
+
+TEEC_Result TEEC_AllocateSharedMemory(TEEC_Context *context,
+				      TEEC_SharedMemory *sharedMem)
+{
+	size_t sz = sharedMem->size ? sharedMem->size : 1;
+
+	(void)context;
+	if (posix_memalign(&sharedMem->buffer, sysconf(_SC_PAGESIZE), sz))
+		return TEEC_ERROR_OUT_OF_MEMORY;
+	sharedMem->allocated = 1;
+	return TEEC_SUCCESS;
+}
+
+void TEEC_RequestCancellation(TEEC_Operation *operation)
+{
+	int running = EMU_CANCEL_RUNNING;
+
+	__atomic_compare_exchange_n(&operation->cancel, &running,
+				    EMU_CANCEL_REQUESTED, false,
+				    __ATOMIC_RELAXED, __ATOMIC_RELAXED);
+}
+
+void TEEC_ReleaseSharedMemory(TEEC_SharedMemory *sharedMemory)
+{
+	if (sharedMemory->allocated)
+		free(sharedMemory->buffer);
+	sharedMemory->buffer = NULL;
+	sharedMemory->size = 0;
+	sharedMemory->allocated = 0;
+}
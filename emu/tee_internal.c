@@ -0,0 +1,779 @@
+/*
+ * Copyright (c) 2015, Linaro Limited
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * In-process emulation of the TEE Internal API (CFG_TEE_EMU=y)
+ *
+ * Only what the TA needs is implemented. Ciphers, digests and MACs are
+ * provided by the reference implementations of the host (aes_ref.c and
+ * hash_ref.c). Asymmetric keys are not supported, so the asymmetric
+ * benchmarks fail with TEE_ERROR_NOT_SUPPORTED when preparing their keys.
+ * Persistent objects are plain files in $TEE_EMU_STORAGE (default: /tmp),
+ * synced on each write like the REE FS of OP-TEE, but not encrypted.
+ * Invalid uses that would panic the TA in a real TEE abort the process.
+ */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/random.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <tee_internal_api.h>
+#include <trace.h>
+#include "aes_ref.h"
+#include "hash_ref.h"
+#include "ta_aes_perf.h"
+
+#define MAX_KEY_SIZE	128	/* Bytes (HMAC), AES keys are 32 at most */
+
+struct __TEE_ObjectHandle {
+	uint32_t type;
+	uint32_t max_size;	/* Bits */
+	uint8_t key[MAX_KEY_SIZE];
+	size_t key_len;		/* Bytes, 0 if not populated */
+	char *path;		/* Persistent objects: backing file */
+	int fd;
+	uint32_t pos;		/* Data stream position */
+};
+
+struct __TEE_OperationHandle {
+	uint32_t algo;
+	uint32_t mode;
+	uint32_t max_key_size;	/* Bits, both keys for XTS */
+	uint8_t key[MAX_KEY_SIZE];
+	uint8_t key2[MAX_KEY_SIZE];
+	size_t key_len;		/* Bytes, 0 if no key is set */
+	int initialized;
+	union {
+		struct aes_ref_ctx cipher;
+		struct hash_ref_ctx digest;
+		struct hmac_ref_ctx hmac;
+		struct cmac_ref_ctx cmac;
+	} ctx;
+};
+
+void emu_trace(int level, const char *func, int line, const char *fmt, ...)
+{
+	static int max_level = -1;
+	const char *s;
+	va_list ap;
+
+	if (max_level < 0) {
+		s = getenv("TEE_EMU_TRACE_LEVEL");
+		max_level = s ? atoi(s) : TRACE_ERROR;
+	}
+	if (level > max_level)
+		return;
+	fprintf(stderr, "%c/TA: %s:%d: ", "?EID"[level < 4 ? level : 0],
+		func, line);
+	va_start(ap, fmt);
+	vfprintf(stderr, fmt, ap);
+	va_end(ap);
+	fprintf(stderr, "\n");
+}
+
+static void emu_panic(const char *func, const char *msg)
+{
+	fprintf(stderr, "E/TA: %s: panic: %s\n", func, msg);
+	abort();
+}
+
+static int algo_to_mode(uint32_t algo)
+{
+	switch (algo) {
+	case TEE_ALG_AES_ECB_NOPAD:
+		return TA_AES_ECB;
+	case TEE_ALG_AES_CBC_NOPAD:
+		return TA_AES_CBC;
+	case TEE_ALG_AES_CTR:
+		return TA_AES_CTR;
+	case TEE_ALG_AES_XTS:
+		return TA_AES_XTS;
+	default:
+		return -1;
+	}
+}
+
+/* Hash function of a digest or HMAC algorithm, -1 for other algorithms */
+static int algo_to_hash(uint32_t algo)
+{
+	switch (algo) {
+	case TEE_ALG_SHA1:
+		return TA_SHA1;
+	case TEE_ALG_SHA256:
+	case TEE_ALG_HMAC_SHA256:
+		return TA_SHA256;
+	case TEE_ALG_SHA512:
+		return TA_SHA512;
+	default:
+		return -1;
+	}
+}
+
+static int is_mac(uint32_t algo)
+{
+	return algo == TEE_ALG_HMAC_SHA256 || algo == TEE_ALG_AES_CMAC;
+}
+
+void *TEE_Malloc(uint32_t size, uint32_t hint)
+{
+	(void)hint;
+	/* All hints zero-fill the buffer */
+	return calloc(1, size ? size : 1);
+}
+
+void TEE_Free(void *buffer)
+{
+	free(buffer);
+}
+
+void TEE_MemMove(void *dest, const void *src, uint32_t size)
+{
+	memmove(dest, src, size);
+}
+
+/*
+ * Cancellation and TA variant of the current entry point, set up by
+ * emu_enter_ta(). Each thread calling into the TA has its own.
+ */
+static __thread const int *cancel_req;
+static __thread bool cancel_masked = true;
+static __thread bool ta_single;
+
+void emu_enter_ta(const int *cancel, int single)
+{
+	cancel_req = cancel;
+	cancel_masked = true;
+	ta_single = single;
+}
+
+/* Only the instance properties of the current TA */
+TEE_Result TEE_GetPropertyAsBool(TEE_PropSetHandle propsetOrEnumerator,
+				 const char *name, bool *value)
+{
+	if (propsetOrEnumerator != TEE_PROPSET_CURRENT_TA)
+		return TEE_ERROR_ITEM_NOT_FOUND;
+	if (!strcmp(name, "gpd.ta.singleInstance") ||
+	    !strcmp(name, "gpd.ta.multiSession")) {
+		*value = ta_single;
+		return TEE_SUCCESS;
+	}
+	return TEE_ERROR_ITEM_NOT_FOUND;
+}
+
+bool TEE_GetCancellationFlag(void)
+{
+	return !cancel_masked && cancel_req &&
+	       __atomic_load_n(cancel_req, __ATOMIC_RELAXED) ==
+	       EMU_CANCEL_REQUESTED;
+}
+
+bool TEE_UnmaskCancellation(void)
+{
+	bool old = cancel_masked;
+
+	cancel_masked = false;
+	return old;
+}
+
+bool TEE_MaskCancellation(void)
+{
+	bool old = cancel_masked;
+
+	cancel_masked = true;
+	return old;
+}
+
+/* System time: CLOCK_MONOTONIC, REE time: CLOCK_REALTIME of the host */
+static void get_time(clockid_t clock, TEE_Time *time)
+{
+	struct timespec ts;
+
+	clock_gettime(clock, &ts);
+	time->seconds = ts.tv_sec;
+	time->millis = ts.tv_nsec / 1000000;
+}
+
+void TEE_GetSystemTime(TEE_Time *time)
+{
+	get_time(CLOCK_MONOTONIC, time);
+}
+
+void TEE_GetREETime(TEE_Time *time)
+{
+	get_time(CLOCK_REALTIME, time);
+}
+
+/* Random data comes from the kernel RNG of the host */
+void TEE_GenerateRandom(void *randomBuffer, uint32_t randomBufferLen)
+{
+	uint8_t *p = randomBuffer;
+	ssize_t r;
+
+	while (randomBufferLen) {
+		r = getrandom(p, randomBufferLen, 0);
+		if (r < 0)
+			emu_panic(__func__, "getrandom() failed");
+		p += r;
+		randomBufferLen -= r;
+	}
+}
+
+TEE_Result TEE_AllocateTransientObject(uint32_t objectType,
+				       uint32_t maxObjectSize,
+				       TEE_ObjectHandle *object)
+{
+	TEE_ObjectHandle o;
+
+	switch (objectType) {
+	case TEE_TYPE_AES:
+		if (maxObjectSize != 128 && maxObjectSize != 192 &&
+		    maxObjectSize != 256)
+			return TEE_ERROR_NOT_SUPPORTED;
+		break;
+	case TEE_TYPE_HMAC_SHA256:
+		if (maxObjectSize < 192 || maxObjectSize > 1024 ||
+		    maxObjectSize % 8)
+			return TEE_ERROR_NOT_SUPPORTED;
+		break;
+	default:
+		return TEE_ERROR_NOT_SUPPORTED;
+	}
+	o = calloc(1, sizeof(*o));
+	if (!o)
+		return TEE_ERROR_OUT_OF_MEMORY;
+	o->type = objectType;
+	o->max_size = maxObjectSize;
+	*object = o;
+	return TEE_SUCCESS;
+}
+
+void TEE_FreeTransientObject(TEE_ObjectHandle object)
+{
+	free(object);
+}
+
+void TEE_ResetTransientObject(TEE_ObjectHandle object)
+{
+	memset(object->key, 0, sizeof(object->key));
+	object->key_len = 0;
+}
+
+void TEE_InitRefAttribute(TEE_Attribute *attr, uint32_t attributeID,
+			  const void *buffer, uint32_t length)
+{
+	attr->attributeID = attributeID;
+	attr->content.ref.buffer = (void *)buffer;
+	attr->content.ref.length = length;
+}
+
+void TEE_InitValueAttribute(TEE_Attribute *attr, uint32_t attributeID,
+			    uint32_t a, uint32_t b)
+{
+	attr->attributeID = attributeID;
+	attr->content.value.a = a;
+	attr->content.value.b = b;
+}
+
+/* Only secret keys can be allocated, see TEE_AllocateTransientObject() */
+TEE_Result TEE_GenerateKey(TEE_ObjectHandle object, uint32_t keySize,
+			   const TEE_Attribute *params, uint32_t paramCount)
+{
+	(void)params;
+	(void)paramCount;
+	if (object->key_len)
+		emu_panic(__func__, "object already populated");
+	if (keySize > object->max_size || keySize % 8)
+		return TEE_ERROR_NOT_SUPPORTED;
+	TEE_GenerateRandom(object->key, keySize / 8);
+	object->key_len = keySize / 8;
+	return TEE_SUCCESS;
+}
+
+TEE_Result TEE_GetObjectBufferAttribute(TEE_ObjectHandle object,
+					uint32_t attributeID, void *buffer,
+					uint32_t *size)
+{
+	(void)object;
+	(void)attributeID;
+	(void)buffer;
+	(void)size;
+	/* Secret values are not extractable, and there are no public keys */
+	return TEE_ERROR_ITEM_NOT_FOUND;
+}
+
+TEE_Result TEE_PopulateTransientObject(TEE_ObjectHandle object,
+				       const TEE_Attribute *attrs,
+				       uint32_t attrCount)
+{
+	uint32_t len;
+
+	if (attrCount != 1 || attrs[0].attributeID != TEE_ATTR_SECRET_VALUE)
+		return TEE_ERROR_BAD_PARAMETERS;
+	len = attrs[0].content.ref.length;
+	if (len * 8 > object->max_size)
+		return TEE_ERROR_BAD_PARAMETERS;
+	if (object->type == TEE_TYPE_AES && len != 16 && len != 24 && len != 32)
+		return TEE_ERROR_BAD_PARAMETERS;
+	if (object->type == TEE_TYPE_HMAC_SHA256 && len < 24)
+		return TEE_ERROR_BAD_PARAMETERS;
+	memcpy(object->key, attrs[0].content.ref.buffer, len);
+	object->key_len = len;
+	return TEE_SUCCESS;
+}
+
+/* Errors of the file operations backing persistent objects */
+static TEE_Result errno_to_res(void)
+{
+	switch (errno) {
+	case ENOSPC:
+		return TEE_ERROR_STORAGE_NO_SPACE;
+	case ENOMEM:
+		return TEE_ERROR_OUT_OF_MEMORY;
+	default:
+		return TEE_ERROR_GENERIC;
+	}
+}
+
+static void check_persistent(const char *func, TEE_ObjectHandle object)
+{
+	if (!object || !object->path)
+		emu_panic(func, "not a persistent object");
+}
+
+TEE_Result TEE_CreatePersistentObject(uint32_t storageID, const void *objectID,
+				      uint32_t objectIDLen, uint32_t flags,
+				      TEE_ObjectHandle attributes,
+				      const void *initialData,
+				      uint32_t initialDataLen,
+				      TEE_ObjectHandle *object)
+{
+	static const char hex[] = "0123456789abcdef";
+	const uint8_t *id = objectID;
+	const char *dir;
+	TEE_ObjectHandle o;
+	TEE_Result res;
+	size_t len;
+	uint32_t i;
+	char *p;
+
+	if (storageID != TEE_STORAGE_PRIVATE || attributes)
+		return TEE_ERROR_NOT_SUPPORTED;
+	if (objectIDLen > TEE_OBJECT_ID_MAX_LEN)
+		emu_panic(__func__, "object ID too long");
+
+	dir = getenv("TEE_EMU_STORAGE");
+	if (!dir)
+		dir = "/tmp";
+	o = calloc(1, sizeof(*o));
+	len = strlen(dir) + 32 + 2 * objectIDLen;
+	if (o)
+		o->path = malloc(len);
+	if (!o || !o->path) {
+		free(o);
+		return TEE_ERROR_OUT_OF_MEMORY;
+	}
+	/* One namespace per process, like per-TA storage */
+	p = o->path + snprintf(o->path, len, "%s/tee-emu-%d-", dir,
+			       (int)getpid());
+	for (i = 0; i < objectIDLen; i++) {
+		*p++ = hex[id[i] >> 4];
+		*p++ = hex[id[i] & 0xf];
+	}
+	*p = '\0';
+
+	o->type = TEE_TYPE_DATA;
+	o->fd = open(o->path, O_RDWR | O_CREAT |
+		     (flags & TEE_DATA_FLAG_OVERWRITE ? O_TRUNC : O_EXCL),
+		     0600);
+	if (o->fd < 0) {
+		res = errno == EEXIST ? TEE_ERROR_ACCESS_CONFLICT :
+					errno_to_res();
+		free(o->path);
+		free(o);
+		return res;
+	}
+	if (initialDataLen) {
+		res = TEE_WriteObjectData(o, initialData, initialDataLen);
+		if (res != TEE_SUCCESS) {
+			TEE_CloseAndDeletePersistentObject(o);
+			return res;
+		}
+		o->pos = 0;
+	}
+	*object = o;
+	return TEE_SUCCESS;
+}
+
+void TEE_CloseObject(TEE_ObjectHandle object)
+{
+	if (!object)
+		return;
+	if (object->path) {
+		close(object->fd);
+		free(object->path);
+	}
+	free(object);
+}
+
+void TEE_CloseAndDeletePersistentObject(TEE_ObjectHandle object)
+{
+	if (!object)
+		return;
+	check_persistent(__func__, object);
+	unlink(object->path);
+	TEE_CloseObject(object);
+}
+
+TEE_Result TEE_ReadObjectData(TEE_ObjectHandle object, void *buffer,
+			      uint32_t size, uint32_t *count)
+{
+	ssize_t r;
+
+	check_persistent(__func__, object);
+	r = pread(object->fd, buffer, size, object->pos);
+	if (r < 0)
+		return errno_to_res();
+	object->pos += r;
+	*count = r;
+	return TEE_SUCCESS;
+}
+
+TEE_Result TEE_WriteObjectData(TEE_ObjectHandle object, const void *buffer,
+			       uint32_t size)
+{
+	const uint8_t *p = buffer;
+	ssize_t r;
+
+	check_persistent(__func__, object);
+	while (size) {
+		r = pwrite(object->fd, p, size, object->pos);
+		if (r < 0)
+			return errno_to_res();
+		object->pos += r;
+		p += r;
+		size -= r;
+	}
+	if (fdatasync(object->fd) < 0)
+		return errno_to_res();
+	return TEE_SUCCESS;
+}
+
+TEE_Result TEE_TruncateObjectData(TEE_ObjectHandle object, uint32_t size)
+{
+	check_persistent(__func__, object);
+	if (ftruncate(object->fd, size) < 0 || fdatasync(object->fd) < 0)
+		return errno_to_res();
+	return TEE_SUCCESS;
+}
+
+TEE_Result TEE_SeekObjectData(TEE_ObjectHandle object, int32_t offset,
+			      TEE_Whence whence)
+{
+	off_t end;
+	int64_t pos;
+
+	check_persistent(__func__, object);
+	switch (whence) {
+	case TEE_DATA_SEEK_SET:
+		pos = offset;
+		break;
+	case TEE_DATA_SEEK_CUR:
+		pos = (int64_t)object->pos + offset;
+		break;
+	case TEE_DATA_SEEK_END:
+		end = lseek(object->fd, 0, SEEK_END);
+		if (end < 0)
+			return errno_to_res();
+		pos = end + offset;
+		break;
+	default:
+		return TEE_ERROR_BAD_PARAMETERS;
+	}
+	if (pos < 0)
+		pos = 0;
+	if (pos > UINT32_MAX)
+		return TEE_ERROR_OVERFLOW;
+	object->pos = pos;
+	return TEE_SUCCESS;
+}
+
+TEE_Result TEE_AllocateOperation(TEE_OperationHandle *operation,
+				 uint32_t algorithm, uint32_t mode,
+				 uint32_t maxKeySize)
+{
+	TEE_OperationHandle op;
+
+	if (is_mac(algorithm)) {
+		if (mode != TEE_MODE_MAC)
+			return TEE_ERROR_NOT_SUPPORTED;
+	} else if (algo_to_hash(algorithm) >= 0) {
+		if (mode != TEE_MODE_DIGEST)
+			return TEE_ERROR_NOT_SUPPORTED;
+	} else if (algo_to_mode(algorithm) >= 0) {
+		if (mode != TEE_MODE_ENCRYPT && mode != TEE_MODE_DECRYPT)
+			return TEE_ERROR_NOT_SUPPORTED;
+	} else {
+		return TEE_ERROR_NOT_SUPPORTED;
+	}
+	op = calloc(1, sizeof(*op));
+	if (!op)
+		return TEE_ERROR_OUT_OF_MEMORY;
+	op->algo = algorithm;
+	op->mode = mode;
+	op->max_key_size = maxKeySize;
+	if (mode == TEE_MODE_DIGEST) {
+		/* Digest operations need no key nor init */
+		hash_ref_init(&op->ctx.digest, algo_to_hash(algorithm));
+		op->initialized = 1;
+	}
+	*operation = op;
+	return TEE_SUCCESS;
+}
+
+void TEE_FreeOperation(TEE_OperationHandle operation)
+{
+	free(operation);
+}
+
+TEE_Result TEE_SetOperationKey(TEE_OperationHandle operation,
+			       TEE_ObjectHandle key)
+{
+	if (operation->algo == TEE_ALG_AES_XTS)
+		emu_panic(__func__, "XTS needs TEE_SetOperationKey2()");
+	if (operation->mode == TEE_MODE_DIGEST)
+		emu_panic(__func__, "digest operations have no key");
+	if (!key->key_len || key->key_len * 8 > operation->max_key_size)
+		emu_panic(__func__, "bad key");
+	memcpy(operation->key, key->key, key->key_len);
+	operation->key_len = key->key_len;
+	operation->initialized = 0;
+	return TEE_SUCCESS;
+}
+
+TEE_Result TEE_SetOperationKey2(TEE_OperationHandle operation,
+				TEE_ObjectHandle key1, TEE_ObjectHandle key2)
+{
+	if (operation->algo != TEE_ALG_AES_XTS)
+		emu_panic(__func__, "not an XTS operation");
+	if (!key1->key_len || key1->key_len != key2->key_len ||
+	    key1->key_len * 16 > operation->max_key_size)
+		emu_panic(__func__, "bad key");
+	memcpy(operation->key, key1->key, key1->key_len);
+	memcpy(operation->key2, key2->key, key2->key_len);
+	operation->key_len = key1->key_len;
+	operation->initialized = 0;
+	return TEE_SUCCESS;
+}
+
+void TEE_CipherInit(TEE_OperationHandle operation, const void *IV,
+		    uint32_t IVLen)
+{
+	int mode = algo_to_mode(operation->algo);
+
+	if (!operation->key_len)
+		emu_panic(__func__, "no key");
+	if (mode != TA_AES_ECB && IVLen != AES_BLOCK_SIZE)
+		emu_panic(__func__, "bad IV length");
+	if (mode < 0)
+		emu_panic(__func__, "not a cipher operation");
+	aes_ref_init(&operation->ctx.cipher, mode,
+		     operation->mode == TEE_MODE_DECRYPT, operation->key,
+		     operation->key2, operation->key_len, IV);
+	operation->initialized = 1;
+}
+
+TEE_Result TEE_CipherUpdate(TEE_OperationHandle operation,
+			    const void *srcData, uint32_t srcLen,
+			    void *destData, uint32_t *destLen)
+{
+	if (algo_to_mode(operation->algo) < 0)
+		emu_panic(__func__, "not a cipher operation");
+	if (!operation->initialized)
+		emu_panic(__func__, "operation not initialized");
+	if (*destLen < srcLen) {
+		*destLen = srcLen;
+		return TEE_ERROR_SHORT_BUFFER;
+	}
+	/* Partial blocks are not buffered by the emulation */
+	if (aes_ref_update(&operation->ctx.cipher, srcData, destData, srcLen))
+		return TEE_ERROR_BAD_PARAMETERS;
+	*destLen = srcLen;
+	return TEE_SUCCESS;
+}
+
+void TEE_DigestUpdate(TEE_OperationHandle operation, const void *chunk,
+		      uint32_t chunkSize)
+{
+	if (operation->mode != TEE_MODE_DIGEST)
+		emu_panic(__func__, "not a digest operation");
+	hash_ref_update(&operation->ctx.digest, chunk, chunkSize);
+}
+
+TEE_Result TEE_DigestDoFinal(TEE_OperationHandle operation, const void *chunk,
+			     uint32_t chunkLen, void *hash, uint32_t *hashLen)
+{
+	uint32_t len = hash_ref_size(algo_to_hash(operation->algo));
+
+	if (operation->mode != TEE_MODE_DIGEST)
+		emu_panic(__func__, "not a digest operation");
+	if (*hashLen < len) {
+		*hashLen = len;
+		return TEE_ERROR_SHORT_BUFFER;
+	}
+	hash_ref_update(&operation->ctx.digest, chunk, chunkLen);
+	hash_ref_final(&operation->ctx.digest, hash);
+	*hashLen = len;
+	return TEE_SUCCESS;
+}
+
+void TEE_MACInit(TEE_OperationHandle operation, const void *IV,
+		 uint32_t IVLen)
+{
+	(void)IV;
+	(void)IVLen;
+	if (operation->mode != TEE_MODE_MAC)
+		emu_panic(__func__, "not a MAC operation");
+	if (!operation->key_len)
+		emu_panic(__func__, "no key");
+	if (operation->algo == TEE_ALG_AES_CMAC)
+		cmac_ref_init(&operation->ctx.cmac, operation->key,
+			      operation->key_len);
+	else
+		hmac_ref_init(&operation->ctx.hmac,
+			      algo_to_hash(operation->algo), operation->key,
+			      operation->key_len);
+	operation->initialized = 1;
+}
+
+void TEE_MACUpdate(TEE_OperationHandle operation, const void *chunk,
+		   uint32_t chunkSize)
+{
+	if (operation->mode != TEE_MODE_MAC || !operation->initialized)
+		emu_panic(__func__, "MAC operation not initialized");
+	if (operation->algo == TEE_ALG_AES_CMAC)
+		cmac_ref_update(&operation->ctx.cmac, chunk, chunkSize);
+	else
+		hmac_ref_update(&operation->ctx.hmac, chunk, chunkSize);
+}
+
+/* As specified, the operation must be initialized again afterwards */
+TEE_Result TEE_MACComputeFinal(TEE_OperationHandle operation,
+			       const void *message, uint32_t messageLen,
+			       void *mac, uint32_t *macLen)
+{
+	uint32_t len;
+
+	if (operation->mode != TEE_MODE_MAC || !operation->initialized)
+		emu_panic(__func__, "MAC operation not initialized");
+	if (operation->algo == TEE_ALG_AES_CMAC)
+		len = AES_BLOCK_SIZE;
+	else
+		len = hash_ref_size(algo_to_hash(operation->algo));
+	if (*macLen < len) {
+		*macLen = len;
+		return TEE_ERROR_SHORT_BUFFER;
+	}
+	TEE_MACUpdate(operation, message, messageLen);
+	if (operation->algo == TEE_ALG_AES_CMAC)
+		cmac_ref_final(&operation->ctx.cmac, mac);
+	else
+		hmac_ref_final(&operation->ctx.hmac, mac);
+	*macLen = len;
+	operation->initialized = 0;
+	return TEE_SUCCESS;
+}
+
+/*
+ * Asymmetric operations cannot be allocated (TEE_AllocateOperation() returns
+ * TEE_ERROR_NOT_SUPPORTED), so these are never reached by a correct TA
+ */
+
+TEE_Result TEE_AsymmetricEncrypt(TEE_OperationHandle operation,
+				 const TEE_Attribute *params,
+				 uint32_t paramCount, const void *srcData,
+				 uint32_t srcLen, void *destData,
+				 uint32_t *destLen)
+{
+	(void)operation;
+	(void)params;
+	(void)paramCount;
+	(void)srcData;
+	(void)srcLen;
+	(void)destData;
+	(void)destLen;
+	emu_panic(__func__, "not an asymmetric operation");
+	return TEE_ERROR_NOT_SUPPORTED;
+}
+
+TEE_Result TEE_AsymmetricDecrypt(TEE_OperationHandle operation,
+				 const TEE_Attribute *params,
+				 uint32_t paramCount, const void *srcData,
+				 uint32_t srcLen, void *destData,
+				 uint32_t *destLen)
+{
+	return TEE_AsymmetricEncrypt(operation, params, paramCount, srcData,
+				     srcLen, destData, destLen);
+}
+
+TEE_Result TEE_AsymmetricSignDigest(TEE_OperationHandle operation,
+				    const TEE_Attribute *params,
+				    uint32_t paramCount, const void *digest,
+				    uint32_t digestLen, void *signature,
+				    uint32_t *signatureLen)
+{
+	return TEE_AsymmetricEncrypt(operation, params, paramCount, digest,
+				     digestLen, signature, signatureLen);
+}
+
+TEE_Result TEE_AsymmetricVerifyDigest(TEE_OperationHandle operation,
+				      const TEE_Attribute *params,
+				      uint32_t paramCount, const void *digest,
+				      uint32_t digestLen, const void *signature,
+				      uint32_t signatureLen)
+{
+	uint32_t len = signatureLen;
+
+	return TEE_AsymmetricEncrypt(operation, params, paramCount, digest,
+				     digestLen, (void *)signature, &len);
+}
+
+void TEE_DeriveKey(TEE_OperationHandle operation,
+		   const TEE_Attribute *params, uint32_t paramCount,
+		   TEE_ObjectHandle derivedKey)
+{
+	(void)operation;
+	(void)params;
+	(void)paramCount;
+	(void)derivedKey;
+	emu_panic(__func__, "not a key derivation operation");
+}
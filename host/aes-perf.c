@@ -25,10 +25,24 @@
  * POSSIBILITY OF SUCH DAMAGE.
  */
 
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/wait.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
 #include <sys/types.h>
 #include <sys/stat.h>
+#include <ctype.h>
+#include <errno.h>
 #include <fcntl.h>
+#include <limits.h>
 #include <math.h>
+#include <pthread.h>
+#include <poll.h>
+#include <sched.h>
+#include <signal.h>
+#include <stdatomic.h>
 #include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
@@ -38,6 +52,13 @@
 #include <unistd.h>
 
 #include <tee_client_api.h>
+#include "aes_ref.h"
+#include "aesperf.h"
+#include "hash_ref.h"
+#include "outliers.h"
+#include "plot.h"
+#include "results.h"
+#include "ring.h"
 #include "ta_aes_perf.h"
 
 #define _verbose(lvl, ...)			\
@@ -55,34 +76,211 @@
  * Command line parameters
  */
 
+/*
+ * Measurement context: TEE context, main session, shared buffers, timer.
+ * The options that describe the timed invocation (-m, -k, -d, -r, -i,
+ * --final, --shm, --ta, --timer) are parsed straight into its configuration.
+ */
+static struct aesperf_ctx ap = {
+	.cfg = {
+		.mode = TA_AES_ECB,
+		.keysize = 128,
+		.size = 1024,
+		.loops = 1,
+		.shm_type = AESPERF_SHM_ALLOCATED,
+		.ta_model = AESPERF_TA_MULTI_INSTANCE,
+		.timer = AESPERF_TIMER_CLOCK,
+		.cmd = TA_AES_PERF_CMD_PROCESS,
+	},
+	.rnd = -1,
+};
+static struct aesperf_config *const cfg = &ap.cfg;
+
 static size_t size = 1024;	/* Buffer size (-s) */
 static unsigned int n = 5000;	/* Number of measurements (-n) */
 static unsigned int l = 1;	/* Inner loops (-l) */
 static int verbosity = 0;	/* Verbosity (-v) */
-static int decrypt = 0;		/* Encrypt by default, -d to decrypt */
-static int keysize = 128;	/* AES key size (-k) */
-static int mode = TA_AES_ECB;	/* AES mode (-m) */
-static int random_in = 0;	/* Get input data from /dev/urandom (-r) */
-static int in_place = 0;	/* 1: use same buffer for in and out (-i) */
+static int asym_suite;		/* Run all asymmetric benchmarks (--asym) */
 static int warmup = 2;		/* Start with a 2-second busy loop (-w) */
+static size_t llc_size;		/* Last-level cache size (--llc), 0: detect */
+static uint64_t duration;	/* Time-series run length in ns (--duration) */
+static uint64_t interval = 1000000000;	/* Time-series period (--interval) */
+static int sched_policy = -1;	/* Scheduling policy (--sched), -1: unchanged */
+static int sched_prio;		/* Real-time priority (--sched) */
+static int lock_mem;		/* Lock all memory with mlockall() (--mlock) */
+static int verify;		/* Check the output of the TA (--verify) */
+static int copy;		/* TA works on a private copy (--copy) */
+static size_t copy_chunk;	/* Size of the TA copy buffer, 0: whole buffer */
+static int rng;			/* Time TEE_GenerateRandom() instead (--rng) */
+static int size_set;		/* -s was given */
+static int n_set;		/* -n was given */
+static size_t storage_size;	/* Secure storage object size, 0: off */
+static double precision;	/* Target 95% CI half-width in % of the mean */
+static const char *scenario_file;	/* --scenario */
+static const char *cur_scenario;	/* Name of the scenario being run */
+static double outlier_pct;	/* --attribute-outliers percentile, 0: off */
+static const char *size_dist_spec;	/* --size-dist */
 
 /*
- * TEE client stuff
+ * Results store (--store): the summary of each run_test() is appended to a
+ * local file, which "aes-perf history" queries
+ */
+
+#define DEFAULT_STORE	"aes-perf.results"
+
+static const char *store_path;	/* NULL: off */
+static int store_hist;		/* Also store latency histograms */
+static int history;		/* "aes-perf history" query mode */
+static int metric;		/* Metric shown by history (--metric) */
+
+/*
+ * Charts (--plot): the results of each run_test() are kept and written as
+ * SVG charts of throughput versus size and of the latency CDF at the end,
+ * with the latest matching runs of a results store as baseline
  */
 
-static TEEC_Context ctx;
-static TEEC_Session sess;
+#define PLOT_CDF_POINTS	101	/* 0, 1, ..., 100% */
+
+struct plot_run {
+	char config[RESULTS_CONFIG_LEN];	/* See config_str() */
+	char series[64];		/* Mode, key size, variants */
+	size_t size;
+	double mib_s;
+	double cdf[PLOT_CDF_POINTS];	/* Latency in μs */
+};
+
+static const char *plot_dir;
+static const char *baseline;	/* Results store */
+static struct plot_run *plot_runs;
+static int num_plot_runs;
+
 /*
- * in_shm and out_shm are both IN/OUT to support dynamically choosing
- * in_place == 1 or in_place == 0.
+ * Exporter mode (--export): probe the TA periodically and serve the metrics
+ * in OpenMetrics text format
  */
-static TEEC_SharedMemory in_shm = {
-	.flags = TEEC_MEM_INPUT | TEEC_MEM_OUTPUT
+
+#define MAX_PROBE_MODES	(TA_AES_CMAC + 1)
+
+static const char *export_addr;		/* unix:path or tcp:[addr:]port */
+static uint64_t probe_interval = 10000000000ULL;	/* ns */
+static int probe_modes[MAX_PROBE_MODES];
+static int num_probe_modes;
+static double cpu_budget = 1;		/* Max. probe duty cycle, % */
+
+/* Request sizes of the --rng sweep, used when -s is not given */
+static const size_t rng_sizes[] = {
+	16, 64, 256, 1024, 4096, 16384, 65536, 262144, 1048576
 };
-static TEEC_SharedMemory out_shm = {
-	.flags = TEEC_MEM_INPUT | TEEC_MEM_OUTPUT
+
+#define NUM_RNG_SIZES	(sizeof(rng_sizes) / sizeof(rng_sizes[0]))
+
+static int rng_sweep;
+
+#define VERIFY_NONE		0
+#define VERIFY_OUTPUT		1	/* Compare with reference AES */
+#define VERIFY_ROUNDTRIP	2	/* Also decrypt back and compare */
+
+/*
+ * CPUs to run the test on (--cpu). The test is run on each one in turn. An
+ * empty list means no pinning.
+ */
+
+#define MAX_CPUS	64
+
+static int cpus[MAX_CPUS];
+static int num_cpus;
+
+/*
+ * Queue depths for the asynchronous mode (--qd). The test is run for each one
+ * in turn. An empty list means synchronous mode.
+ */
+
+#define MAX_QD		64
+#define MAX_QDS		16
+
+static unsigned int qds[MAX_QDS];
+static int num_qds;
+
+/*
+ * Multi-process mode (--procs): number of worker processes, 0 when off
+ */
+
+#define MAX_PROCS	256
+
+static unsigned int procs;
+
+/*
+ * Cancellation mode (--cancel): cancellations are requested after a random
+ * delay of up to cancel_delay ns (0: the median duration of an invocation)
+ */
+
+static int cancel;
+static uint64_t cancel_delay;
+
+/*
+ * Streaming mode (--total): process a total volume of data through a shared
+ * memory window of each chunk size (--chunk), which may be much smaller
+ */
+
+#define MAX_CHUNKS	16
+
+static uint64_t total;
+static size_t chunks[MAX_CHUNKS];
+static int num_chunks;
+
+/*
+ * TA instance models to test (--ta): the default multi-instance TA, where
+ * each session gets its own instance, and/or the single-instance,
+ * multi-session variant
+ */
+
+static int ta_models[2] = { AESPERF_TA_MULTI_INSTANCE };
+static int num_ta_models = 1;
+
+/*
+ * Cache state between two invocations (--cache)
+ */
+
+#define CACHE_WARM	0	/* Reuse the same buffers, caches stay hot */
+#define CACHE_COLD	1	/* Evict caches before each invocation */
+#define CACHE_ROTATE	2	/* Cycle through a working set larger than LLC */
+
+static int cache_modes[3] = { CACHE_WARM };
+static int num_cache_modes = 1;
+
+#define CACHE_LINE	64
+
+/*
+ * Offsets of the input and output data into the shared buffers (--offset)
+ */
+
+#define MAX_OFFSETS	16
+
+static size_t offsets[MAX_OFFSETS];
+static int num_offsets = 1;
+
+/*
+ * Buffer size distribution (--size-dist)
+ *
+ * Each invocation processes a buffer whose size is drawn at random from
+ * weighted buckets, or taken in turn from a recorded list of sizes (replay).
+ */
+
+struct size_bucket {
+	size_t size;
+	unsigned int weight;
 };
 
+static struct size_bucket *size_dist;
+static int num_buckets;
+static unsigned int total_weight;
+static int *replay;		/* Bucket index of each recorded size */
+static size_t replay_len;
+
+/*
+ * TEE client stuff
+ */
+
 static void errx(const char *msg, TEEC_Result res)
 {
 	fprintf(stderr, "%s: 0x%08x", msg, res);
@@ -95,61 +293,44 @@ static void check_res(TEEC_Result res, const char *errmsg)
 		errx(errmsg, res);
 }
 
-static void open_ta()
+static void open_session(TEEC_Session *s)
 {
-	TEEC_Result res;
-	TEEC_UUID uuid = TA_AES_PERF_UUID;
-	uint32_t err_origin;
+	check_res(aesperf_open_session(&ap, s), "TEEC_OpenSession");
+}
 
-	res = TEEC_InitializeContext(NULL, &ctx);
-	check_res(res,"TEEC_InitializeContext");
+static void open_ta()
+{
+	check_res(aesperf_open_ta(&ap, cfg), "TEEC_OpenSession");
+}
 
-	res = TEEC_OpenSession(&ctx, &sess, &uuid, TEEC_LOGIN_PUBLIC, NULL,
-			       NULL, &err_origin);
-	check_res(res,"TEEC_OpenSession");
+static void close_ta(void)
+{
+	aesperf_close_ta(&ap);
 }
 
 /*
- * Statistics
- *
- * We want to compute min, max, mean and standard deviation of processing time
+ * Get the number of sessions opened on the TA instance of session s, and the
+ * memory reserved for each instance
  */
-
-struct statistics {
-	int n;
-	double m;
-	double M2;
-	double min;
-	double max;
-	int initialized;
-};
-
-/* Take new sample into account (Knuth/Welford algorithm) */
-static void update_stats(struct statistics *s, uint64_t t)
+static void get_ta_info(TEEC_Session *s, uint32_t *sessions,
+			uint32_t *inst_size)
 {
-	double x = (double)t;
-	double delta = x - s->m;
+	TEEC_Result res;
+	uint32_t ret_origin;
+	TEEC_Operation op;
 
-	s->n++;
-	s->m += delta/s->n;
-	s->M2 += delta*(x - s->m);
-	if (!s->initialized) {
-		s->min = s->max = x;
-		s->initialized = 1;
-	} else {
-		if (s->min > x)
-			s->min = x;
-		if (s->max < x)
-			s->max = x;
-	}
+	memset(&op, 0, sizeof(op));
+	op.paramTypes = TEEC_PARAM_TYPES(TEEC_VALUE_OUTPUT, TEEC_NONE,
+					 TEEC_NONE, TEEC_NONE);
+	res = TEEC_InvokeCommand(s, TA_AES_PERF_CMD_GET_INFO, &op,
+				 &ret_origin);
+	check_res(res, "TEEC_InvokeCommand");
+	*sessions = op.params[0].value.a;
+	*inst_size = op.params[0].value.b;
 }
 
-static double stddev(struct statistics *s)
-{
-	if (s->n < 2)
-		return NAN;
-	return sqrt(s->M2/s->n);
-}
+/* Latency estimator used for throughput figures (--throughput) */
+static int center = AESPERF_CENTER_MEAN;
 
 static const char *mode_str(uint32_t mode)
 {
@@ -162,6 +343,120 @@ static const char *mode_str(uint32_t mode)
 		return "CTR";
 	case TA_AES_XTS:
 		return "XTS";
+	case TA_SHA1:
+		return "SHA1";
+	case TA_SHA256:
+		return "SHA256";
+	case TA_SHA512:
+		return "SHA512";
+	case TA_HMAC_SHA256:
+		return "HMAC-SHA256";
+	case TA_AES_CMAC:
+		return "CMAC";
+	case TA_RSA_SIGN:
+		return "RSA-SIGN";
+	case TA_RSA_VERIFY:
+		return "RSA-VERIFY";
+	case TA_RSA_ENCRYPT:
+		return "RSA-ENCRYPT";
+	case TA_RSA_DECRYPT:
+		return "RSA-DECRYPT";
+	case TA_ECDSA_SIGN:
+		return "ECDSA-SIGN";
+	case TA_ECDSA_VERIFY:
+		return "ECDSA-VERIFY";
+	case TA_ECDH:
+		return "ECDH";
+	default:
+		return "???";
+	}
+}
+
+/* Digest and MAC modes process data but produce no ciphertext */
+static int is_hash_mode(int mode)
+{
+	return mode >= TA_SHA1 && mode <= TA_AES_CMAC;
+}
+
+/* Modes with a key pair, timed per operation rather than per byte */
+static int is_asym_mode(int mode)
+{
+	return mode >= TA_RSA_SIGN;
+}
+
+static const char *op_str(void)
+{
+	if (is_asym_mode(cfg->mode))
+		return "asymmetric";
+	if (is_hash_mode(cfg->mode))
+		return cfg->mode >= TA_HMAC_SHA256 ? "MAC" : "digest";
+	return cfg->decrypt ? "decrypt" : "encrypt";
+}
+
+/*
+ * Apply the default key size of a mode to *ks and check it. Returns -1 if
+ * invalid.
+ */
+static int check_keysize(int mode, int *ks)
+{
+	int keysize = *ks;
+	int ret;
+
+	switch (mode) {
+	case TA_HMAC_SHA256:
+		if (keysize == 128)
+			keysize = 256;	/* HMAC keys are at least 192 bits */
+		ret = keysize == 192 || keysize == 256 ? 0 : -1;
+		break;
+	case TA_RSA_SIGN:
+	case TA_RSA_VERIFY:
+	case TA_RSA_ENCRYPT:
+	case TA_RSA_DECRYPT:
+		if (keysize == 128)
+			keysize = 2048;
+		ret = keysize == 2048 || keysize == 3072 ||
+		      keysize == 4096 ? 0 : -1;
+		break;
+	case TA_ECDSA_SIGN:
+	case TA_ECDSA_VERIFY:
+		if (keysize == 128)
+			keysize = 256;
+		ret = keysize == 256 || keysize == 384 ? 0 : -1;
+		break;
+	case TA_ECDH:
+		if (keysize == 128)
+			keysize = 256;
+		ret = keysize == 256 ? 0 : -1;
+		break;
+	default:
+		ret = keysize == 128 || keysize == 192 ||
+		      keysize == 256 ? 0 : -1;
+		break;
+	}
+	*ks = keysize;
+	return ret;
+}
+
+/* Modes which process whole AES blocks only */
+static int needs_blocks(int mode)
+{
+	return mode == TA_AES_ECB || mode == TA_AES_CBC || mode == TA_AES_XTS;
+}
+
+static const char *ta_model_str(int model)
+{
+	return model == AESPERF_TA_SINGLE_INSTANCE ? "single" : "multi";
+}
+
+static const char *cache_str(int cache)
+{
+	switch (cache) {
+	case CACHE_WARM:
+		return "warm";
+	case CACHE_COLD:
+		return "cold";
+	case CACHE_ROTATE:
+		return "rotate";
 	default:
 		return "???";
 	}
@@ -176,19 +471,50 @@ static void usage(const char *progname)
 		TO_STR(VERSION));
 	fprintf(stderr, "Usage:\n");
 	fprintf(stderr, "  %s -h\n", progname);
+	fprintf(stderr, "  %s history [--store=file] [--metric=name] ",
+		progname);
+	fprintf(stderr, "[test options]\n");
 	fprintf(stderr, "  %s [-v] [-m mode] [-k keysize] ", progname);
 	fprintf(stderr, "[-s bufsize] [-r] [-i] [-n loops] [-l iloops] \n");
 	fprintf(stderr, "[-w warmup_time]\n");
+	fprintf(stderr, "[--cache=mode[,mode...]] [--llc=size] ");
+	fprintf(stderr, "[--offset=sweep|off[,off...]]\n");
+	fprintf(stderr, "[--size-dist=imix|storage|size:weight[,...]|@file]\n");
+	fprintf(stderr, "[--duration=time [--interval=time]]\n");
+	fprintf(stderr, "[--cpu=clusters|cpu[,cpu...]] [--sched=policy[:prio]] ");
+	fprintf(stderr, "[--mlock] [--verify[=roundtrip]]\n");
+	fprintf(stderr, "[--qd=depth[,depth...]] [--ta=multi|single|both]\n");
+	fprintf(stderr, "[--copy[=chunk]] [--total=size [--chunk=size[,size...]]]\n");
+	fprintf(stderr, "[--rng] [--final] [--asym] [--storage[=size]]\n");
+	fprintf(stderr, "[--timer=clock|counter] [--attribute-outliers[=pct]]\n");
+	fprintf(stderr, "[--throughput=mean|median|trimmed]\n");
+	fprintf(stderr, "[--export=unix:path|tcp:[addr:]port ");
+	fprintf(stderr, "[--probe-interval=time] [--probe-modes=mode[,...]]\n");
+	fprintf(stderr, " [--cpu-budget=pct]]\n");
+	fprintf(stderr, "[--scenario=file] [--shm=alloc|register] ");
+	fprintf(stderr, "[--precision=pct]\n");
+	fprintf(stderr, "[--store[=file]] [--store-hist]\n");
+	fprintf(stderr, "[--plot=dir [--baseline=file]]\n");
 	fprintf(stderr, "Options:\n");
 	fprintf(stderr, "  -h    Print this help and exit\n");
 	fprintf(stderr, "  -i    Use same buffer for input and output (in ");
 	fprintf(stderr, "place)\n");
-	fprintf(stderr, "  -k    Key size in bits: 128, 192 or 256 [%u]\n",
-			keysize);
+	fprintf(stderr, "  -k    Key size in bits: 128, 192 or 256 [%u]. ",
+			cfg->keysize);
+	fprintf(stderr, "HMAC uses 256 unless\n");
+	fprintf(stderr, "        192 is given. RSA: 2048, 3072 or 4096 ");
+	fprintf(stderr, "[2048], ECDSA: 256 or 384\n");
+	fprintf(stderr, "        [256], ECDH: 256\n");
 	fprintf(stderr, "  -l    Inner loop iterations (TA calls ");
 	fprintf(stderr, "TEE_CipherUpdate() <x> times) [%u]\n", l);
-	fprintf(stderr, "  -m    AES mode: ECB, CBC, CTR, XTS [%s]\n",
-			mode_str(mode));
+	fprintf(stderr, "  -m    AES mode: ECB, CBC, CTR, XTS, digest: SHA1, ");
+	fprintf(stderr, "SHA256, SHA512, or MAC:\n");
+	fprintf(stderr, "        HMAC-SHA256, CMAC (AES), or asymmetric: ");
+	fprintf(stderr, "RSA-SIGN, RSA-VERIFY,\n");
+	fprintf(stderr, "        RSA-ENCRYPT, RSA-DECRYPT, ECDSA-SIGN, ");
+	fprintf(stderr, "ECDSA-VERIFY, ECDH\n");
+	fprintf(stderr, "        (key pair generated once, timed per ");
+	fprintf(stderr, "operation) [%s]\n", mode_str(cfg->mode));
 	fprintf(stderr, "  -n    Outer loop iterations [%u]\n", n);
 	fprintf(stderr, "  -r    Get input data from /dev/urandom ");
 	fprintf(stderr, "(otherwise use zero-filled buffer)\n");
@@ -199,54 +525,353 @@ static void usage(const char *progname)
 	fprintf(stderr, "loop before the test\n");
 	fprintf(stderr, "        to mitigate the effects of cpufreq etc. ");
 	fprintf(stderr, "[%u]\n", warmup);
+	fprintf(stderr, "  --cache  Cache state before each invocation: warm ");
+	fprintf(stderr, "(reuse buffers),\n");
+	fprintf(stderr, "        cold (evict caches), rotate (cycle through a ");
+	fprintf(stderr, "working set\n");
+	fprintf(stderr, "        larger than the LLC). A comma-separated list ");
+	fprintf(stderr, "runs each mode\n");
+	fprintf(stderr, "        and reports the deltas against the first one ");
+	fprintf(stderr, "[%s]\n", cache_str(CACHE_WARM));
+	fprintf(stderr, "  --llc    Last-level cache size, K/M/G suffixes ");
+	fprintf(stderr, "allowed [from sysfs]\n");
+	fprintf(stderr, "  --offset Byte offset of the data into the input and ");
+	fprintf(stderr, "output buffers.\n");
+	fprintf(stderr, "        A comma-separated list runs each offset; ");
+	fprintf(stderr, "\"sweep\" selects 0, 1, 4,\n");
+	fprintf(stderr, "        8, 15, 16, 64, 128, PAGE_SIZE/2, ");
+	fprintf(stderr, "PAGE_SIZE-16 [0]\n");
+	fprintf(stderr, "  --size-dist  Draw the buffer size of each ");
+	fprintf(stderr, "invocation from a distribution\n");
+	fprintf(stderr, "        (overrides -s): imix (40:7,576:4,1500:1), ");
+	fprintf(stderr, "storage (block I/O\n");
+	fprintf(stderr, "        mix), a list of size:weight pairs, or @file ");
+	fprintf(stderr, "to replay a list of\n");
+	fprintf(stderr, "        sizes in order. Sizes are rounded up to the ");
+	fprintf(stderr, "AES block size\n");
+	fprintf(stderr, "        in ECB, CBC and XTS modes\n");
+	fprintf(stderr, "  --duration  Time-series mode: run for the given ");
+	fprintf(stderr, "time instead of -n\n");
+	fprintf(stderr, "        loops and print one CSV row per interval with ");
+	fprintf(stderr, "throughput, latency\n");
+	fprintf(stderr, "        percentiles, CPU frequency and thermal zone ");
+	fprintf(stderr, "temperatures.\n");
+	fprintf(stderr, "        Suffixes: ns, us, ms, s, m, h [seconds]\n");
+	fprintf(stderr, "  --interval  Time-series reporting interval [1s]\n");
+	fprintf(stderr, "  --cpu    Pin the test to a CPU. A comma-separated ");
+	fprintf(stderr, "list runs the test\n");
+	fprintf(stderr, "        on each CPU in turn; \"clusters\" selects ");
+	fprintf(stderr, "one CPU of each\n");
+	fprintf(stderr, "        cpu_capacity value (big.LITTLE)\n");
+	fprintf(stderr, "  --sched  Scheduling policy: fifo:prio, rr:prio, ");
+	fprintf(stderr, "other\n");
+	fprintf(stderr, "  --mlock  Lock all current and future memory with ");
+	fprintf(stderr, "mlockall()\n");
+	fprintf(stderr, "  --verify Check the output of each invocation against ");
+	fprintf(stderr, "a reference AES\n");
+	fprintf(stderr, "        implementation, outside the timed region; ");
+	fprintf(stderr, "\"roundtrip\" also decrypts\n");
+	fprintf(stderr, "        the output back (requires -l 1). Note that ");
+	fprintf(stderr, "this warms the caches\n");
+	fprintf(stderr, "  --qd     Asynchronous mode: keep <x> requests in ");
+	fprintf(stderr, "flight, served by <x>\n");
+	fprintf(stderr, "        invoker threads with one session each. A ");
+	fprintf(stderr, "comma-separated list\n");
+	fprintf(stderr, "        runs each queue depth. Uses -s, -n, -l, -i ");
+	fprintf(stderr, "and -r only (max %u)\n", MAX_QD);
+	fprintf(stderr, "  --procs  Contention mode: fork <x> worker ");
+	fprintf(stderr, "processes, each with its own\n");
+	fprintf(stderr, "        TEE context, session and key, started ");
+	fprintf(stderr, "together, and report the\n");
+	fprintf(stderr, "        aggregate throughput and the tail latency ");
+	fprintf(stderr, "of each process.\n");
+	fprintf(stderr, "        With --cpu, the workers are spread over the ");
+	fprintf(stderr, "CPU list (max %u)\n", MAX_PROCS);
+	fprintf(stderr, "  --cancel Cancellation mode: time -n invocations ");
+	fprintf(stderr, "of a cipher loop that\n");
+	fprintf(stderr, "        checks TEE_GetCancellationFlag() between ");
+	fprintf(stderr, "updates, each cancelled\n");
+	fprintf(stderr, "        by a second thread after a random delay of ");
+	fprintf(stderr, "up to <x>, and report\n");
+	fprintf(stderr, "        the time from TEEC_RequestCancellation() ");
+	fprintf(stderr, "to the return, and the\n");
+	fprintf(stderr, "        throughput cost of the checks. Use a large ");
+	fprintf(stderr, "-l [median invocation]\n");
+	fprintf(stderr, "  --ta     TA instance model: multi (one instance ");
+	fprintf(stderr, "per session), single\n");
+	fprintf(stderr, "        (single-instance, multi-session variant) or ");
+	fprintf(stderr, "both, to compare\n");
+	fprintf(stderr, "        throughput and memory footprint, typically ");
+	fprintf(stderr, "with --qd [multi]\n");
+	fprintf(stderr, "  --copy   The TA copies each chunk of the input to a ");
+	fprintf(stderr, "private heap buffer,\n");
+	fprintf(stderr, "        encrypts it in place and copies it out, and ");
+	fprintf(stderr, "reports the time\n");
+	fprintf(stderr, "        spent in each stage. Chunk size with K/M/G ");
+	fprintf(stderr, "suffixes [whole buffer]\n");
+	fprintf(stderr, "  --total  Streaming mode: encrypt <x> bytes as one ");
+	fprintf(stderr, "stream, passed to the TA\n");
+	fprintf(stderr, "        through a shared buffer of --chunk bytes, and ");
+	fprintf(stderr, "report the end-to-end\n");
+	fprintf(stderr, "        throughput. Replaces -n, -l and -s. ");
+	fprintf(stderr, "K/M/G suffixes allowed\n");
+	fprintf(stderr, "  --chunk  Shared buffer size in streaming mode. A ");
+	fprintf(stderr, "comma-separated list\n");
+	fprintf(stderr, "        runs each size [-s]\n");
+	fprintf(stderr, "  --rng    Time TEE_GenerateRandom() filling the output ");
+	fprintf(stderr, "buffer instead of\n");
+	fprintf(stderr, "        AES. Without -s or --size-dist, runs each size ");
+	fprintf(stderr, "from 16 bytes to\n");
+	fprintf(stderr, "        1 MiB (x4 steps) and prints a summary table\n");
+	fprintf(stderr, "  --final  Digests and MACs: each inner loop is a ");
+	fprintf(stderr, "complete message,\n");
+	fprintf(stderr, "        finalized with TEE_DigestDoFinal() or ");
+	fprintf(stderr, "TEE_MACComputeFinal().\n");
+	fprintf(stderr, "        Otherwise the input is hashed as one ");
+	fprintf(stderr, "endless stream\n");
+	fprintf(stderr, "  --asym   Run each asymmetric mode and key size ");
+	fprintf(stderr, "(RSA 2048/3072/4096,\n");
+	fprintf(stderr, "        ECDSA P-256/P-384, ECDH P-256) and print ");
+	fprintf(stderr, "a summary table\n");
+	fprintf(stderr, "  --storage  Secure storage: time the creation and ");
+	fprintf(stderr, "deletion of a persistent\n");
+	fprintf(stderr, "        object, then sequential and random writes ");
+	fprintf(stderr, "and reads of -s bytes,\n");
+	fprintf(stderr, "        seeks and truncations on an object of <x> ");
+	fprintf(stderr, "bytes, -n times each.\n");
+	fprintf(stderr, "        K/M/G suffixes allowed [1M]\n");
+	fprintf(stderr, "  --timer  Time invocations with clock_gettime() ");
+	fprintf(stderr, "or by reading the\n");
+	fprintf(stderr, "        architectural counter directly (CNTVCT, or ");
+	fprintf(stderr, "TSC on x86). The cost\n");
+	fprintf(stderr, "        of an empty timer read pair is subtracted ");
+	fprintf(stderr, "from each sample [clock]\n");
+	fprintf(stderr, "  --attribute-outliers  Snapshot /proc/interrupts, ");
+	fprintf(stderr, "/proc/softirqs,\n");
+	fprintf(stderr, "        /proc/self/sched and getrusage() after each ");
+	fprintf(stderr, "invocation (outside the\n");
+	fprintf(stderr, "        timed region) and report the counters that ");
+	fprintf(stderr, "moved during the\n");
+	fprintf(stderr, "        invocations above the given latency ");
+	fprintf(stderr, "percentile. Only the CPU\n");
+	fprintf(stderr, "        of the test is counted with --cpu [99]\n");
+	fprintf(stderr, "  --throughput  Latency estimator behind the MiB/s ");
+	fprintf(stderr, "and ops/s figures: mean,\n");
+	fprintf(stderr, "        median, or mean of the samples between p5 and ");
+	fprintf(stderr, "p95 (trimmed),\n");
+	fprintf(stderr, "        which are robust to preemption spikes ");
+	fprintf(stderr, "[mean]\n");
+	fprintf(stderr, "  --export Exporter mode: keep the session open, run ");
+	fprintf(stderr, "-n invocations [16]\n");
+	fprintf(stderr, "        of each probe mode every probe interval, and ");
+	fprintf(stderr, "serve throughput,\n");
+	fprintf(stderr, "        latency histograms and error counters in ");
+	fprintf(stderr, "OpenMetrics text format\n");
+	fprintf(stderr, "        on a Unix or TCP socket (loopback by ");
+	fprintf(stderr, "default)\n");
+	fprintf(stderr, "  --probe-interval  Time between probes [10s]\n");
+	fprintf(stderr, "  --probe-modes  Comma-separated list of ciphers, ");
+	fprintf(stderr, "digests or MACs [-m]\n");
+	fprintf(stderr, "  --cpu-budget  Max. percentage of time spent ");
+	fprintf(stderr, "probing; the interval is\n");
+	fprintf(stderr, "        stretched to stay below it [1]\n");
+	fprintf(stderr, "  --scenario  Run the named benchmarks of a file in ");
+	fprintf(stderr, "one process and\n");
+	fprintf(stderr, "        session, and print a summary table. Each ");
+	fprintf(stderr, "\"[name]\" section sets\n");
+	fprintf(stderr, "        mode, keysize, direction (encrypt|decrypt), ");
+	fprintf(stderr, "sizes (list),\n");
+	fprintf(stderr, "        threads (>1: --qd), shm, iterations, loops ");
+	fprintf(stderr, "and precision as\n");
+	fprintf(stderr, "        \"key = value\" lines; the command line ");
+	fprintf(stderr, "gives the defaults\n");
+	fprintf(stderr, "  --shm    Shared memory: alloc ");
+	fprintf(stderr, "(TEEC_AllocateSharedMemory()) or register\n");
+	fprintf(stderr, "        (page-aligned application buffers, ");
+	fprintf(stderr, "TEEC_RegisterSharedMemory()) [alloc]\n");
+	fprintf(stderr, "  --precision  Stop before -n samples once the 95%% ");
+	fprintf(stderr, "confidence interval of\n");
+	fprintf(stderr, "        the mean is within +/- <x>%% (checked every ");
+	fprintf(stderr, "100 samples)\n");
+	fprintf(stderr, "  --store  Append the summary statistics of each ");
+	fprintf(stderr, "test to a local results\n");
+	fprintf(stderr, "        store, keyed by configuration and ");
+	fprintf(stderr, "environment (kernel, OP-TEE,\n");
+	fprintf(stderr, "        CPU, version) [%s]\n", DEFAULT_STORE);
+	fprintf(stderr, "  --store-hist  Also store the latency histogram ");
+	fprintf(stderr, "of each test\n");
+	fprintf(stderr, "  history  Print a metric of all the stored runs ");
+	fprintf(stderr, "of the configuration\n");
+	fprintf(stderr, "        given by the test options, oldest first\n");
+	fprintf(stderr, "  --metric Metric printed by history: mean, median, ");
+	fprintf(stderr, "min, max, stddev, mad,\n");
+	fprintf(stderr, "        q1, q3, trimmed, mibs (MiB/s), or p90, p99, ");
+	fprintf(stderr, "p99.9 (--store-hist)\n");
+	fprintf(stderr, "        [mean]\n");
+	fprintf(stderr, "  --plot   Write SVG charts to a directory: MiB/s ");
+	fprintf(stderr, "versus buffer size per mode\n");
+	fprintf(stderr, "        and key size (throughput.svg), and the ");
+	fprintf(stderr, "latency CDF of each test\n");
+	fprintf(stderr, "        (latency-NN.svg)\n");
+	fprintf(stderr, "  --baseline  Overlay the latest runs of the same ");
+	fprintf(stderr, "configurations found in\n");
+	fprintf(stderr, "        a results store (--store; CDFs need ");
+	fprintf(stderr, "--store-hist)\n");
 }
 
-static void alloc_shm(size_t sz)
+/* Parse a time such as "30m", "1s" or "500ms" into ns. Returns 0 on error. */
+static uint64_t parse_duration(const char *s)
 {
-	TEEC_Result res;
+	static const struct {
+		const char *suffix;
+		uint64_t ns;
+	} units[] = {
+		{ "", 1000000000ULL },
+		{ "ns", 1ULL },
+		{ "us", 1000ULL },
+		{ "ms", 1000000ULL },
+		{ "s", 1000000000ULL },
+		{ "m", 60 * 1000000000ULL },
+		{ "h", 3600 * 1000000000ULL },
+	};
+	char *end;
+	double v;
+	size_t i;
+
+	v = strtod(s, &end);
+	if (end == s || v <= 0)
+		return 0;
+	for (i = 0; i < sizeof(units)/sizeof(units[0]); i++)
+		if (!strcmp(end, units[i].suffix))
+			return v * units[i].ns;
+	return 0;
+}
 
-	in_shm.buffer = NULL;
-	in_shm.size = sz;
-	res = TEEC_AllocateSharedMemory(&ctx, &in_shm);
-	check_res(res, "TEEC_AllocateSharedMemory");
+/* Parse a size such as "4096", "64K", "8M" or "1G". Returns 0 on error. */
+static size_t parse_size(const char *s)
+{
+	char *end;
+	unsigned long long v;
 
-	if (!in_place) {
-		out_shm.buffer = NULL;
-		out_shm.size = sz;
-		res = TEEC_AllocateSharedMemory(&ctx, &out_shm);
-		check_res(res, "TEEC_AllocateSharedMemory");
+	v = strtoull(s, &end, 0);
+	switch (*end) {
+	case 'G':
+	case 'g':
+		v *= 1024;
+		/* fall through */
+	case 'M':
+	case 'm':
+		v *= 1024;
+		/* fall through */
+	case 'K':
+	case 'k':
+		v *= 1024;
+		end++;
+		break;
+	default:
+		break;
 	}
+	if (end == s || *end)
+		return 0;
+	return v;
 }
 
-static void free_shm()
+/* Return the value of argument "--name=value", or NULL if arg is not --name */
+static const char *long_opt(const char *arg, const char *name)
 {
-	TEEC_ReleaseSharedMemory(&in_shm);
-	TEEC_ReleaseSharedMemory(&out_shm);
+	size_t len = strlen(name);
+
+	if (strncmp(arg, name, len) || arg[len] != '=')
+		return NULL;
+	return arg + len + 1;
 }
 
-static ssize_t read_random(void *in, size_t rsize)
+/*
+ * Largest cache reported by sysfs for any CPU, which is assumed to be the LLC
+ * (clusters of a big.LITTLE system may have different cache sizes).
+ * Falls back to 8 MiB when the information is not available.
+ */
+static size_t get_llc_size(void)
 {
-	static int rnd;
-	ssize_t s;
+	char path[64];
+	size_t max = 0;
+	size_t sz;
+	FILE *f;
+	char buf[32];
+	int cpu, i;
 
-	if (!rnd) {
-		rnd = open("/dev/urandom", O_RDONLY);
-		if (rnd < 0) {
-			perror("open");
-			return 1;
+	for (cpu = 0; cpu < MAX_CPUS; cpu++) {
+		for (i = 0; i < 10; i++) {
+			snprintf(path, sizeof(path),
+				 "/sys/devices/system/cpu/cpu%d/cache/index%d/size",
+				 cpu, i);
+			f = fopen(path, "r");
+			if (!f)
+				break;
+			if (fgets(buf, sizeof(buf), f)) {
+				buf[strcspn(buf, "\n")] = '\0';
+				sz = parse_size(buf);
+				if (sz > max)
+					max = sz;
+			}
+			fclose(f);
 		}
+		if (!i)
+			break;
 	}
-	s = read(rnd, in, rsize);
-	if (s < 0) {
-		perror("read");
-		return 1;
-	}
-	if (s != rsize) {
-		printf("read: requested %zu bytes, got %zd\n",
-		       rsize, s);
+	return max ? max : 8 * 1024 * 1024;
+}
+
+static void alloc_shm(size_t sz)
+{
+	check_res(aesperf_alloc_shm(&ap, sz), "aesperf_alloc_shm");
+}
+
+/* Same, and ap.op for cfg->size bytes and cfg->loops inner loops */
+static void setup_shm(size_t sz)
+{
+	check_res(aesperf_setup(&ap, sz), "aesperf_setup");
+}
+
+/* With the settings of the allocation */
+static void free_shm()
+{
+	aesperf_free_shm(&ap);
+}
+
+/*
+ * Scratch buffer streamed over between invocations in CACHE_COLD mode. Writing
+ * twice the LLC size is enough to evict the shared memory buffers from all
+ * cache levels.
+ */
+static uint8_t *scratch;
+static size_t scratch_size;
+
+static void alloc_scratch(void)
+{
+	if (scratch)
+		return;
+	scratch_size = 2 * llc_size;
+	scratch = malloc(scratch_size);
+	if (!scratch) {
+		perror("malloc");
+		exit(1);
 	}
 }
 
+static void evict_caches(void)
+{
+	static uint8_t v;
+
+	memset(scratch, ++v, scratch_size);
+}
+
+static void read_random(void *in, size_t rsize)
+{
+	if (aesperf_fill_random(&ap, in, rsize) < 0)
+		exit(1);
+}
+
 static long get_current_time(struct timespec *ts)
 {
 	if (clock_gettime(CLOCK_MONOTONIC, ts) < 0) {
@@ -265,39 +890,173 @@ static uint64_t timespec_diff_ns(struct timespec *start, struct timespec *end)
 	return timespec_to_ns(end) - timespec_to_ns(start);
 }
 
-static uint64_t run_test_once(void *in, size_t size, TEEC_Operation *op,
-			  unsigned int l)
+/* Set up the timing backend, see struct aesperf_timer */
+static int calibrate_timer(void)
 {
-	struct timespec t0, t1;
-	TEEC_Result res;
-	uint32_t ret_origin;
+	if (aesperf_timer_init(&ap.timer, cfg->timer) < 0)
+		return -1;
+	if (cfg->timer == AESPERF_TIMER_COUNTER)
+		verbose("Counter frequency: %.3f MHz (%.3f ns per tick)\n",
+			ap.timer.hz / 1000000, ap.timer.counter_ns);
+	verbose("Timer overhead: %llu ns (min %llu ns, max %llu ns)\n",
+		(unsigned long long)ap.timer.overhead,
+		(unsigned long long)ap.timer.overhead_min,
+		(unsigned long long)ap.timer.overhead_max);
+	return 0;
+}
 
-	if (random_in)
-		read_random(in, size);
-	get_current_time(&t0);
-	res = TEEC_InvokeCommand(&sess, TA_AES_PERF_CMD_PROCESS, op,
-				 &ret_origin);
-	check_res(res, "TEEC_InvokeCommand");
-	get_current_time(&t1);
+/*
+ * Output verification
+ *
+ * ref_ctx mirrors the cipher state of the TA: it is initialized with the same
+ * key, IV and mode when the key is prepared, then replays every
+ * TEE_CipherUpdate() call done by the TA (l per invocation), so that the CBC
+ * chaining value and the CTR counter stay in sync across invocations.
+ */
+
+static struct aes_ref_ctx ref_ctx;
+static struct aes_ref_ctx ref_inv_ctx;	/* Reverse direction (round trip) */
+static uint8_t *verify_in;
+static uint8_t *verify_out;
+static uint8_t *verify_tmp;
+static unsigned long verify_count;
+static uint64_t verify_ns;		/* Time spent verifying */
+
+static void verify_alloc(size_t sz)
+{
+	verify_in = malloc(sz);
+	verify_out = malloc(sz);
+	verify_tmp = malloc(sz);
+	if (!verify_in || !verify_out || !verify_tmp) {
+		perror("malloc");
+		exit(1);
+	}
+}
+
+static void verify_init(void)
+{
+	static const uint8_t key[] = TA_AES_PERF_KEY;
+	static const uint8_t key2[] = TA_AES_PERF_KEY2;
+	static const uint8_t iv[] = TA_AES_PERF_IV;
+
+	aes_ref_init(&ref_ctx, cfg->mode, cfg->decrypt, key, key2,
+		     cfg->keysize / 8, iv);
+	aes_ref_init(&ref_inv_ctx, cfg->mode, !cfg->decrypt, key, key2,
+		     cfg->keysize / 8, iv);
+}
+
+static void verify_fail(const char *what, size_t sz, const uint8_t *a,
+			const uint8_t *b)
+{
+	size_t i;
+
+	for (i = 0; i < sz && a[i] == b[i]; i++)
+		;
+	fprintf(stderr, "verify: %s mismatch in invocation %lu (size %zu) ",
+		what, verify_count, sz);
+	fprintf(stderr, "at byte %zu: 0x%02x, expected 0x%02x\n", i, a[i],
+		b[i]);
+	exit(1);
+}
+
+/* Digest or MAC of one message (--final), returns its size */
+static size_t ref_hash(const uint8_t *msg, size_t len, uint8_t *md)
+{
+	static const uint8_t key[] = TA_AES_PERF_KEY;
+	struct hash_ref_ctx hash;
+	struct hmac_ref_ctx hmac;
+	struct cmac_ref_ctx cmac;
+
+	switch (cfg->mode) {
+	case TA_HMAC_SHA256:
+		hmac_ref_init(&hmac, TA_SHA256, key, cfg->keysize / 8);
+		hmac_ref_update(&hmac, msg, len);
+		hmac_ref_final(&hmac, md);
+		return hash_ref_size(TA_SHA256);
+	case TA_AES_CMAC:
+		cmac_ref_init(&cmac, key, cfg->keysize / 8);
+		cmac_ref_update(&cmac, msg, len);
+		cmac_ref_final(&cmac, md);
+		return AES_BLOCK_SIZE;
+	default:
+		hash_ref_init(&hash, cfg->mode);
+		hash_ref_update(&hash, msg, len);
+		hash_ref_final(&hash, md);
+		return hash_ref_size(cfg->mode);
+	}
+}
+
+/* Compute the expected output of the invocation described by op */
+static void verify_output(TEEC_Operation *op, unsigned int l)
+{
+	size_t sz = op->params[1].memref.size;
+	uint8_t *out = (uint8_t *)op->params[1].memref.parent->buffer +
+		       op->params[1].memref.offset;
+	uint8_t md[HASH_REF_MAX_SIZE];
+	size_t md_len;
+	unsigned int k;
+
+	verify_count++;
+	if (is_hash_mode(cfg->mode)) {
+		/* The TA returns the digest or MAC of the last message */
+		md_len = ref_hash(verify_in, sz, md);
+		if (md_len > sz)
+			md_len = sz;
+		if (memcmp(out, md, md_len))
+			verify_fail("digest", md_len, out, md);
+		return;
+	}
+	if (cfg->in_place) {
+		memcpy(verify_out, verify_in, sz);
+		for (k = 0; k < l; k++)
+			aes_ref_update(&ref_ctx, verify_out, verify_out, sz);
+	} else {
+		for (k = 0; k < l; k++)
+			aes_ref_update(&ref_ctx, verify_in, verify_out, sz);
+	}
+	if (memcmp(out, verify_out, sz))
+		verify_fail("output", sz, out, verify_out);
 
-	return timespec_diff_ns(&t0, &t1);
+	if (verify == VERIFY_ROUNDTRIP) {
+		aes_ref_update(&ref_inv_ctx, out, verify_tmp, sz);
+		if (memcmp(verify_tmp, verify_in, sz))
+			verify_fail("round trip", sz, verify_tmp, verify_in);
+	}
 }
 
-static void prepare_key()
+/* One sample of ap.op over size bytes at offset in the shared buffers */
+static uint64_t run_test_once(size_t offset, size_t size, unsigned int l,
+			      int cache)
 {
+	uint64_t t, t1, t2;
 	TEEC_Result res;
-	uint32_t ret_origin;
-	TEEC_Operation op;
 
-	memset(&op, 0, sizeof(op));
-	op.paramTypes = TEEC_PARAM_TYPES(TEEC_VALUE_INPUT, TEEC_VALUE_INPUT,
-					 TEEC_NONE, TEEC_NONE);
-	op.params[0].value.a = decrypt;
-	op.params[0].value.b = keysize;
-	op.params[1].value.a = mode;
-	res = TEEC_InvokeCommand(&sess, TA_AES_PERF_CMD_PREPARE_KEY, &op,
-				 &ret_origin);
+	check_res(aesperf_sample_prep(&ap, offset, size),
+		  "aesperf_sample_prep");
+	if (verify)
+		memcpy(verify_in, (uint8_t *)ap.in_shm.buffer + offset, size);
+	if (cache == CACHE_COLD)
+		evict_caches();
+	res = aesperf_sample_invoke(&ap, &t);
 	check_res(res, "TEEC_InvokeCommand");
+	if (verify) {
+		t1 = aesperf_timer_read(&ap.timer);
+		verify_output(&ap.op, l);
+		t2 = aesperf_timer_read(&ap.timer);
+		verify_ns += aesperf_timer_diff_ns(&ap.timer, t1, t2);
+	}
+
+	return t;
+}
+
+static TEEC_Result try_prepare_key(TEEC_Session *s)
+{
+	return aesperf_prepare_key(&ap, s);
+}
+
+static void prepare_key(TEEC_Session *s)
+{
+	check_res(try_prepare_key(s), "TEEC_InvokeCommand");
 }
 
 static void do_warmup()
@@ -313,70 +1072,3144 @@ static void do_warmup()
 	} while (timespec_diff_ns(&t0, &t) < (uint64_t)warmup * 1000000000);
 }
 
-static const char *yesno(int v)
-{
-	return (v ? "yes" : "no");
-}
+/*
+ * Time-series mode
+ *
+ * Latency samples are collected over one interval, then a CSV row is printed
+ * with the throughput, latency percentiles, the frequency of the CPU the test
+ * is running on (the TA runs on the same core as the calling thread) and the
+ * temperature of every thermal zone.
+ */
+
+#define MAX_ZONES	32
+
+struct ts_interval {
+	uint64_t *samples;
+	size_t n;
+	size_t max;
+	double bytes;
+	uint64_t start;	/* Start of the run (ns) */
+	uint64_t last;	/* Time of the previous row (ns) */
+	uint64_t next;	/* End of the current interval, relative to start */
+};
 
-static double mb_per_sec(size_t size, double usec)
+static int num_zones;
+
+/* Read an integer from a sysfs file. Returns -1 on error. */
+static long read_sysfs_long(const char *path)
 {
-	return (1000000000/usec)*((double)size/(1024*1024));
+	FILE *f;
+	long v;
+
+	f = fopen(path, "r");
+	if (!f)
+		return -1;
+	if (fscanf(f, "%ld", &v) != 1)
+		v = -1;
+	fclose(f);
+	return v;
 }
 
-/* Encryption test: buffer of tsize byte. Run test n times. */
-static void run_test(size_t size, unsigned int n, unsigned int l)
+/* CPU the calling thread last ran on, from /proc/self/stat (field 39) */
+static int get_current_cpu(void)
 {
-	uint64_t t;
-	struct statistics stats;
-	TEEC_Operation op;
-	int n0 = n;
+	char buf[1024];
+	char *p;
+	FILE *f;
+	int cpu = -1;
+	int i;
 
-	memset(&stats, 0, sizeof(stats));
+	f = fopen("/proc/self/stat", "r");
+	if (!f)
+		return -1;
+	if (fgets(buf, sizeof(buf), f) && (p = strrchr(buf, ')'))) {
+		/* p + 2 is field 3 */
+		p += 2;
+		for (i = 3; i < 39 && p; i++) {
+			p = strchr(p, ' ');
+			if (p)
+				p++;
+		}
+		if (p)
+			cpu = atoi(p);
+	}
+	fclose(f);
+	return cpu;
+}
 
-	alloc_shm(size);
+static void ts_start(struct ts_interval *ts)
+{
+	char path[64];
+	struct timespec t;
+	int i;
 
-	if (!random_in)
-		memset(in_shm.buffer, 0, size);
+	memset(ts, 0, sizeof(*ts));
+	get_current_time(&t);
+	ts->start = timespec_to_ns(&t);
+	ts->last = ts->start;
+	ts->next = interval;
 
-	memset(&op, 0, sizeof(op));
-	/* Using INOUT to handle the case in_place == 1 */
-	op.paramTypes = TEEC_PARAM_TYPES(TEEC_MEMREF_PARTIAL_INOUT,
-					 TEEC_MEMREF_PARTIAL_INOUT,
-					 TEEC_VALUE_INPUT, TEEC_NONE);
-	op.params[0].memref.parent = &in_shm;
-	op.params[0].memref.offset = 0;
-	op.params[0].memref.size = size;
-	op.params[1].memref.parent = in_place ? &in_shm : &out_shm;
-	op.params[1].memref.offset = 0;
-	op.params[1].memref.size = size;
-	op.params[2].value.a = l;
+	for (num_zones = 0; num_zones < MAX_ZONES; num_zones++) {
+		snprintf(path, sizeof(path),
+			 "/sys/class/thermal/thermal_zone%d/temp", num_zones);
+		if (access(path, R_OK))
+			break;
+	}
+	printf("time_s,count,MiB/s,p50_us,p90_us,p99_us,p99.9_us,max_us,");
+	printf("cpu,freq_khz");
+	for (i = 0; i < num_zones; i++)
+		printf(",zone%d_C", i);
+	printf("\n");
+}
 
-	verbose("Starting test: %s, %scrypt, keysize=%u bits, size=%zu bytes, ",
-		mode_str(mode), (decrypt ? "de" : "en"), keysize, size);
-	verbose("random=%s, ", yesno(random_in));
-	verbose("in place=%s, ", yesno(in_place));
-	verbose("inner loops=%u, loops=%u, warm-up=%u s\n", l, n, warmup);
+static void ts_print(struct ts_interval *ts, uint64_t now)
+{
+	char path[80];
+	uint64_t *v = ts->samples;
+	size_t cnt = ts->n;
+	double secs = (double)(now - ts->last) / 1000000000;
+	int cpu;
+	long t;
+	int i;
 
-	if (warmup)
-		do_warmup();
+	printf("%.3f,%zu,", (double)(now - ts->start) / 1000000000, cnt);
+	if (cnt) {
+		qsort(v, cnt, sizeof(*v), aesperf_cmp_u64);
+		printf("%g,%g,%g,%g,%g,%g,",
+		       ts->bytes / secs / (1024 * 1024),
+		       aesperf_percentile(v, cnt, 50) / 1000.0,
+		       aesperf_percentile(v, cnt, 90) / 1000.0,
+		       aesperf_percentile(v, cnt, 99) / 1000.0,
+		       aesperf_percentile(v, cnt, 99.9) / 1000.0,
+		       v[cnt - 1] / 1000.0);
+	} else {
+		printf("0,,,,,,");
+	}
 
-	while (n-- > 0) {
-		t = run_test_once(in_shm.buffer, size, &op, l);
-		update_stats(&stats, t);
-		if (n % (n0/10) == 0)
-			vverbose("#");
+	cpu = get_current_cpu();
+	snprintf(path, sizeof(path),
+		 "/sys/devices/system/cpu/cpu%d/cpufreq/scaling_cur_freq", cpu);
+	t = cpu < 0 ? -1 : read_sysfs_long(path);
+	printf("%d,", cpu);
+	if (t >= 0)
+		printf("%ld", t);
+	for (i = 0; i < num_zones; i++) {
+		snprintf(path, sizeof(path),
+			 "/sys/class/thermal/thermal_zone%d/temp", i);
+		t = read_sysfs_long(path);
+		if (t == -1)
+			printf(",");
+		else
+			printf(",%g", t / 1000.0);
 	}
-	vverbose("\n");
-	printf("min=%gμs max=%gμs mean=%gμs stddev=%gμs (%gMiB/s)\n",
-	       stats.min/1000, stats.max/1000, stats.m/1000,
-	       stddev(&stats)/1000, mb_per_sec(size, stats.m));
-	free_shm();
+	printf("\n");
+	fflush(stdout);
+	ts->last = now;
 }
 
-#define NEXT_ARG(i) \
-	do { \
-		if (++i == argc) { \
-			fprintf(stderr, "%s: %s: missing argument\n", \
+/*
+ * Record one sample. Prints a row when the current interval has elapsed.
+ * Returns 1 when the requested duration has elapsed.
+ */
+static int ts_update(struct ts_interval *ts, uint64_t t, size_t sz)
+{
+	struct timespec now;
+	uint64_t *p;
+	uint64_t elapsed;
+
+	if (ts->n == ts->max) {
+		ts->max = ts->max ? 2 * ts->max : 1024;
+		p = realloc(ts->samples, ts->max * sizeof(*p));
+		if (!p) {
+			perror("realloc");
+			exit(1);
+		}
+		ts->samples = p;
+	}
+	ts->samples[ts->n++] = t;
+	ts->bytes += sz;
+
+	get_current_time(&now);
+	elapsed = timespec_to_ns(&now) - ts->start;
+	if (elapsed < ts->next)
+		return 0;
+	ts_print(ts, timespec_to_ns(&now));
+	ts->n = 0;
+	ts->bytes = 0;
+	while (ts->next <= elapsed)
+		ts->next += interval;
+	return elapsed >= duration;
+}
+
+/*
+ * CPU placement and scheduling
+ */
+
+static long cpu_capacity(int cpu)
+{
+	char path[64];
+
+	snprintf(path, sizeof(path),
+		 "/sys/devices/system/cpu/cpu%d/cpu_capacity", cpu);
+	return read_sysfs_long(path);
+}
+
+static long cpu_max_freq(int cpu)
+{
+	char path[80];
+
+	snprintf(path, sizeof(path),
+		 "/sys/devices/system/cpu/cpu%d/cpufreq/cpuinfo_max_freq", cpu);
+	return read_sysfs_long(path);
+}
+
+/* CPUs that cannot be hot-unplugged (usually CPU 0) have no "online" file */
+static int cpu_online(int cpu)
+{
+	char path[64];
+
+	snprintf(path, sizeof(path), "/sys/devices/system/cpu/cpu%d/online",
+		 cpu);
+	if (access(path, F_OK) < 0)
+		return 1;
+	return read_sysfs_long(path) == 1;
+}
+
+/*
+ * Select the first online CPU of each distinct cpu_capacity value. Without
+ * cpu_capacity in sysfs, all CPUs are considered identical and the first
+ * online CPU is used. CPUs that are offline (hot-unplugged) are skipped.
+ */
+static void select_cluster_cpus(void)
+{
+	long caps[MAX_CPUS];
+	long cap;
+	int ncpu = sysconf(_SC_NPROCESSORS_CONF);
+	int cpu, i;
+
+	num_cpus = 0;
+	for (cpu = 0; cpu < ncpu && cpu < MAX_CPUS; cpu++) {
+		if (!cpu_online(cpu))
+			continue;
+		cap = cpu_capacity(cpu);
+		for (i = 0; i < num_cpus; i++)
+			if (caps[i] == cap)
+				break;
+		if (i < num_cpus)
+			continue;
+		caps[num_cpus] = cap;
+		cpus[num_cpus++] = cpu;
+	}
+	if (!num_cpus)
+		cpus[num_cpus++] = 0;
+}
+
+static void pin_to_cpu(int cpu)
+{
+	cpu_set_t set;
+
+	CPU_ZERO(&set);
+	CPU_SET(cpu, &set);
+	if (sched_setaffinity(0, sizeof(set), &set) < 0) {
+		perror("sched_setaffinity");
+		exit(1);
+	}
+}
+
+static void set_sched(void)
+{
+	struct sched_param param;
+
+	memset(&param, 0, sizeof(param));
+	if (sched_policy != SCHED_OTHER)
+		param.sched_priority = sched_prio;
+	if (sched_setscheduler(0, sched_policy, &param) < 0) {
+		perror("sched_setscheduler");
+		exit(1);
+	}
+}
+
+/* Parse --sched argument. Returns -1 on error. */
+static int parse_sched(const char *s)
+{
+	const char *colon = strchr(s, ':');
+	size_t len = colon ? (size_t)(colon - s) : strlen(s);
+	int min, max;
+
+	if (len == 4 && !strncasecmp(s, "fifo", len))
+		sched_policy = SCHED_FIFO;
+	else if (len == 2 && !strncasecmp(s, "rr", len))
+		sched_policy = SCHED_RR;
+	else if (len == 5 && !strncasecmp(s, "other", len))
+		sched_policy = SCHED_OTHER;
+	else
+		return -1;
+
+	if (sched_policy == SCHED_OTHER)
+		return colon ? -1 : 0;
+
+	min = sched_get_priority_min(sched_policy);
+	max = sched_get_priority_max(sched_policy);
+	sched_prio = colon ? atoi(colon + 1) : max;
+	if (sched_prio < min || sched_prio > max)
+		return -1;
+	return 0;
+}
+
+/* Parse --cpu argument. Returns -1 on error. */
+static int parse_cpus(const char *s)
+{
+	char *end;
+	long cpu;
+
+	if (!strcasecmp(s, "clusters")) {
+		select_cluster_cpus();
+		return 0;
+	}
+	num_cpus = 0;
+	do {
+		if (num_cpus == MAX_CPUS)
+			return -1;
+		cpu = strtol(s, &end, 0);
+		if (end == s || cpu < 0 || cpu >= CPU_SETSIZE ||
+		    (*end && *end != ','))
+			return -1;
+		cpus[num_cpus++] = cpu;
+		s = end + 1;
+	} while (*end);
+	return 0;
+}
+
+static const char *yesno(int v)
+{
+	return (v ? "yes" : "no");
+}
+
+static int add_bucket(size_t sz, unsigned int weight)
+{
+	struct size_bucket *p;
+
+	p = realloc(size_dist, (num_buckets + 1) * sizeof(*p));
+	if (!p) {
+		perror("realloc");
+		exit(1);
+	}
+	size_dist = p;
+	size_dist[num_buckets].size = sz;
+	size_dist[num_buckets].weight = weight;
+	return num_buckets++;
+}
+
+/* Read a recorded list of sizes, one bucket per distinct size */
+static int read_replay_file(const char *path)
+{
+	FILE *f;
+	unsigned long long v;
+	int *p;
+	int b;
+
+	f = fopen(path, "r");
+	if (!f) {
+		perror(path);
+		return -1;
+	}
+	while (fscanf(f, "%llu%*[^0-9]", &v) == 1) {
+		if (!v)
+			break;
+		for (b = 0; b < num_buckets; b++)
+			if (size_dist[b].size == v)
+				break;
+		if (b == num_buckets)
+			add_bucket(v, 0);
+		size_dist[b].weight++;
+		p = realloc(replay, (replay_len + 1) * sizeof(*p));
+		if (!p) {
+			perror("realloc");
+			exit(1);
+		}
+		replay = p;
+		replay[replay_len++] = b;
+	}
+	fclose(f);
+	return replay_len ? 0 : -1;
+}
+
+/* Parse --size-dist argument. Returns -1 on error. */
+static int parse_size_dist(const char *s)
+{
+	char buf[256];
+	char *tok;
+	char *saveptr;
+	char *colon;
+	size_t sz;
+	unsigned long w;
+
+	if (!strcasecmp(s, "imix"))
+		s = "40:7,576:4,1500:1";
+	else if (!strcasecmp(s, "storage"))
+		s = "4K:50,8K:10,16K:10,64K:15,128K:10,1M:5";
+	else if (*s == '@')
+		return read_replay_file(s + 1);
+
+	snprintf(buf, sizeof(buf), "%s", s);
+	for (tok = strtok_r(buf, ",", &saveptr); tok;
+	     tok = strtok_r(NULL, ",", &saveptr)) {
+		colon = strchr(tok, ':');
+		w = 1;
+		if (colon) {
+			*colon = '\0';
+			w = strtoul(colon + 1, NULL, 0);
+		}
+		sz = parse_size(tok);
+		if (!sz || !w)
+			return -1;
+		add_bucket(sz, w);
+	}
+	return num_buckets ? 0 : -1;
+}
+
+/*
+ * Round bucket sizes up to the AES block size where the mode requires it, and
+ * return the largest size.
+ */
+static size_t finalize_size_dist(void)
+{
+	size_t max = 0;
+	int b;
+
+	for (b = 0; b < num_buckets; b++) {
+		if (needs_blocks(cfg->mode))
+			size_dist[b].size = (size_dist[b].size + 15) & ~15UL;
+		if (size_dist[b].size > max)
+			max = size_dist[b].size;
+		total_weight += size_dist[b].weight;
+	}
+	return max;
+}
+
+/* Pick the bucket for invocation number i (xorshift PRNG, fixed seed) */
+static int draw_bucket(unsigned int i)
+{
+	static uint32_t x = 2463534242U;
+	uint32_t r;
+	int b;
+
+	if (replay)
+		return replay[i % replay_len];
+	x ^= x << 13;
+	x ^= x >> 17;
+	x ^= x << 5;
+	r = x % total_weight;
+	for (b = 0; r >= size_dist[b].weight; b++)
+		r -= size_dist[b].weight;
+	return b;
+}
+
+static void print_size_dist(struct aesperf_stats *bstats)
+{
+	struct aesperf_stats all;
+	int b;
+
+	memset(&all, 0, sizeof(all));
+	for (b = 0; b < num_buckets; b++)
+		all.bytes += bstats[b].bytes;
+	printf("%10s %8s %10s %10s %12s %8s\n", "size", "weight", "count",
+	       "mean(μs)", "MiB/s", "bytes");
+	for (b = 0; b < num_buckets; b++) {
+		if (!bstats[b].n) {
+			printf("%10zu %8u %10d %10s %12s %7.1f%%\n",
+			       size_dist[b].size, size_dist[b].weight, 0, "-",
+			       "-", 0.0);
+			continue;
+		}
+		printf("%10zu %8u %10d %10.3f %12.3f %7.1f%%\n",
+		       size_dist[b].size, size_dist[b].weight, bstats[b].n,
+		       bstats[b].m/1000,
+		       aesperf_stats_mb_per_sec(&bstats[b], center),
+		       100 * bstats[b].bytes / all.bytes);
+	}
+}
+
+/* Time spent by the TA in each stage of the --copy mode */
+struct copy_stages {
+	struct aesperf_stats in;
+	struct aesperf_stats cipher;
+	struct aesperf_stats out;
+	uint32_t buf_size;
+	uint32_t flags;		/* TA_COPY_COARSE, TA_COPY_SATURATED */
+};
+
+static void update_copy_stages(struct copy_stages *cs, TEEC_Operation *op)
+{
+	aesperf_stats_update(&cs->in, op->params[3].value.a);
+	aesperf_stats_update(&cs->cipher, op->params[2].value.a);
+	aesperf_stats_update(&cs->out, op->params[3].value.b);
+	cs->buf_size = op->params[2].value.b & TA_COPY_SIZE_MASK;
+	cs->flags |= op->params[2].value.b & ~TA_COPY_SIZE_MASK;
+}
+
+static void print_copy_stages(struct copy_stages *cs)
+{
+	double total = cs->in.m + cs->cipher.m + cs->out.m;
+
+	printf("  copy-in mean=%gμs (%.1f%%), %scrypt mean=%gμs (%.1f%%), ",
+	       cs->in.m/1000, 100 * cs->in.m / total,
+	       cfg->decrypt ? "de" : "en",
+	       cs->cipher.m/1000, 100 * cs->cipher.m / total);
+	printf("copy-out mean=%gμs (%.1f%%), TA buffer %u bytes\n",
+	       cs->out.m/1000, 100 * cs->out.m / total, cs->buf_size);
+	if (cs->flags & TA_COPY_COARSE)
+		printf("  warning: the TA timer counts in ms, the stage times "
+		       "are not accurate\n");
+	if (cs->flags & TA_COPY_SATURATED)
+		printf("  warning: stage times over %gs were capped\n",
+		       UINT32_MAX / 1e9);
+}
+
+/*
+ * Configuration of a test for the results store: everything that changes
+ * what is measured. The number of samples, --precision and the warm-up time
+ * do not, they only change the confidence.
+ */
+static void config_str(char *buf, size_t len, size_t size, int cache,
+		       size_t offset, int cpu)
+{
+	int pos;
+
+	if (rng)
+		pos = snprintf(buf, len, "RNG");
+	else
+		pos = snprintf(buf, len, "%s %s keysize=%d",
+			       mode_str(cfg->mode), op_str(), cfg->keysize);
+	pos += snprintf(buf + pos, len - pos, " size=%zu l=%u random=%d "
+			"in-place=%d cache=%s offset=%zu shm=%s timer=%s "
+			"cpu=%d ta=%s", size, l, cfg->random,
+			cfg->in_place, cache_str(cache), offset,
+			cfg->shm_type == AESPERF_SHM_REGISTERED ?
+			"register" : "alloc",
+			cfg->timer == AESPERF_TIMER_COUNTER ?
+			"counter" : "clock",
+			cpu, ta_model_str(cfg->ta_model));
+	if (cfg->final && (size_t)pos < len)
+		pos += snprintf(buf + pos, len - pos, " final");
+	if (copy && (size_t)pos < len)
+		pos += snprintf(buf + pos, len - pos, " copy=%zu",
+				copy_chunk);
+	if (sched_policy >= 0 && (size_t)pos < len)
+		pos += snprintf(buf + pos, len - pos, " sched=%d:%d",
+				sched_policy, sched_prio);
+	if (lock_mem && (size_t)pos < len)
+		pos += snprintf(buf + pos, len - pos, " mlock");
+	if (size_dist_spec && (size_t)pos < len)
+		snprintf(buf + pos, len - pos, " size-dist=%s",
+			 size_dist_spec);
+}
+
+/* Append the results of run_test() to the store */
+static void store_result(struct aesperf_stats *s, const uint64_t *samples,
+			 size_t size, int cache, size_t offset)
+{
+	struct results_record r;
+	uint32_t hist[RESULTS_HIST_BUCKETS];
+
+	memset(&r, 0, sizeof(r));
+	config_str(r.config, sizeof(r.config), size, cache, offset,
+		   num_cpus ? get_current_cpu() : -1);
+	results_env(r.env, sizeof(r.env), TO_STR(VERSION));
+	r.n = s->n;
+	r.min = s->min;
+	r.max = s->max;
+	r.mean = s->m;
+	r.stddev = aesperf_stats_stddev(s);
+	r.median = s->median;
+	r.mad = s->mad;
+	r.q1 = s->q1;
+	r.q3 = s->q3;
+	r.trimmed = s->trimmed;
+	r.mib_s = aesperf_stats_mb_per_sec(s, AESPERF_CENTER_MEAN);
+	if (store_hist)
+		results_hist(&r, hist, samples, s->n);
+	if (results_append(store_path, &r, store_hist ? hist : NULL) < 0)
+		fprintf(stderr, "Results not stored\n");
+}
+
+/* Keep the results of run_test() for --plot; samples are sorted */
+static void plot_record(struct aesperf_stats *s, const uint64_t *samples,
+			size_t size, int cache, size_t offset)
+{
+	struct plot_run *p;
+	int cpu = num_cpus ? get_current_cpu() : -1;
+	size_t len;
+	int i;
+
+	p = realloc(plot_runs, (num_plot_runs + 1) * sizeof(*p));
+	if (!p) {
+		perror("realloc");
+		exit(1);
+	}
+	plot_runs = p;
+	p = &plot_runs[num_plot_runs++];
+	memset(p, 0, sizeof(*p));
+	config_str(p->config, sizeof(p->config), size, cache, offset, cpu);
+	if (cur_scenario)
+		snprintf(p->series, sizeof(p->series), "%s", cur_scenario);
+	else if (rng)
+		snprintf(p->series, sizeof(p->series), "RNG");
+	else if (is_hash_mode(cfg->mode) && cfg->mode < TA_HMAC_SHA256)
+		snprintf(p->series, sizeof(p->series), "%s",
+			 mode_str(cfg->mode));
+	else
+		snprintf(p->series, sizeof(p->series), "%s-%d %s",
+			 mode_str(cfg->mode), cfg->keysize, op_str());
+	/* Only what varies within this run */
+	len = strlen(p->series);
+	if (num_cpus > 1)
+		len += snprintf(p->series + len, sizeof(p->series) - len,
+				" cpu=%d", cpu);
+	if (num_ta_models > 1 && len < sizeof(p->series))
+		len += snprintf(p->series + len, sizeof(p->series) - len,
+				" ta=%s", ta_model_str(cfg->ta_model));
+	if (num_cache_modes > 1 && len < sizeof(p->series))
+		len += snprintf(p->series + len, sizeof(p->series) - len,
+				" cache=%s", cache_str(cache));
+	if (num_offsets > 1 && len < sizeof(p->series))
+		snprintf(p->series + len, sizeof(p->series) - len,
+			 " offset=%zu", offset);
+	p->size = size;
+	p->mib_s = aesperf_stats_mb_per_sec(s, AESPERF_CENTER_MEAN);
+	for (i = 0; i < PLOT_CDF_POINTS; i++)
+		p->cdf[i] = aesperf_quantile(samples, s->n,
+				     (double)i / (PLOT_CDF_POINTS - 1)) / 1000;
+}
+
+static int cmp_plot_size(const void *a, const void *b)
+{
+	const struct plot_run *x = a;
+	const struct plot_run *y = b;
+
+	return (x->size > y->size) - (x->size < y->size);
+}
+
+/*
+ * Throughput versus size: one series per mode, key size and variant, with
+ * their baselines
+ */
+static int plot_throughput(const char *path)
+{
+	struct plot_series *series;
+	struct results_record r;
+	struct plot_run *runs;
+	uint32_t *hist;
+	double *x;
+	double *y;
+	struct plot plot = {
+		.title = "Throughput",
+		.xlabel = "Buffer size (bytes)",
+		.ylabel = "MiB/s",
+		.xscale = PLOT_LOG2,
+	};
+	int num_series = 0;
+	int ret;
+	int i, j, k;
+
+	/* Group by series, each sorted by size */
+	runs = malloc(num_plot_runs * sizeof(*runs));
+	series = calloc(2 * num_plot_runs, sizeof(*series));
+	x = malloc(2 * num_plot_runs * sizeof(*x));
+	y = malloc(2 * num_plot_runs * sizeof(*y));
+	hist = malloc(RESULTS_HIST_BUCKETS * sizeof(*hist));
+	if (!runs || !series || !x || !y || !hist) {
+		perror("malloc");
+		exit(1);
+	}
+	k = 0;
+	for (i = 0; i < num_plot_runs; i++) {
+		for (j = 0; j < i; j++)
+			if (!strcmp(plot_runs[j].series, plot_runs[i].series))
+				break;
+		if (j < i)
+			continue;
+		series[num_series].label = plot_runs[i].series;
+		series[num_series].color = num_series;
+		series[num_series].x = x + k;
+		series[num_series].y = y + k;
+		for (j = i; j < num_plot_runs; j++)
+			if (!strcmp(plot_runs[j].series, plot_runs[i].series))
+				runs[k + series[num_series].n++] =
+					plot_runs[j];
+		qsort(runs + k, series[num_series].n, sizeof(*runs),
+		      cmp_plot_size);
+		for (j = 0; j < (int)series[num_series].n; j++) {
+			x[k + j] = runs[k + j].size;
+			y[k + j] = runs[k + j].mib_s;
+		}
+		k += series[num_series].n;
+		num_series++;
+	}
+
+	/* Baselines, dashed, in the color of their series */
+	for (i = 0, j = num_series; i < j && baseline; i++) {
+		struct plot_series *b = &series[num_series];
+		const struct plot_run *first = runs + (series[i].x - x);
+		char *label;
+		int m;
+
+		b->x = x + k;
+		b->y = y + k;
+		for (m = 0; m < (int)series[i].n; m++) {
+			if (results_latest(baseline, first[m].config, &r,
+					   hist) <= 0)
+				continue;
+			x[k] = first[m].size;
+			y[k++] = r.mib_s;
+			b->n++;
+		}
+		if (!b->n)
+			continue;
+		label = malloc(sizeof(first->series) + 16);
+		if (!label) {
+			perror("malloc");
+			exit(1);
+		}
+		sprintf(label, "%s (baseline)", series[i].label);
+		b->label = label;
+		b->color = series[i].color;
+		b->dashed = 1;
+		num_series++;
+	}
+
+	plot.num_series = num_series;
+	plot.series = series;
+	ret = plot_svg(path, &plot);
+
+	for (i = 0; i < num_series; i++)
+		if (series[i].dashed)
+			free((char *)series[i].label);
+	free(hist);
+	free(y);
+	free(x);
+	free(series);
+	free(runs);
+	return ret;
+}
+
+/* Latency CDF of a run, with its baseline */
+static int plot_latency(const char *path, struct plot_run *p)
+{
+	double pct[PLOT_CDF_POINTS];
+	double base[PLOT_CDF_POINTS];
+	struct plot_series series[2];
+	struct results_record r;
+	uint32_t hist[RESULTS_HIST_BUCKETS];
+	char title[128];
+	struct plot plot = {
+		.title = title,
+		.xlabel = "Latency (μs)",
+		.ylabel = "Invocations (%)",
+		.xscale = PLOT_LOG10,
+		.ymin = 0,
+		.ymax = 100,
+		.num_series = 1,
+		.series = series,
+	};
+	int i;
+
+	for (i = 0; i < PLOT_CDF_POINTS; i++)
+		pct[i] = 100.0 * i / (PLOT_CDF_POINTS - 1);
+	snprintf(title, sizeof(title), "Latency CDF: %s, %zu bytes",
+		 p->series, p->size);
+	memset(series, 0, sizeof(series));
+	series[0].label = "this run";
+	series[0].n = PLOT_CDF_POINTS;
+	series[0].x = p->cdf;
+	series[0].y = pct;
+	if (baseline && results_latest(baseline, p->config, &r, hist) > 0) {
+		if (results_cdf(&r, hist, base, PLOT_CDF_POINTS) < 0) {
+			fprintf(stderr, "%s: no histogram in the baseline ",
+				path);
+			fprintf(stderr, "(see --store-hist)\n");
+		} else {
+			for (i = 0; i < PLOT_CDF_POINTS; i++)
+				base[i] /= 1000;
+			series[1].label = "baseline";
+			series[1].dashed = 1;
+			series[1].n = PLOT_CDF_POINTS;
+			series[1].x = base;
+			series[1].y = pct;
+			plot.num_series = 2;
+		}
+	}
+	return plot_svg(path, &plot);
+}
+
+/* Write the charts of --plot */
+static void write_plots(void)
+{
+	char path[PATH_MAX];
+	int charts = 0;
+	int i;
+
+	if (!num_plot_runs) {
+		fprintf(stderr, "%s: nothing to plot\n", plot_dir);
+		return;
+	}
+	if (mkdir(plot_dir, 0755) < 0 && errno != EEXIST) {
+		perror(plot_dir);
+		return;
+	}
+	snprintf(path, sizeof(path), "%s/throughput.svg", plot_dir);
+	if (!plot_throughput(path))
+		charts++;
+	for (i = 0; i < num_plot_runs; i++) {
+		snprintf(path, sizeof(path), "%s/latency-%02d.svg", plot_dir,
+			 i + 1);
+		if (!plot_latency(path, &plot_runs[i]))
+			charts++;
+	}
+	printf("%d charts written to %s\n", charts, plot_dir);
+	free(plot_runs);
+	plot_runs = NULL;
+	num_plot_runs = 0;
+}
+
+/*
+ * Encryption test: buffer of tsize byte. Run test n times.
+ * In CACHE_ROTATE mode, the shared buffers hold nbufs slots of size bytes
+ * (rounded up to a cache line) and each invocation uses the next slot, so
+ * that the total working set is at least twice the LLC size.
+ */
+static void run_test(size_t size, unsigned int n, unsigned int l, int cache,
+		     size_t offset, struct aesperf_stats *stats)
+{
+	uint64_t t;
+	int n0 = n;
+	unsigned int iter = 0;	/* Invocations so far, also with duration */
+	size_t stride = size;
+	size_t nbufs = 1;
+	size_t slot = 0;
+	size_t sz = size;
+	struct aesperf_stats *bstats = NULL;
+	int b = 0;
+	struct ts_interval ts;
+	int done = 0;
+	struct copy_stages cs;
+	struct outliers ol;
+	int attribute = 0;
+	uint64_t *samples;
+	size_t max_samples = duration ? 1024 : n;
+
+	memset(stats, 0, sizeof(*stats));
+	memset(&cs, 0, sizeof(cs));
+	samples = malloc(max_samples * sizeof(*samples));
+	if (!samples) {
+		perror("malloc");
+		exit(1);
+	}
+	if (size_dist) {
+		bstats = calloc(num_buckets, sizeof(*bstats));
+		if (!bstats) {
+			perror("calloc");
+			exit(1);
+		}
+	}
+
+	if (cache == CACHE_COLD)
+		alloc_scratch();
+	if (cache == CACHE_ROTATE) {
+		stride = (size + CACHE_LINE - 1) & ~(size_t)(CACHE_LINE - 1);
+		nbufs = 2 * llc_size / (stride * (cfg->in_place ? 1 : 2)) + 1;
+		if (nbufs < 2)
+			nbufs = 2;
+	}
+
+	cfg->size = size;
+	cfg->loops = l;
+	setup_shm(stride * nbufs + offset);
+
+	if (rng)
+		verbose("Starting test: RNG, size=%zu bytes%s, ", size,
+			size_dist ? " (max)" : "");
+	else
+		verbose("Starting test: %s, %s, keysize=%u bits, "
+			"size=%zu bytes%s, ", mode_str(cfg->mode), op_str(),
+			cfg->keysize, size,
+			size_dist ? " (max)" : "");
+	verbose("random=%s, ", yesno(cfg->random));
+	verbose("in place=%s, ", yesno(cfg->in_place));
+	verbose("inner loops=%u, loops=%u, warm-up=%u s, ", l, n, warmup);
+	verbose("cache=%s, offset=%zu", cache_str(cache), offset);
+	if (copy)
+		verbose(", copy chunk=%zu", copy_chunk);
+	if (duration)
+		verbose(", duration=%gs", (double)duration / 1000000000);
+	if (cache == CACHE_ROTATE)
+		verbose(" (%zu buffers)", nbufs);
+	verbose("\n");
+
+	if (warmup)
+		do_warmup();
+
+	if (duration)
+		ts_start(&ts);
+	if (outlier_pct) {
+		/* Only count the interrupts of our CPU when pinned */
+		attribute = !outliers_init(&ol, n,
+					   num_cpus ? get_current_cpu() : -1);
+		if (!attribute)
+			fprintf(stderr, "Outlier attribution disabled\n");
+	}
+
+	while (duration ? !done : n-- > 0) {
+		if (size_dist) {
+			b = draw_bucket(iter);
+			sz = size_dist[b].size;
+		}
+		if (copy) {
+			/* Overwritten by the stage times */
+			ap.op.params[2].value.a = l;
+			ap.op.params[2].value.b = copy_chunk;
+		}
+		t = run_test_once(slot * stride + offset, sz, l, cache);
+		if ((size_t)stats->n == max_samples) {
+			uint64_t *p;
+
+			max_samples *= 2;
+			p = realloc(samples, max_samples * sizeof(*p));
+			if (!p) {
+				perror("realloc");
+				exit(1);
+			}
+			samples = p;
+		}
+		samples[stats->n] = t;
+		aesperf_stats_update(stats, t);
+		stats->bytes += sz;
+		if (attribute)
+			outliers_record(&ol, t);
+		if (copy)
+			update_copy_stages(&cs, &ap.op);
+		if (bstats) {
+			aesperf_stats_update(&bstats[b], t);
+			bstats[b].bytes += sz;
+		}
+		if (++slot == nbufs)
+			slot = 0;
+		iter++;
+		if (duration)
+			done = ts_update(&ts, t, sz);
+		else if (n % (n0/10) == 0)
+			vverbose("#");
+		/* -n is the maximum number of samples */
+		if (precision && !duration && stats->n % 100 == 0 &&
+		    aesperf_stats_ci_pct(stats) <= precision)
+			break;
+	}
+	if (duration)
+		free(ts.samples);
+	else
+		vverbose("\n");
+	if (rng_sweep)
+		printf("size=%zu: ", size);
+	if (num_cache_modes > 1)
+		printf("cache=%s: ", cache_str(cache));
+	if (num_offsets > 1)
+		printf("offset=%zu: ", offset);
+	aesperf_stats_robust(stats, samples, stats->n);
+	if (store_path)
+		store_result(stats, samples, size, cache, offset);
+	if (plot_dir)
+		plot_record(stats, samples, size, cache, offset);
+	free(samples);
+	aesperf_report(stdout, stats, center);
+	if (precision)
+		printf("precision: ±%.2f%% (95%% CI) after %d samples\n",
+		       aesperf_stats_ci_pct(stats), stats->n);
+	if (copy)
+		print_copy_stages(&cs);
+	if (attribute) {
+		outliers_report(&ol, outlier_pct);
+		outliers_free(&ol);
+	}
+	if (bstats) {
+		print_size_dist(bstats);
+		free(bstats);
+	}
+	free_shm();
+}
+
+/* Print latency deltas of each cache mode against the first one */
+static void print_cache_deltas(struct aesperf_stats stats[][MAX_OFFSETS])
+{
+	struct aesperf_stats *s0;
+	struct aesperf_stats *s;
+	int i, j;
+
+	for (i = 1; i < num_cache_modes; i++) {
+		for (j = 0; j < num_offsets; j++) {
+			s0 = &stats[0][j];
+			s = &stats[i][j];
+			printf("cache=%s vs %s: ", cache_str(cache_modes[i]),
+			       cache_str(cache_modes[0]));
+			if (num_offsets > 1)
+				printf("offset=%zu: ", offsets[j]);
+			printf("min %+gμs (%+.1f%%) mean %+gμs (%+.1f%%)\n",
+			       (s->min - s0->min)/1000,
+			       100 * (s->min - s0->min) / s0->min,
+			       (s->m - s0->m)/1000,
+			       100 * (s->m - s0->m) / s0->m);
+		}
+	}
+}
+
+/* Print throughput per offset, relative to the first offset */
+static void print_offset_table(struct aesperf_stats stats[][MAX_OFFSETS])
+{
+	double ref;
+	double mbs;
+	int i, j;
+
+	if (num_offsets < 2)
+		return;
+	for (i = 0; i < num_cache_modes; i++) {
+		printf("Offset sweep (cache=%s):\n", cache_str(cache_modes[i]));
+		printf("%8s %12s %8s\n", "offset", "MiB/s", "delta");
+		ref = aesperf_stats_mb_per_sec(&stats[i][0], center);
+		for (j = 0; j < num_offsets; j++) {
+			mbs = aesperf_stats_mb_per_sec(&stats[i][j], center);
+			printf("%8zu %12.3f %+7.1f%%\n", offsets[j], mbs,
+			       100 * (mbs - ref) / ref);
+		}
+	}
+}
+
+/* Parse a comma-separated list of offsets or "sweep". Returns -1 on error. */
+static int parse_offsets(const char *s)
+{
+	size_t page_size = sysconf(_SC_PAGESIZE);
+	static const size_t sweep[] = { 0, 1, 4, 8, 15, 16, 64, 128 };
+	char *end;
+	int i = 0;
+
+	if (!strcasecmp(s, "sweep")) {
+		for (i = 0; i < (int)(sizeof(sweep)/sizeof(sweep[0])); i++)
+			offsets[i] = sweep[i];
+		offsets[i++] = page_size / 2;
+		offsets[i++] = page_size - 16;
+		num_offsets = i;
+		return 0;
+	}
+	do {
+		if (i == MAX_OFFSETS)
+			return -1;
+		offsets[i++] = strtoul(s, &end, 0);
+		if (end == s || (*end && *end != ','))
+			return -1;
+		s = end + 1;
+	} while (*end);
+	num_offsets = i;
+	return 0;
+}
+
+/* Parse a comma-separated list of cache modes. Returns -1 on error. */
+static int parse_cache_modes(const char *s)
+{
+	char buf[64];
+	char *tok;
+	char *saveptr;
+	int i = 0;
+
+	snprintf(buf, sizeof(buf), "%s", s);
+	for (tok = strtok_r(buf, ",", &saveptr); tok;
+	     tok = strtok_r(NULL, ",", &saveptr)) {
+		if (i == 3)
+			return -1;
+		if (!strcasecmp(tok, "warm"))
+			cache_modes[i++] = CACHE_WARM;
+		else if (!strcasecmp(tok, "cold"))
+			cache_modes[i++] = CACHE_COLD;
+		else if (!strcasecmp(tok, "rotate"))
+			cache_modes[i++] = CACHE_ROTATE;
+		else
+			return -1;
+	}
+	if (!i)
+		return -1;
+	num_cache_modes = i;
+	return 0;
+}
+
+/*
+ * Asynchronous mode
+ *
+ * The main thread keeps up to qd requests in flight. It pushes them to a
+ * submission ring served by qd invoker threads, each with its own session,
+ * and polls a completion ring for finished requests. Each request in flight
+ * uses its own slot of the shared buffers.
+ */
+
+#define ASYNC_STOP	UINT_MAX
+
+struct async_req {
+	unsigned int slot;
+	uint64_t submit;	/* Pushed to the submission ring */
+	uint64_t start;		/* TEEC_InvokeCommand() called */
+	uint64_t end;		/* TEEC_InvokeCommand() returned */
+	TEEC_Result res;
+};
+
+struct invoker {
+	pthread_t thread;
+	TEEC_Session sess;
+	struct ring *sub;
+	struct ring *comp;
+	size_t size;
+	size_t stride;
+	unsigned int l;
+};
+
+struct async_result {
+	unsigned int qd;
+	unsigned int instances;		/* TA instances serving the sessions */
+	size_t footprint;		/* Memory reserved by these instances */
+	struct aesperf_stats lat;		/* Submission to completion */
+	struct aesperf_stats svc;		/* TEEC_InvokeCommand() only */
+	uint64_t p50;
+	uint64_t p99;
+	double mbs;			/* Throughput over wall time */
+};
+
+static uint64_t now_ns(void)
+{
+	struct timespec ts;
+
+	get_current_time(&ts);
+	return timespec_to_ns(&ts);
+}
+
+static struct ring *alloc_ring(size_t count, size_t entry_size)
+{
+	struct ring *r;
+	size_t n = 1;
+
+	while (n < count)
+		n <<= 1;
+	if (posix_memalign((void **)&r, 64, ring_mem_size(n, entry_size))) {
+		fprintf(stderr, "posix_memalign failed\n");
+		exit(1);
+	}
+	ring_init(r, n, entry_size);
+	return r;
+}
+
+static void *invoker_thread(void *arg)
+{
+	struct invoker *inv = arg;
+	struct async_req req;
+	TEEC_Operation op;
+	uint32_t ret_origin;
+
+	memset(&op, 0, sizeof(op));
+	op.paramTypes = TEEC_PARAM_TYPES(TEEC_MEMREF_PARTIAL_INOUT,
+					 TEEC_MEMREF_PARTIAL_INOUT,
+					 TEEC_VALUE_INPUT, TEEC_NONE);
+	op.params[0].memref.parent = &ap.in_shm;
+	op.params[0].memref.size = inv->size;
+	op.params[1].memref.parent = cfg->in_place ? &ap.in_shm : &ap.out_shm;
+	op.params[1].memref.size = inv->size;
+	op.params[2].value.a = inv->l;
+
+	for (;;) {
+		while (ring_pop(inv->sub, &req))
+			sched_yield();
+		if (req.slot == ASYNC_STOP)
+			break;
+		op.params[0].memref.offset = req.slot * inv->stride;
+		op.params[1].memref.offset = req.slot * inv->stride;
+		req.start = now_ns();
+		req.res = TEEC_InvokeCommand(&inv->sess, cfg->cmd, &op,
+					     &ret_origin);
+		req.end = now_ns();
+		while (ring_push(inv->comp, &req))
+			sched_yield();
+	}
+	return NULL;
+}
+
+static void run_async(size_t size, unsigned int n, unsigned int l,
+		      unsigned int qd, struct async_result *r)
+{
+	struct invoker inv[MAX_QD];
+	unsigned int free_slots[MAX_QD];
+	unsigned int nfree = qd;
+	struct ring *sub;
+	struct ring *comp;
+	struct async_req req;
+	uint64_t *samples;
+	size_t stride = (size + CACHE_LINE - 1) & ~(size_t)(CACHE_LINE - 1);
+	unsigned int submitted = 0;
+	unsigned int completed = 0;
+	uint64_t t0, t1;
+	unsigned int i;
+	uint32_t sessions;
+	uint32_t inst_size = 0;
+	double instances = 0;
+
+	memset(r, 0, sizeof(*r));
+	r->qd = qd;
+	samples = malloc(n * sizeof(*samples));
+	if (!samples) {
+		perror("malloc");
+		exit(1);
+	}
+	/* Room for qd requests plus qd stop requests */
+	sub = alloc_ring(2 * qd, sizeof(req));
+	comp = alloc_ring(qd, sizeof(req));
+
+	alloc_shm(stride * qd);
+	if (cfg->random)
+		read_random(ap.in_shm.buffer, stride * qd);
+	else
+		memset(ap.in_shm.buffer, 0, stride * qd);
+
+	for (i = 0; i < qd; i++) {
+		free_slots[i] = i;
+		inv[i].sub = sub;
+		inv[i].comp = comp;
+		inv[i].size = size;
+		inv[i].stride = stride;
+		inv[i].l = l;
+		open_session(&inv[i].sess);
+		prepare_key(&inv[i].sess);
+	}
+	/* Each instance serves "sessions" of the qd sessions */
+	for (i = 0; i < qd; i++) {
+		get_ta_info(&inv[i].sess, &sessions, &inst_size);
+		instances += 1.0 / sessions;
+	}
+	r->instances = instances + 0.5;
+	r->footprint = (size_t)r->instances * inst_size;
+	for (i = 0; i < qd; i++) {
+		if (pthread_create(&inv[i].thread, NULL, invoker_thread,
+				   &inv[i])) {
+			fprintf(stderr, "pthread_create failed\n");
+			exit(1);
+		}
+	}
+
+	verbose("Starting async test: %s, %s, keysize=%u bits, ",
+		mode_str(cfg->mode), op_str(), cfg->keysize);
+	verbose("size=%zu bytes, in place=%s, inner loops=%u, loops=%u, ",
+		size, yesno(cfg->in_place), l, n);
+	verbose("qd=%u, ta=%s (%u instances)\n", qd,
+		ta_model_str(cfg->ta_model), r->instances);
+
+	if (warmup)
+		do_warmup();
+
+	t0 = now_ns();
+	while (completed < n) {
+		while (nfree && submitted < n) {
+			req.slot = free_slots[--nfree];
+			req.submit = now_ns();
+			ring_push(sub, &req);
+			submitted++;
+		}
+		if (ring_pop(comp, &req)) {
+			sched_yield();
+			continue;
+		}
+		check_res(req.res, "TEEC_InvokeCommand");
+		samples[completed++] = req.end - req.submit;
+		aesperf_stats_update(&r->lat, req.end - req.submit);
+		aesperf_stats_update(&r->svc, req.end - req.start);
+		r->lat.bytes += size;
+		free_slots[nfree++] = req.slot;
+	}
+	t1 = now_ns();
+
+	req.slot = ASYNC_STOP;
+	for (i = 0; i < qd; i++)
+		ring_push(sub, &req);
+	for (i = 0; i < qd; i++) {
+		pthread_join(inv[i].thread, NULL);
+		TEEC_CloseSession(&inv[i].sess);
+	}
+
+	aesperf_stats_robust(&r->lat, samples, n);
+	r->p50 = aesperf_percentile(samples, n, 50);
+	r->p99 = aesperf_percentile(samples, n, 99);
+	r->mbs = (1000000000.0 / (t1 - t0)) * (r->lat.bytes / (1024 * 1024));
+	printf("qd=%u: latency min=%gμs mean=%gμs p50=%gμs p99=%gμs ", qd,
+	       r->lat.min/1000, r->lat.m/1000, r->p50/1000.0, r->p99/1000.0);
+	printf("max=%gμs, invoke mean=%gμs, %u TA instances (%zuKiB) ",
+	       r->lat.max/1000, r->svc.m/1000, r->instances,
+	       r->footprint / 1024);
+	printf("(%gMiB/s)\n", r->mbs);
+
+	free(samples);
+	free(sub);
+	free(comp);
+	free_shm();
+}
+
+static void print_qd_table(struct async_result *r)
+{
+	int i;
+
+	if (num_qds < 2)
+		return;
+	printf("Queue depth scaling:\n");
+	printf("%4s %12s %8s %10s %10s %10s\n", "qd", "MiB/s", "speedup",
+	       "mean(μs)", "p50(μs)", "p99(μs)");
+	for (i = 0; i < num_qds; i++)
+		printf("%4u %12.3f %7.2fx %10.3f %10.3f %10.3f\n", r[i].qd,
+		       r[i].mbs, r[i].mbs / r[0].mbs, r[i].lat.m/1000,
+		       r[i].p50/1000.0, r[i].p99/1000.0);
+}
+
+/*
+ * Multi-process mode
+ *
+ * Each worker process opens its own TEE context and session and prepares its
+ * own key, like the independent daemons of a deployment contending for the
+ * driver and the secure threads. Once ready, the workers wait on a start
+ * barrier in an anonymous shared mapping, which also holds a ring through
+ * which they stream their latency samples to the parent.
+ */
+
+#define PROCS_RING	4096
+
+enum proc_msg_type {
+	PROC_SAMPLE,
+	PROC_DONE,
+};
+
+struct proc_msg {
+	uint32_t proc;
+	uint32_t type;
+	uint64_t val;	/* Sample (ns), or end of the run (now_ns()) */
+};
+
+struct proc_shared {
+	atomic_uint ready;	/* Workers waiting at the barrier */
+	atomic_int go;		/* 1: start, -1: abort */
+};
+
+struct proc_result {
+	pid_t pid;
+	int done;		/* PROC_DONE received */
+	int reaped;
+	uint64_t end;
+	uint64_t *samples;
+	struct aesperf_stats stats;
+};
+
+static void proc_worker(struct proc_shared *sh, struct ring *ring,
+			unsigned int id, size_t size, unsigned int n,
+			unsigned int l)
+{
+	struct proc_msg msg;
+	int go;
+
+	if (num_cpus)
+		pin_to_cpu(cpus[id % num_cpus]);
+	open_ta();
+	prepare_key(&ap.sess);
+	cfg->size = size;
+	cfg->loops = l;
+	setup_shm(size);
+
+	if (warmup)
+		do_warmup();
+
+	atomic_fetch_add(&sh->ready, 1);
+	while (!(go = atomic_load(&sh->go)))
+		sched_yield();
+	if (go < 0)
+		exit(1);
+
+	msg.proc = id;
+	msg.type = PROC_SAMPLE;
+	while (n--) {
+		msg.val = run_test_once(0, size, l, CACHE_WARM);
+		while (ring_push(ring, &msg))
+			sched_yield();
+	}
+	msg.type = PROC_DONE;
+	msg.val = now_ns();
+	while (ring_push(ring, &msg))
+		sched_yield();
+
+	free_shm();
+	close_ta();
+	exit(0);
+}
+
+/* Stop all the workers after one of them failed */
+static void procs_abort(struct proc_shared *sh, struct proc_result *r,
+			unsigned int started)
+{
+	unsigned int i;
+
+	atomic_store(&sh->go, -1);
+	for (i = 0; i < started; i++) {
+		if (r[i].reaped)
+			continue;
+		kill(r[i].pid, SIGKILL);
+		waitpid(r[i].pid, NULL, 0);
+	}
+	fprintf(stderr, "--procs: a worker process failed\n");
+	exit(1);
+}
+
+/*
+ * Reap a worker that exited, if any. Returns -1 if it failed: a worker may
+ * exit successfully before its PROC_DONE message is popped.
+ */
+static int procs_reap(struct proc_result *r, unsigned int started)
+{
+	unsigned int i;
+	int status;
+	pid_t pid;
+
+	pid = waitpid(-1, &status, WNOHANG);
+	if (pid <= 0)
+		return 0;
+	for (i = 0; i < started; i++)
+		if (r[i].pid == pid)
+			r[i].reaped = 1;
+	return WIFEXITED(status) && !WEXITSTATUS(status) ? 0 : -1;
+}
+
+static void print_procs(struct proc_result *r, size_t size, unsigned int n,
+			uint64_t t0)
+{
+	struct aesperf_stats all;
+	uint64_t *samples;
+	uint64_t end = t0;
+	double mbs;
+	double min_mbs = 0;
+	double max_mbs = 0;
+	unsigned int i;
+	size_t k = 0;
+
+	memset(&all, 0, sizeof(all));
+	samples = malloc((size_t)procs * n * sizeof(*samples));
+	if (!samples) {
+		perror("malloc");
+		exit(1);
+	}
+
+	printf("Per process, %u invocations of %zu bytes:\n", n, size);
+	printf("%4s %8s %12s %10s %10s %10s %10s %10s\n", "proc", "pid",
+	       "MiB/s", "mean(μs)", "p50(μs)", "p99(μs)", "p99.9(μs)",
+	       "max(μs)");
+	for (i = 0; i < procs; i++) {
+		if (r[i].end > end)
+			end = r[i].end;
+		memcpy(samples + k, r[i].samples,
+		       r[i].stats.n * sizeof(*samples));
+		k += r[i].stats.n;
+		all.bytes += r[i].stats.bytes;
+		aesperf_stats_robust(&r[i].stats, r[i].samples, r[i].stats.n);
+		mbs = (1000000000.0 / (r[i].end - t0)) *
+		      (r[i].stats.bytes / (1024 * 1024));
+		if (!i || mbs < min_mbs)
+			min_mbs = mbs;
+		if (!i || mbs > max_mbs)
+			max_mbs = mbs;
+		printf("%4u %8d %12.3f %10.3f %10.3f %10.3f %10.3f %10.3f\n",
+		       i, (int)r[i].pid, mbs, r[i].stats.m/1000,
+		       aesperf_percentile(r[i].samples, r[i].stats.n, 50) /
+		       1000.0,
+		       aesperf_percentile(r[i].samples, r[i].stats.n, 99) /
+		       1000.0,
+		       aesperf_percentile(r[i].samples, r[i].stats.n, 99.9) /
+		       1000.0,
+		       r[i].stats.max/1000);
+	}
+	for (i = 0; i < k; i++)
+		aesperf_stats_update(&all, samples[i]);
+	aesperf_stats_robust(&all, samples, k);
+
+	mbs = (1000000000.0 / (end - t0)) * (all.bytes / (1024 * 1024));
+	printf("procs=%u: aggregate %gMiB/s over %gs, slowest process ",
+	       procs, mbs, (end - t0) / 1000000000.0);
+	printf("%.1f%% of the fastest\n", 100 * min_mbs / max_mbs);
+	printf("procs=%u: latency min=%gμs mean=%gμs p50=%gμs p99=%gμs ",
+	       procs, all.min/1000, all.m/1000,
+	       aesperf_percentile(samples, k, 50) / 1000.0,
+	       aesperf_percentile(samples, k, 99) / 1000.0);
+	printf("p99.9=%gμs max=%gμs\n",
+	       aesperf_percentile(samples, k, 99.9) / 1000.0, all.max/1000);
+	free(samples);
+}
+
+static void run_procs(size_t size, unsigned int n, unsigned int l)
+{
+	size_t hdr = (sizeof(struct proc_shared) + 63) & ~(size_t)63;
+	size_t len = hdr + ring_mem_size(PROCS_RING, sizeof(struct proc_msg));
+	struct proc_shared *sh;
+	struct proc_result *r;
+	struct ring *ring;
+	struct proc_msg msg;
+	unsigned int remaining = procs;
+	unsigned int i;
+	uint64_t t0;
+	pid_t pid;
+
+	sh = mmap(NULL, len, PROT_READ | PROT_WRITE,
+		  MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+	if (sh == MAP_FAILED) {
+		perror("mmap");
+		exit(1);
+	}
+	atomic_init(&sh->ready, 0);
+	atomic_init(&sh->go, 0);
+	ring = (struct ring *)((uint8_t *)sh + hdr);
+	ring_init(ring, PROCS_RING, sizeof(msg));
+
+	r = calloc(procs, sizeof(*r));
+	if (!r) {
+		perror("calloc");
+		exit(1);
+	}
+	for (i = 0; i < procs; i++) {
+		r[i].samples = malloc(n * sizeof(*r[i].samples));
+		if (!r[i].samples) {
+			perror("malloc");
+			exit(1);
+		}
+	}
+
+	verbose("Starting multi-process test: %s, %s, keysize=%u bits, ",
+		mode_str(cfg->mode), op_str(), cfg->keysize);
+	verbose("size=%zu bytes, in place=%s, inner loops=%u, loops=%u, ",
+		size, yesno(cfg->in_place), l, n);
+	verbose("procs=%u, ta=%s\n", procs, ta_model_str(cfg->ta_model));
+
+	/* Or the workers would flush our buffered output again */
+	fflush(stdout);
+	fflush(stderr);
+	for (i = 0; i < procs; i++) {
+		pid = fork();
+		if (pid < 0) {
+			perror("fork");
+			procs_abort(sh, r, i);
+		}
+		if (!pid)
+			proc_worker(sh, ring, i, size, n, l);
+		r[i].pid = pid;
+	}
+
+	/* Start barrier: every worker has its session, key and buffers */
+	while (atomic_load(&sh->ready) < procs) {
+		if (procs_reap(r, procs) < 0)
+			procs_abort(sh, r, procs);
+		usleep(1000);
+	}
+	t0 = now_ns();
+	atomic_store(&sh->go, 1);
+
+	while (remaining) {
+		if (ring_pop(ring, &msg)) {
+			if (procs_reap(r, procs) < 0)
+				procs_abort(sh, r, procs);
+			sched_yield();
+			continue;
+		}
+		if (msg.type == PROC_DONE) {
+			r[msg.proc].done = 1;
+			r[msg.proc].end = msg.val;
+			remaining--;
+			continue;
+		}
+		r[msg.proc].samples[r[msg.proc].stats.n] = msg.val;
+		aesperf_stats_update(&r[msg.proc].stats, msg.val);
+		r[msg.proc].stats.bytes += size;
+	}
+	for (i = 0; i < procs; i++)
+		if (!r[i].reaped)
+			waitpid(r[i].pid, NULL, 0);
+	munmap(sh, len);
+
+	print_procs(r, size, n, t0);
+	for (i = 0; i < procs; i++)
+		free(r[i].samples);
+	free(r);
+}
+
+/*
+ * Cancellation mode
+ *
+ * The cost of the cancellation checks is measured first, by alternating
+ * invocations of the cipher loop with and without TA_PROCESS_CANCELLABLE.
+ * Then each invocation is cancelled by a second thread after a random delay,
+ * and the time from TEEC_RequestCancellation(), or from the start of the
+ * invocation if the request came earlier, to the return of
+ * TEEC_InvokeCommand() is recorded with the --timer backend. Invocations
+ * that complete before the request are only counted, as are the requests
+ * that were lost: issued before the invocation returned, which nevertheless
+ * ran to completion. A request issued before TEEC_InvokeCommand() has set
+ * up the operation is dropped by libteec; these early requests are counted
+ * too, whatever the outcome.
+ *
+ * The canceller thread is created once and armed for each invocation.
+ */
+
+struct canceller {
+	pthread_mutex_t lock;
+	pthread_cond_t cond;
+	TEEC_Operation *op;
+	uint64_t delay;		/* ns */
+	uint64_t t;		/* TEEC_RequestCancellation() called, raw */
+	int armed;		/* Request pending, cleared once issued */
+	int quit;
+};
+
+static void *cancel_thread(void *arg)
+{
+	struct canceller *c = arg;
+	struct timespec ts;
+	uint64_t t;
+
+	pthread_mutex_lock(&c->lock);
+	while (1) {
+		while (!c->armed && !c->quit)
+			pthread_cond_wait(&c->cond, &c->lock);
+		if (c->quit)
+			break;
+		ts.tv_sec = c->delay / 1000000000;
+		ts.tv_nsec = c->delay % 1000000000;
+		pthread_mutex_unlock(&c->lock);
+		nanosleep(&ts, NULL);
+		t = aesperf_timer_read(&ap.timer);
+		TEEC_RequestCancellation(c->op);
+		pthread_mutex_lock(&c->lock);
+		c->t = t;
+		c->armed = 0;
+		pthread_cond_broadcast(&c->cond);
+	}
+	pthread_mutex_unlock(&c->lock);
+	return NULL;
+}
+
+static void cancel_arm(struct canceller *c, TEEC_Operation *op,
+		       uint64_t delay)
+{
+	pthread_mutex_lock(&c->lock);
+	c->op = op;
+	c->delay = delay;
+	c->armed = 1;
+	pthread_cond_broadcast(&c->cond);
+	pthread_mutex_unlock(&c->lock);
+}
+
+/* Wait for the request to be issued, returns its time */
+static uint64_t cancel_wait(struct canceller *c)
+{
+	uint64_t t;
+
+	pthread_mutex_lock(&c->lock);
+	while (c->armed)
+		pthread_cond_wait(&c->cond, &c->lock);
+	t = c->t;
+	pthread_mutex_unlock(&c->lock);
+	return t;
+}
+
+/* Also clears any previous cancellation request */
+static void init_cancel_op(TEEC_Operation *op, size_t size, unsigned int l,
+			   uint32_t flags)
+{
+	memset(op, 0, sizeof(*op));
+	op->paramTypes = TEEC_PARAM_TYPES(TEEC_MEMREF_PARTIAL_INOUT,
+					  TEEC_MEMREF_PARTIAL_INOUT,
+					  TEEC_VALUE_INPUT, TEEC_NONE);
+	op->params[0].memref.parent = &ap.in_shm;
+	op->params[0].memref.size = size;
+	op->params[1].memref.parent = cfg->in_place ? &ap.in_shm : &ap.out_shm;
+	op->params[1].memref.size = size;
+	op->params[2].value.a = l;
+	op->params[2].value.b = flags;
+}
+
+/* Time n invocations of ap.op with and without the checks, alternately */
+static void cancel_cost(size_t size, unsigned int n, unsigned int l,
+			uint64_t *median)
+{
+	struct aesperf_stats st[2];
+	uint64_t *samples[2];
+	unsigned int i;
+	uint64_t t;
+	int c;
+
+	memset(st, 0, sizeof(st));
+	for (c = 0; c < 2; c++) {
+		samples[c] = malloc(n * sizeof(*samples[c]));
+		if (!samples[c]) {
+			perror("malloc");
+			exit(1);
+		}
+	}
+	for (i = 0; i < n; i++) {
+		for (c = 0; c < 2; c++) {
+			ap.op.params[2].value.b = c ? TA_PROCESS_CANCELLABLE :
+						      0;
+			check_res(aesperf_sample(&ap, &t),
+				  "TEEC_InvokeCommand");
+			samples[c][i] = t;
+			aesperf_stats_update(&st[c], t);
+			st[c].bytes += (double)size * l;
+		}
+	}
+	for (c = 0; c < 2; c++) {
+		aesperf_stats_robust(&st[c], samples[c], n);
+		free(samples[c]);
+	}
+	printf("plain loop:       median=%gμs (%gMiB/s)\n", st[0].median/1000,
+	       aesperf_stats_mb_per_sec(&st[0], AESPERF_CENTER_MEDIAN));
+	printf("cancellable loop: median=%gμs (%gMiB/s), ", st[1].median/1000,
+	       aesperf_stats_mb_per_sec(&st[1], AESPERF_CENTER_MEDIAN));
+	printf("cost %+.2f%%\n",
+	       100 * (st[1].median - st[0].median) / st[0].median);
+	*median = st[1].median;
+}
+
+static void run_cancel(size_t size, unsigned int n, unsigned int l)
+{
+	uint32_t x = 2463534242U;
+	struct aesperf_stats lat;
+	struct canceller c = {
+		.lock = PTHREAD_MUTEX_INITIALIZER,
+		.cond = PTHREAD_COND_INITIALIZER,
+	};
+	pthread_t thread;
+	TEEC_Operation op;
+	TEEC_Result res;
+	uint32_t ret_origin;
+	uint64_t *samples;
+	uint64_t max_delay;
+	uint64_t t0, t, tc;
+	unsigned int finished = 0;	/* Before the request */
+	unsigned int lost = 0;		/* Request issued in time, not seen */
+	unsigned int early = 0;		/* Request before the invocation */
+	unsigned int i;
+
+	memset(&lat, 0, sizeof(lat));
+	samples = malloc(n * sizeof(*samples));
+	if (!samples) {
+		perror("malloc");
+		exit(1);
+	}
+	cfg->size = size;
+	cfg->loops = l;
+	setup_shm(size);
+
+	verbose("Starting cancellation test: %s, %s, keysize=%u bits, ",
+		mode_str(cfg->mode), op_str(), cfg->keysize);
+	verbose("size=%zu bytes, in place=%s, inner loops=%u, loops=%u\n",
+		size, yesno(cfg->in_place), l, n);
+
+	if (warmup)
+		do_warmup();
+
+	cancel_cost(size, n, l, &max_delay);
+	if (cancel_delay)
+		max_delay = cancel_delay;
+
+	if (pthread_create(&thread, NULL, cancel_thread, &c)) {
+		fprintf(stderr, "pthread_create failed\n");
+		exit(1);
+	}
+	for (i = 0; i < n; i++) {
+		init_cancel_op(&op, size, l, TA_PROCESS_CANCELLABLE);
+		x ^= x << 13;
+		x ^= x >> 17;
+		x ^= x << 5;
+		cancel_arm(&c, &op, max_delay ? x % max_delay : 0);
+		t0 = aesperf_timer_read(&ap.timer);
+		res = TEEC_InvokeCommand(&ap.sess, cfg->cmd, &op, &ret_origin);
+		t = aesperf_timer_read(&ap.timer);
+		tc = cancel_wait(&c);
+		if (tc < t0) {
+			early++;
+			tc = t0;
+		}
+		if (res != TEEC_ERROR_CANCEL) {
+			check_res(res, "TEEC_InvokeCommand");
+			if (tc >= t)
+				finished++;
+			else
+				lost++;
+			continue;
+		}
+		t = tc < t ? aesperf_timer_sample_ns(&ap.timer, tc, t) : 0;
+		samples[lat.n] = t;
+		aesperf_stats_update(&lat, t);
+	}
+	pthread_mutex_lock(&c.lock);
+	c.quit = 1;
+	pthread_cond_broadcast(&c.cond);
+	pthread_mutex_unlock(&c.lock);
+	pthread_join(thread, NULL);
+
+	printf("cancel: %u invocations, delay up to %gμs: %d cancelled, ",
+	       n, max_delay / 1000.0, lat.n);
+	printf("%u completed before the request, %u requests lost, ",
+	       finished, lost);
+	printf("%u requests before the invocation\n", early);
+	if (lat.n) {
+		aesperf_stats_robust(&lat, samples, lat.n);
+		printf("time to return: min=%gμs mean=%gμs p50=%gμs ",
+		       lat.min/1000, lat.m/1000,
+		       aesperf_percentile(samples, lat.n, 50) / 1000.0);
+		printf("p90=%gμs p99=%gμs p99.9=%gμs max=%gμs\n",
+		       aesperf_percentile(samples, lat.n, 90) / 1000.0,
+		       aesperf_percentile(samples, lat.n, 99) / 1000.0,
+		       aesperf_percentile(samples, lat.n, 99.9) / 1000.0,
+		       lat.max/1000);
+	}
+	free(samples);
+	free_shm();
+}
+
+/* Parse a comma-separated list of modes. Returns -1 on error. */
+static int parse_probe_modes(const char *s)
+{
+	char buf[32];
+	const char *end;
+	size_t len;
+	int m;
+
+	num_probe_modes = 0;
+	do {
+		end = strchr(s, ',');
+		len = end ? (size_t)(end - s) : strlen(s);
+		if (len >= sizeof(buf) || num_probe_modes == MAX_PROBE_MODES)
+			return -1;
+		memcpy(buf, s, len);
+		buf[len] = '\0';
+		for (m = 0; m <= TA_ECDH; m++)
+			if (!strcasecmp(buf, mode_str(m)))
+				break;
+		if (m > TA_ECDH)
+			return -1;
+		probe_modes[num_probe_modes++] = m;
+		s = end + 1;
+	} while (end);
+	return 0;
+}
+
+/*
+ * Scenario files (--scenario): named benchmarks, run in one process with a
+ * single session. Each section starts with "[name]" and is followed by
+ * "key = value" lines; keys that are not given take the value of the command
+ * line. '#' starts a comment.
+ *
+ *   mode       -m
+ *   keysize    -k
+ *   direction  encrypt or decrypt (-d)
+ *   sizes      comma-separated list of buffer sizes, each is run (-s)
+ *   threads    1: synchronous, more: invoker threads (--qd)
+ *   shm        alloc or register (--shm)
+ *   iterations -n
+ *   loops      -l
+ *   precision  target 95% CI half-width in % of the mean (--precision)
+ */
+
+#define MAX_SCENARIO_SIZES	16
+#define SCENARIO_NAME_LEN	32
+
+struct scenario {
+	char name[SCENARIO_NAME_LEN];
+	int mode;
+	int keysize;
+	int decrypt;
+	size_t sizes[MAX_SCENARIO_SIZES];
+	int num_sizes;
+	unsigned int threads;
+	int shm;
+	unsigned int n;
+	unsigned int l;
+	double precision;
+};
+
+static struct scenario *scenarios;
+static int num_scenarios;
+
+static char *trim(char *s)
+{
+	char *e;
+
+	while (isspace((unsigned char)*s))
+		s++;
+	e = s + strlen(s);
+	while (e > s && isspace((unsigned char)e[-1]))
+		*--e = '\0';
+	return s;
+}
+
+static int scenario_key(struct scenario *sc, const char *key, char *val)
+{
+	char *end;
+	char *tok;
+
+	if (!strcmp(key, "mode")) {
+		for (sc->mode = 0; sc->mode <= TA_ECDH; sc->mode++)
+			if (!strcasecmp(val, mode_str(sc->mode)))
+				return 0;
+		return -1;
+	} else if (!strcmp(key, "keysize")) {
+		sc->keysize = strtol(val, &end, 0);
+		return *end ? -1 : 0;
+	} else if (!strcmp(key, "direction")) {
+		if (!strcasecmp(val, "encrypt"))
+			sc->decrypt = 0;
+		else if (!strcasecmp(val, "decrypt"))
+			sc->decrypt = 1;
+		else
+			return -1;
+		return 0;
+	} else if (!strcmp(key, "sizes")) {
+		sc->num_sizes = 0;
+		for (tok = strtok(val, ","); tok; tok = strtok(NULL, ",")) {
+			if (sc->num_sizes == MAX_SCENARIO_SIZES)
+				return -1;
+			sc->sizes[sc->num_sizes] = parse_size(trim(tok));
+			if (!sc->sizes[sc->num_sizes++])
+				return -1;
+		}
+		return sc->num_sizes ? 0 : -1;
+	} else if (!strcmp(key, "threads")) {
+		sc->threads = strtoul(val, &end, 0);
+		return *end || !sc->threads || sc->threads > MAX_QD ? -1 : 0;
+	} else if (!strcmp(key, "shm")) {
+		if (!strcasecmp(val, "alloc"))
+			sc->shm = AESPERF_SHM_ALLOCATED;
+		else if (!strcasecmp(val, "register"))
+			sc->shm = AESPERF_SHM_REGISTERED;
+		else
+			return -1;
+		return 0;
+	} else if (!strcmp(key, "iterations")) {
+		sc->n = strtoul(val, &end, 0);
+		return *end || !sc->n ? -1 : 0;
+	} else if (!strcmp(key, "loops")) {
+		sc->l = strtoul(val, &end, 0);
+		return *end || !sc->l ? -1 : 0;
+	} else if (!strcmp(key, "precision")) {
+		sc->precision = strtod(val, &end);
+		if (*end == '%')
+			end++;
+		return *end || sc->precision < 0 ? -1 : 0;
+	}
+	return -1;
+}
+
+/* Check the scenario and resolve its default key size */
+static int check_scenario(struct scenario *sc)
+{
+	int keysize = sc->keysize;
+	int i;
+
+	if (check_keysize(sc->mode, &keysize) < 0) {
+		fprintf(stderr, "[%s]: invalid key size for %s\n", sc->name,
+			mode_str(sc->mode));
+		return -1;
+	}
+	for (i = 0; i < sc->num_sizes; i++) {
+		if (needs_blocks(sc->mode) &&
+		    sc->sizes[i] % AES_BLOCK_SIZE) {
+			fprintf(stderr, "[%s]: sizes must be multiples of %d ",
+				sc->name, AES_BLOCK_SIZE);
+			fprintf(stderr, "bytes in %s mode\n",
+				mode_str(sc->mode));
+			return -1;
+		}
+	}
+	if (is_asym_mode(sc->mode) && sc->threads > 1) {
+		fprintf(stderr, "[%s]: asymmetric modes are synchronous\n",
+			sc->name);
+		return -1;
+	}
+	sc->keysize = keysize;
+	return 0;
+}
+
+/* Parse the scenario file, defaults from the command line. -1 on error. */
+static int parse_scenarios(const char *path)
+{
+	struct scenario defaults;
+	struct scenario *sc = NULL;
+	char line[512];
+	char *p, *eq;
+	int lineno = 0;
+	int ret = -1;
+	FILE *f;
+
+	memset(&defaults, 0, sizeof(defaults));
+	defaults.mode = cfg->mode;
+	defaults.keysize = cfg->keysize;
+	defaults.decrypt = cfg->decrypt;
+	defaults.sizes[0] = size;
+	defaults.num_sizes = 1;
+	defaults.threads = 1;
+	defaults.shm = cfg->shm_type;
+	defaults.n = n;
+	defaults.l = l;
+	defaults.precision = precision;
+
+	f = fopen(path, "r");
+	if (!f) {
+		perror(path);
+		return -1;
+	}
+	while (fgets(line, sizeof(line), f)) {
+		lineno++;
+		p = strchr(line, '#');
+		if (p)
+			*p = '\0';
+		p = trim(line);
+		if (!*p)
+			continue;
+		if (*p == '[') {
+			eq = strchr(p, ']');
+			if (!eq || eq[1] || eq - p - 1 >= SCENARIO_NAME_LEN ||
+			    eq == p + 1)
+				goto err;
+			if (sc && check_scenario(sc) < 0)
+				goto out;
+			sc = realloc(scenarios, (num_scenarios + 1) *
+						sizeof(*sc));
+			if (!sc) {
+				perror("realloc");
+				exit(1);
+			}
+			scenarios = sc;
+			sc = &scenarios[num_scenarios++];
+			*sc = defaults;
+			*eq = '\0';
+			strcpy(sc->name, p + 1);
+			continue;
+		}
+		eq = strchr(p, '=');
+		if (!sc || !eq)
+			goto err;
+		*eq = '\0';
+		if (scenario_key(sc, trim(p), trim(eq + 1)) < 0)
+			goto err;
+	}
+	if (!sc) {
+		fprintf(stderr, "%s: no scenario\n", path);
+		goto out;
+	}
+	if (check_scenario(sc) < 0)
+		goto out;
+	ret = 0;
+	goto out;
+err:
+	fprintf(stderr, "%s:%d: syntax error\n", path, lineno);
+out:
+	fclose(f);
+	return ret;
+}
+
+/* Parse a comma-separated list of queue depths. Returns -1 on error. */
+static int parse_qds(const char *s)
+{
+	char *end;
+	unsigned long qd;
+
+	num_qds = 0;
+	do {
+		if (num_qds == MAX_QDS)
+			return -1;
+		qd = strtoul(s, &end, 0);
+		if (end == s || !qd || qd > MAX_QD || (*end && *end != ','))
+			return -1;
+		qds[num_qds++] = qd;
+		s = end + 1;
+	} while (*end);
+	return 0;
+}
+
+/* Parse a comma-separated list of chunk sizes. Returns -1 on error. */
+static int parse_chunks(const char *s)
+{
+	char buf[32];
+	const char *end;
+	size_t len;
+
+	num_chunks = 0;
+	do {
+		end = strchr(s, ',');
+		len = end ? (size_t)(end - s) : strlen(s);
+		if (num_chunks == MAX_CHUNKS || len >= sizeof(buf))
+			return -1;
+		memcpy(buf, s, len);
+		buf[len] = '\0';
+		chunks[num_chunks] = parse_size(buf);
+		if (!chunks[num_chunks++])
+			return -1;
+		s = end + 1;
+	} while (end);
+	return 0;
+}
+
+struct stream_result {
+	size_t chunk;
+	struct aesperf_stats lat;		/* Latency of each invocation */
+	double mbs;			/* End-to-end throughput */
+};
+
+/*
+ * Encrypt "total" bytes through a shared buffer of "chunk" bytes. The cipher
+ * state is carried over from one invocation to the next, so the output is
+ * that of a single stream. The end-to-end time includes filling the input
+ * buffer, but not --verify.
+ */
+static void run_stream(size_t chunk, struct stream_result *r)
+{
+	uint64_t done = 0;
+	size_t sz;
+	struct timespec t0, t1;
+	uint64_t verify_ns0;
+	double secs;
+
+	memset(r, 0, sizeof(*r));
+	r->chunk = chunk;
+
+	/* Start a new stream */
+	prepare_key(&ap.sess);
+	if (verify)
+		verify_init();
+
+	cfg->size = chunk;
+	cfg->loops = 1;
+	setup_shm(chunk);
+
+	verbose("Starting stream: %s, %s, keysize=%u bits, ",
+		mode_str(cfg->mode), op_str(), cfg->keysize);
+	verbose("total=%llu bytes, chunk=%zu bytes, random=%s, in place=%s\n",
+		(unsigned long long)total, chunk, yesno(cfg->random),
+		yesno(cfg->in_place));
+
+	if (warmup)
+		do_warmup();
+
+	verify_ns0 = verify_ns;
+	get_current_time(&t0);
+	while (done < total) {
+		sz = total - done < chunk ? total - done : chunk;
+		ap.op.params[2].value.a = 1;
+		ap.op.params[2].value.b = copy_chunk;
+		aesperf_stats_update(&r->lat,
+				     run_test_once(0, sz, 1, CACHE_WARM));
+		r->lat.bytes += sz;
+		done += sz;
+	}
+	get_current_time(&t1);
+	free_shm();
+
+	secs = (double)(timespec_diff_ns(&t0, &t1) - (verify_ns - verify_ns0)) /
+	       1000000000;
+	r->mbs = total / secs / (1024 * 1024);
+	printf("chunk=%zu: %llu bytes in %d invocations, %gs (%gMiB/s), ",
+	       chunk, (unsigned long long)total, r->lat.n, secs, r->mbs);
+	printf("invoke min=%gμs mean=%gμs (%gMiB/s)\n", r->lat.min/1000,
+	       r->lat.m/1000, aesperf_stats_mb_per_sec(&r->lat, center));
+}
+
+/* Compare the end-to-end throughput of each chunk size */
+static void print_chunk_table(struct stream_result *r)
+{
+	int best = 0;
+	int i;
+
+	if (num_chunks < 2)
+		return;
+	for (i = 1; i < num_chunks; i++)
+		if (r[i].mbs > r[best].mbs)
+			best = i;
+	printf("Chunk sweep:\n");
+	printf("%10s %12s %10s %8s\n", "chunk", "MiB/s", "mean(μs)",
+	       "vs best");
+	for (i = 0; i < num_chunks; i++)
+		printf("%10zu %12.3f %10.3f %+7.1f%%\n", r[i].chunk, r[i].mbs,
+		       r[i].lat.m/1000,
+		       100 * (r[i].mbs - r[best].mbs) / r[best].mbs);
+	printf("Best chunk size: %zu bytes\n", r[best].chunk);
+}
+
+/* Throughput and latency of each TEE_GenerateRandom() call per request size */
+static void print_rng_table(struct aesperf_stats *stats)
+{
+	size_t i;
+
+	printf("RNG sweep:\n");
+	printf("%8s %12s %12s %14s %14s\n", "size", "MiB/s", "calls/s",
+	       "call min(μs)", "call mean(μs)");
+	/* Each invocation makes l calls of size bytes */
+	for (i = 0; i < NUM_RNG_SIZES; i++)
+		printf("%8zu %12.3f %12.0f %14.3f %14.3f\n", rng_sizes[i],
+		       aesperf_stats_mb_per_sec(&stats[i], center) * l,
+		       1e9 * l / aesperf_stats_center(&stats[i], center),
+		       stats[i].min / l / 1000, stats[i].m / l / 1000);
+}
+
+/*
+ * Asymmetric modes: the TA generates a key pair when the key is prepared,
+ * then each invocation performs -l operations. Results are per operation.
+ */
+
+struct asym_result {
+	int mode;
+	int keysize;
+	int supported;
+	struct aesperf_stats lat;		/* Latency per operation */
+	uint64_t p50;
+	uint64_t p99;
+	double ops;			/* Operations per second */
+};
+
+/* Modes and key sizes of --asym */
+static const struct {
+	int mode;
+	int keysize;
+} asym_tests[] = {
+	{ TA_RSA_SIGN, 2048 }, { TA_RSA_VERIFY, 2048 },
+	{ TA_RSA_ENCRYPT, 2048 }, { TA_RSA_DECRYPT, 2048 },
+	{ TA_RSA_SIGN, 3072 }, { TA_RSA_VERIFY, 3072 },
+	{ TA_RSA_ENCRYPT, 3072 }, { TA_RSA_DECRYPT, 3072 },
+	{ TA_RSA_SIGN, 4096 }, { TA_RSA_VERIFY, 4096 },
+	{ TA_RSA_ENCRYPT, 4096 }, { TA_RSA_DECRYPT, 4096 },
+	{ TA_ECDSA_SIGN, 256 }, { TA_ECDSA_VERIFY, 256 },
+	{ TA_ECDSA_SIGN, 384 }, { TA_ECDSA_VERIFY, 384 },
+	{ TA_ECDH, 256 },
+};
+
+#define NUM_ASYM_TESTS	(sizeof(asym_tests) / sizeof(asym_tests[0]))
+
+static void run_asym(struct asym_result *r)
+{
+	TEEC_Result res;
+	uint64_t *samples;
+	uint64_t t;
+	unsigned int i;
+
+	memset(r, 0, sizeof(*r));
+	r->mode = cfg->mode;
+	r->keysize = cfg->keysize;
+
+	verbose("Starting asymmetric test: %s, keysize=%u bits, ",
+		mode_str(cfg->mode), cfg->keysize);
+	verbose("inner loops=%u, loops=%u, warm-up=%u s\n", l, n, warmup);
+
+	/* Generates the key pair */
+	res = try_prepare_key(&ap.sess);
+	if (res == TEEC_ERROR_NOT_SUPPORTED) {
+		printf("%s/%d: not supported by the TEE\n", mode_str(cfg->mode),
+		       cfg->keysize);
+		return;
+	}
+	check_res(res, "TEEC_InvokeCommand");
+	r->supported = 1;
+
+	samples = malloc(n * sizeof(*samples));
+	if (!samples) {
+		perror("malloc");
+		exit(1);
+	}
+	/* The memrefs are not used */
+	cfg->size = AES_BLOCK_SIZE;
+	cfg->loops = l;
+	setup_shm(AES_BLOCK_SIZE);
+
+	if (warmup)
+		do_warmup();
+
+	for (i = 0; i < n; i++) {
+		t = run_test_once(0, AES_BLOCK_SIZE, l, CACHE_WARM) / l;
+		samples[i] = t;
+		aesperf_stats_update(&r->lat, t);
+	}
+	free_shm();
+
+	aesperf_stats_robust(&r->lat, samples, n);
+	r->p50 = aesperf_percentile(samples, n, 50);
+	r->p99 = aesperf_percentile(samples, n, 99);
+	r->ops = 1000000000 / aesperf_stats_center(&r->lat, center);
+	free(samples);
+
+	printf("%s/%d: %g ops/s, latency min=%gμs p50=%gμs p99=%gμs ",
+	       mode_str(cfg->mode), cfg->keysize, r->ops, r->lat.min/1000,
+	       (double)r->p50/1000, (double)r->p99/1000);
+	printf("max=%gμs\n", r->lat.max/1000);
+}
+
+static void print_asym_table(struct asym_result *r)
+{
+	size_t i;
+
+	printf("Asymmetric operations:\n");
+	printf("%-14s %6s %12s %10s %10s %10s\n", "mode", "bits", "ops/s",
+	       "mean(μs)", "p50(μs)", "p99(μs)");
+	for (i = 0; i < NUM_ASYM_TESTS; i++) {
+		printf("%-14s %6d ", mode_str(r[i].mode), r[i].keysize);
+		if (!r[i].supported) {
+			printf("%12s\n", "n/a");
+			continue;
+		}
+		printf("%12.1f %10.1f %10.1f %10.1f\n", r[i].ops,
+		       r[i].lat.m/1000, (double)r[i].p50/1000,
+		       (double)r[i].p99/1000);
+	}
+}
+
+/*
+ * Secure storage: the TA creates one persistent object of storage_size bytes
+ * and each invocation performs a single operation on it, -s bytes at a time
+ * for reads and writes. Offsets are multiples of -s, drawn in order or at
+ * random (xorshift PRNG, fixed seed).
+ */
+
+struct storage_result {
+	const char *name;
+	size_t bytes;			/* Bytes per operation, 0: no data */
+	struct aesperf_stats lat;		/* Latency per operation */
+	uint64_t p50;
+	uint64_t p90;
+	uint64_t p99;
+};
+
+static const struct {
+	const char *name;
+	uint32_t op;
+	int random;
+} storage_tests[] = {
+	{ "seq-write", TA_STORAGE_WRITE, 0 },
+	{ "seq-read", TA_STORAGE_READ, 0 },
+	{ "rand-write", TA_STORAGE_WRITE, 1 },
+	{ "rand-read", TA_STORAGE_READ, 1 },
+	{ "seek", TA_STORAGE_SEEK, 1 },
+	{ "truncate", TA_STORAGE_TRUNCATE, 0 },
+};
+
+#define NUM_STORAGE_TESTS	(sizeof(storage_tests) / sizeof(storage_tests[0]))
+/* Create and delete, then storage_tests */
+#define NUM_STORAGE_RESULTS	(NUM_STORAGE_TESTS + 2)
+
+static uint64_t storage_op(TEEC_Operation *op, uint32_t sop, uint32_t arg)
+{
+	uint64_t t;
+
+	op->params[0].value.a = sop;
+	op->params[0].value.b = arg;
+	if (cfg->random)
+		read_random(ap.in_shm.buffer, size);
+	check_res(aesperf_invoke(&ap, &ap.sess, cfg->cmd, op, &t),
+		  "TEEC_InvokeCommand");
+	if (sop == TA_STORAGE_READ && op->params[2].value.a != size) {
+		fprintf(stderr, "Short read at offset %u: %u bytes\n", arg,
+			op->params[2].value.a);
+		exit(1);
+	}
+	return t;
+}
+
+static void storage_stats(struct storage_result *r, uint64_t *samples)
+{
+	aesperf_stats_robust(&r->lat, samples, r->lat.n);
+	r->p50 = aesperf_percentile(samples, r->lat.n, 50);
+	r->p90 = aesperf_percentile(samples, r->lat.n, 90);
+	r->p99 = aesperf_percentile(samples, r->lat.n, 99);
+	verbose("%s: min=%gμs p50=%gμs p99=%gμs max=%gμs\n", r->name,
+		r->lat.min/1000, (double)r->p50/1000, (double)r->p99/1000,
+		r->lat.max/1000);
+}
+
+static void run_storage(struct storage_result *r)
+{
+	TEEC_Operation op;
+	uint64_t *samples;
+	uint64_t t;
+	uint32_t x = 2463534242U;
+	uint32_t arg;
+	size_t slots = storage_size / size;
+	size_t k;
+	unsigned int i;
+
+	memset(r, 0, NUM_STORAGE_RESULTS * sizeof(*r));
+	/* Create and delete latencies are sampled together */
+	samples = malloc(2 * n * sizeof(*samples));
+	if (!samples) {
+		perror("malloc");
+		exit(1);
+	}
+	alloc_shm(size);
+	if (!cfg->random)
+		memset(ap.in_shm.buffer, 0, size);
+	cfg->cmd = TA_AES_PERF_CMD_STORAGE;
+
+	memset(&op, 0, sizeof(op));
+	op.paramTypes = TEEC_PARAM_TYPES(TEEC_VALUE_INPUT,
+					 TEEC_MEMREF_PARTIAL_INOUT,
+					 TEEC_VALUE_OUTPUT, TEEC_NONE);
+	op.params[1].memref.parent = &ap.in_shm;
+	op.params[1].memref.size = size;
+
+	verbose("Starting secure storage test: object=%zu bytes, ",
+		storage_size);
+	verbose("chunk=%zu bytes, random=%s, loops=%u, warm-up=%u s\n", size,
+		yesno(cfg->random), n, warmup);
+
+	if (warmup)
+		do_warmup();
+
+	r[0].name = "create";
+	r[1].name = "delete";
+	for (i = 0; i < n; i++) {
+		samples[i] = storage_op(&op, TA_STORAGE_CREATE, 0);
+		aesperf_stats_update(&r[0].lat, samples[i]);
+		samples[n + i] = storage_op(&op, TA_STORAGE_DELETE, 0);
+		aesperf_stats_update(&r[1].lat, samples[n + i]);
+	}
+	storage_stats(&r[0], samples);
+	storage_stats(&r[1], samples + n);
+
+	/* Object used by the other tests, allocated up front */
+	storage_op(&op, TA_STORAGE_CREATE, 0);
+	storage_op(&op, TA_STORAGE_TRUNCATE, storage_size);
+
+	for (k = 0; k < NUM_STORAGE_TESTS; k++) {
+		r[k + 2].name = storage_tests[k].name;
+		if (storage_tests[k].op == TA_STORAGE_WRITE ||
+		    storage_tests[k].op == TA_STORAGE_READ)
+			r[k + 2].bytes = size;
+		for (i = 0; i < n; i++) {
+			if (storage_tests[k].op == TA_STORAGE_TRUNCATE) {
+				/* Shrink by one chunk and grow back */
+				arg = storage_size - (i % 2 ? 0 : size);
+			} else if (storage_tests[k].random) {
+				x ^= x << 13;
+				x ^= x >> 17;
+				x ^= x << 5;
+				arg = x % slots * size;
+			} else {
+				arg = i % slots * size;
+			}
+			t = storage_op(&op, storage_tests[k].op, arg);
+			samples[i] = t;
+			aesperf_stats_update(&r[k + 2].lat, t);
+			r[k + 2].lat.bytes += r[k + 2].bytes;
+		}
+		storage_stats(&r[k + 2], samples);
+	}
+
+	storage_op(&op, TA_STORAGE_DELETE, 0);
+	cfg->cmd = TA_AES_PERF_CMD_PROCESS;
+	free_shm();
+	free(samples);
+}
+
+static void print_storage_table(struct storage_result *r)
+{
+	size_t i;
+
+	printf("Secure storage (object=%zu bytes, chunk=%zu bytes):\n",
+	       storage_size, size);
+	printf("%-10s %10s %10s %10s %10s %10s %10s %10s\n", "op", "ops/s",
+	       "MiB/s", "min(μs)", "p50(μs)", "p90(μs)", "p99(μs)",
+	       "max(μs)");
+	for (i = 0; i < NUM_STORAGE_RESULTS; i++) {
+		printf("%-10s %10.1f ", r[i].name,
+		       1e9 / aesperf_stats_center(&r[i].lat, center));
+		if (r[i].bytes)
+			printf("%10.3f ",
+			       aesperf_stats_mb_per_sec(&r[i].lat, center));
+		else
+			printf("%10s ", "-");
+		printf("%10.1f %10.1f %10.1f %10.1f %10.1f\n",
+		       r[i].lat.min/1000, (double)r[i].p50/1000,
+		       (double)r[i].p90/1000, (double)r[i].p99/1000,
+		       r[i].lat.max/1000);
+	}
+}
+
+/*
+ * Exporter: every probe_interval, run a batch of -n invocations (16 by
+ * default) of each probe mode, and serve the accumulated metrics to anyone
+ * connecting to the socket. HTTP requests (Prometheus scrapes) get an HTTP
+ * response, other clients just the text. The interval is stretched so that
+ * the time spent probing stays below cpu_budget percent.
+ */
+
+/* Upper bounds of the latency histogram, in seconds */
+static const double lat_buckets[] = {
+	1e-6, 2e-6, 5e-6, 10e-6, 20e-6, 50e-6, 100e-6, 200e-6, 500e-6,
+	1e-3, 2e-3, 5e-3, 10e-3, 20e-3, 50e-3, 100e-3, 200e-3, 500e-3, 1,
+};
+
+#define NUM_LAT_BUCKETS	(sizeof(lat_buckets) / sizeof(lat_buckets[0]))
+#define PROBE_WINDOW	10	/* Probes in the rolling throughput */
+
+struct probe_metrics {
+	int mode;
+	int keysize;
+	unsigned long probes;
+	unsigned long errors;
+	uint32_t last_error;
+	uint64_t invocations;
+	double bytes;
+	uint64_t buckets[NUM_LAT_BUCKETS + 1];	/* Last one is +Inf */
+	double lat_sum;				/* Seconds */
+	double win_bytes[PROBE_WINDOW];		/* Rolling window */
+	uint64_t win_ns[PROBE_WINDOW];
+	unsigned int win_pos;
+};
+
+static volatile sig_atomic_t export_stop;
+static int sess_dead;		/* 1: the session must be reopened, 2: closed */
+
+static void export_signal(int sig)
+{
+	(void)sig;
+	export_stop = 1;
+}
+
+static int export_listen(const char *addr)
+{
+	struct sockaddr_un sun;
+	struct sockaddr_in sin;
+	struct sockaddr *sa;
+	socklen_t len;
+	const char *p;
+	char host[INET_ADDRSTRLEN];
+	int one = 1;
+	int fd;
+
+	if (!strncmp(addr, "unix:", 5)) {
+		memset(&sun, 0, sizeof(sun));
+		sun.sun_family = AF_UNIX;
+		if (strlen(addr + 5) >= sizeof(sun.sun_path))
+			return -1;
+		strcpy(sun.sun_path, addr + 5);
+		unlink(sun.sun_path);
+		sa = (struct sockaddr *)&sun;
+		len = sizeof(sun);
+	} else if (!strncmp(addr, "tcp:", 4)) {
+		memset(&sin, 0, sizeof(sin));
+		sin.sin_family = AF_INET;
+		sin.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+		addr += 4;
+		p = strrchr(addr, ':');
+		if (p) {
+			if (p - addr >= (int)sizeof(host))
+				return -1;
+			memcpy(host, addr, p - addr);
+			host[p - addr] = '\0';
+			if (inet_pton(AF_INET, host, &sin.sin_addr) != 1)
+				return -1;
+			addr = p + 1;
+		}
+		sin.sin_port = htons(atoi(addr));
+		if (!sin.sin_port)
+			return -1;
+		sa = (struct sockaddr *)&sin;
+		len = sizeof(sin);
+	} else {
+		return -1;
+	}
+
+	fd = socket(sa->sa_family, SOCK_STREAM | SOCK_CLOEXEC, 0);
+	if (fd < 0) {
+		perror("socket");
+		exit(1);
+	}
+	if (sa->sa_family == AF_INET)
+		setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+	if (bind(fd, sa, len) < 0 || listen(fd, 8) < 0) {
+		perror(export_addr);
+		exit(1);
+	}
+	return fd;
+}
+
+static void probe_error(struct probe_metrics *pm, TEEC_Result res)
+{
+	pm->errors++;
+	pm->last_error = res;
+	verbose("probe %s: error 0x%08x\n", mode_str(pm->mode), res);
+	/* The TA panicked or the TEE went away: start over */
+	if (!sess_dead && (res == TEEC_ERROR_TARGET_DEAD ||
+			   res == TEEC_ERROR_COMMUNICATION))
+		sess_dead = 1;
+}
+
+static TEEC_Result reopen_session(void)
+{
+	TEEC_Result res;
+
+	if (sess_dead == 1)
+		TEEC_CloseSession(&ap.sess);
+	sess_dead = 2;
+	res = aesperf_open_session(&ap, &ap.sess);
+	if (res == TEEC_SUCCESS)
+		sess_dead = 0;
+	return res;
+}
+
+/* Run one batch of pm->mode. Returns the time spent, in ns. */
+static uint64_t probe(struct probe_metrics *pm)
+{
+	TEEC_Result res;
+	uint64_t start = now_ns();
+	uint64_t t0;
+	uint64_t busy = 0;
+	size_t b;
+	unsigned int i;
+
+	cfg->mode = pm->mode;
+	cfg->keysize = pm->keysize;
+	pm->probes++;
+	if (sess_dead) {
+		res = reopen_session();
+		if (res != TEEC_SUCCESS) {
+			probe_error(pm, res);
+			return now_ns() - start;
+		}
+	}
+	res = try_prepare_key(&ap.sess);
+	if (res != TEEC_SUCCESS) {
+		probe_error(pm, res);
+		return now_ns() - start;
+	}
+	for (i = 0; i < n; i++) {
+		res = aesperf_sample(&ap, &t0);
+		if (res != TEEC_SUCCESS) {
+			probe_error(pm, res);
+			break;
+		}
+		busy += t0;
+		for (b = 0; b < NUM_LAT_BUCKETS; b++)
+			if (t0 <= lat_buckets[b] * 1e9)
+				break;
+		pm->buckets[b]++;
+		pm->lat_sum += t0 / 1e9;
+		pm->invocations++;
+		pm->bytes += size;
+	}
+	pm->win_bytes[pm->win_pos] = (double)i * size;
+	pm->win_ns[pm->win_pos] = busy;
+	pm->win_pos = (pm->win_pos + 1) % PROBE_WINDOW;
+	return now_ns() - start;
+}
+
+static double probe_rolling_bps(struct probe_metrics *pm)
+{
+	double bytes = 0;
+	uint64_t ns = 0;
+	int i;
+
+	for (i = 0; i < PROBE_WINDOW; i++) {
+		bytes += pm->win_bytes[i];
+		ns += pm->win_ns[i];
+	}
+	return ns ? bytes / ns * 1e9 : 0;
+}
+
+static void write_metrics(FILE *f, struct probe_metrics *pm, double duty,
+			  uint64_t interval_ns)
+{
+	struct timespec cpu;
+	uint64_t cum;
+	size_t b;
+	int i;
+
+	clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &cpu);
+	fprintf(f, "# TYPE aes_perf_probes counter\n");
+	fprintf(f, "# HELP aes_perf_probes Probe batches run.\n");
+	for (i = 0; i < num_probe_modes; i++)
+		fprintf(f, "aes_perf_probes_total{mode=\"%s\"} %lu\n",
+			mode_str(pm[i].mode), pm[i].probes);
+	fprintf(f, "# TYPE aes_perf_probe_errors counter\n");
+	fprintf(f, "# HELP aes_perf_probe_errors Failed TEE calls.\n");
+	for (i = 0; i < num_probe_modes; i++)
+		fprintf(f, "aes_perf_probe_errors_total{mode=\"%s\"} %lu\n",
+			mode_str(pm[i].mode), pm[i].errors);
+	fprintf(f, "# TYPE aes_perf_probe_last_error gauge\n");
+	fprintf(f, "# HELP aes_perf_probe_last_error TEEC_Result of the last ");
+	fprintf(f, "error, 0 if none.\n");
+	for (i = 0; i < num_probe_modes; i++)
+		fprintf(f, "aes_perf_probe_last_error{mode=\"%s\"} %u\n",
+			mode_str(pm[i].mode), pm[i].last_error);
+	fprintf(f, "# TYPE aes_perf_processed_bytes counter\n");
+	fprintf(f, "# UNIT aes_perf_processed_bytes bytes\n");
+	for (i = 0; i < num_probe_modes; i++)
+		fprintf(f, "aes_perf_processed_bytes_total{mode=\"%s\"} %.0f\n",
+			mode_str(pm[i].mode), pm[i].bytes);
+	fprintf(f, "# TYPE aes_perf_throughput_bytes_per_second gauge\n");
+	fprintf(f, "# HELP aes_perf_throughput_bytes_per_second Over the ");
+	fprintf(f, "last %d probes.\n", PROBE_WINDOW);
+	for (i = 0; i < num_probe_modes; i++)
+		fprintf(f, "aes_perf_throughput_bytes_per_second{mode=\"%s\"} "
+			"%g\n", mode_str(pm[i].mode),
+			probe_rolling_bps(&pm[i]));
+	fprintf(f, "# TYPE aes_perf_latency_seconds histogram\n");
+	fprintf(f, "# UNIT aes_perf_latency_seconds seconds\n");
+	fprintf(f, "# HELP aes_perf_latency_seconds Latency of one ");
+	fprintf(f, "invocation of %zu bytes.\n", size);
+	for (i = 0; i < num_probe_modes; i++) {
+		cum = 0;
+		for (b = 0; b < NUM_LAT_BUCKETS; b++) {
+			cum += pm[i].buckets[b];
+			fprintf(f, "aes_perf_latency_seconds_bucket{mode=\"%s\","
+				"le=\"%g\"} %llu\n", mode_str(pm[i].mode),
+				lat_buckets[b], (unsigned long long)cum);
+		}
+		cum += pm[i].buckets[b];
+		fprintf(f, "aes_perf_latency_seconds_bucket{mode=\"%s\","
+			"le=\"+Inf\"} %llu\n", mode_str(pm[i].mode),
+			(unsigned long long)cum);
+		fprintf(f, "aes_perf_latency_seconds_count{mode=\"%s\"} %llu\n",
+			mode_str(pm[i].mode), (unsigned long long)cum);
+		fprintf(f, "aes_perf_latency_seconds_sum{mode=\"%s\"} %g\n",
+			mode_str(pm[i].mode), pm[i].lat_sum);
+	}
+	fprintf(f, "# TYPE aes_perf_probe_duty_cycle gauge\n");
+	fprintf(f, "# HELP aes_perf_probe_duty_cycle Fraction of the last ");
+	fprintf(f, "period spent probing.\n");
+	fprintf(f, "aes_perf_probe_duty_cycle %g\n", duty);
+	fprintf(f, "# TYPE aes_perf_probe_interval_seconds gauge\n");
+	fprintf(f, "aes_perf_probe_interval_seconds %g\n", interval_ns / 1e9);
+	fprintf(f, "# TYPE aes_perf_exporter_cpu_seconds counter\n");
+	fprintf(f, "aes_perf_exporter_cpu_seconds_total %g\n",
+		cpu.tv_sec + cpu.tv_nsec / 1e9);
+	fprintf(f, "# EOF\n");
+}
+
+/* Answer one client, waiting at most 100 ms for its request */
+static void export_serve(int lfd, struct probe_metrics *pm, double duty,
+			 uint64_t interval_ns)
+{
+	struct pollfd pfd;
+	char req[512];
+	char *body = NULL;
+	size_t len = 0;
+	ssize_t r = 0;
+	FILE *f;
+	int fd;
+
+	fd = accept4(lfd, NULL, NULL, SOCK_CLOEXEC);
+	if (fd < 0)
+		return;
+	pfd.fd = fd;
+	pfd.events = POLLIN;
+	if (poll(&pfd, 1, 100) > 0)
+		r = recv(fd, req, sizeof(req) - 1, MSG_DONTWAIT);
+	req[r > 0 ? r : 0] = '\0';
+
+	f = open_memstream(&body, &len);
+	if (!f) {
+		close(fd);
+		return;
+	}
+	write_metrics(f, pm, duty, interval_ns);
+	fclose(f);
+	f = fdopen(fd, "w");
+	if (!f) {
+		close(fd);
+		free(body);
+		return;
+	}
+	if (!strncmp(req, "GET ", 4)) {
+		fprintf(f, "HTTP/1.0 200 OK\r\n");
+		fprintf(f, "Content-Type: application/openmetrics-text; ");
+		fprintf(f, "version=1.0.0; charset=utf-8\r\n");
+		fprintf(f, "Content-Length: %zu\r\n\r\n", len);
+	}
+	fwrite(body, 1, len, f);
+	fclose(f);
+	free(body);
+}
+
+static void run_exporter(void)
+{
+	struct probe_metrics pm[MAX_PROBE_MODES];
+	struct sigaction sa;
+	struct pollfd pfd;
+	uint64_t now;
+	uint64_t next;
+	uint64_t busy;
+	uint64_t period = probe_interval;
+	double duty = 0;
+	int keysize0 = cfg->keysize;
+	int i;
+
+	memset(pm, 0, sizeof(pm));
+	for (i = 0; i < num_probe_modes; i++) {
+		cfg->mode = pm[i].mode = probe_modes[i];
+		cfg->keysize = keysize0;
+		check_keysize(cfg->mode, &cfg->keysize);
+		pm[i].keysize = cfg->keysize;
+	}
+
+	memset(&sa, 0, sizeof(sa));
+	sa.sa_handler = export_signal;
+	sigaction(SIGINT, &sa, NULL);
+	sigaction(SIGTERM, &sa, NULL);
+	signal(SIGPIPE, SIG_IGN);
+
+	pfd.fd = export_listen(export_addr);
+	if (pfd.fd < 0) {
+		fprintf(stderr, "Invalid exporter address: %s\n",
+			export_addr);
+		exit(1);
+	}
+	pfd.events = POLLIN;
+
+	cfg->size = size;
+	cfg->loops = l;
+	setup_shm(size);
+
+	printf("Exporting metrics on %s, %d mode(s) every %gs, ",
+	       export_addr, num_probe_modes, probe_interval / 1e9);
+	printf("%u x %zu bytes, CPU budget %g%%\n", n, size, cpu_budget);
+	fflush(stdout);
+
+	next = now_ns();
+	while (!export_stop) {
+		now = now_ns();
+		if (now >= next) {
+			busy = 0;
+			for (i = 0; i < num_probe_modes; i++)
+				busy += probe(&pm[i]);
+			/* Stay within the budget */
+			period = probe_interval;
+			if (busy * 100 / cpu_budget > period)
+				period = busy * 100 / cpu_budget;
+			duty = (double)busy / period;
+			next = now + period;
+			continue;
+		}
+		if (poll(&pfd, 1, (next - now + 999999) / 1000000) > 0)
+			export_serve(pfd.fd, pm, duty, period);
+	}
+
+	close(pfd.fd);
+	if (!strncmp(export_addr, "unix:", 5))
+		unlink(export_addr + 5);
+	free_shm();
+	if (sess_dead != 2)
+		TEEC_CloseSession(&ap.sess);
+	TEEC_FinalizeContext(&ap.ctx);
+}
+
+/* Result of one size of a scenario */
+struct scenario_result {
+	struct scenario *sc;
+	const char *op;
+	size_t size;			/* 0 for asymmetric modes */
+	struct aesperf_stats lat;
+	double tput;			/* MiB/s, or ops/s if size is 0 */
+};
+
+static void print_scenario_table(struct scenario_result *r, int num)
+{
+	int i;
+
+	printf("Scenarios:\n");
+	printf("%-20s %-12s %5s %-10s %8s %4s %8s %10s %10s %7s %14s\n",
+	       "name", "mode", "bits", "op", "size", "thr", "n", "mean(μs)",
+	       "median(μs)", "±CI%", "throughput");
+	for (i = 0; i < num; i++) {
+		printf("%-20s %-12s %5d %-10s ", r[i].sc->name,
+		       mode_str(r[i].sc->mode), r[i].sc->keysize, r[i].op);
+		if (r[i].size)
+			printf("%8zu ", r[i].size);
+		else
+			printf("%8s ", "-");
+		if (!r[i].lat.n) {
+			printf("%4u %8s\n", r[i].sc->threads, "n/a");
+			continue;
+		}
+		printf("%4u %8d %10.3f %10.3f %7.2f ", r[i].sc->threads,
+		       r[i].lat.n, r[i].lat.m/1000, r[i].lat.median/1000,
+		       aesperf_stats_ci_pct(&r[i].lat));
+		if (r[i].size)
+			printf("%8.3f MiB/s\n", r[i].tput);
+		else
+			printf("%8.1f ops/s\n", r[i].tput);
+	}
+}
+
+/* Run each scenario on the session opened by open_ta() */
+static void run_scenarios(void)
+{
+	struct scenario_result *res;
+	struct scenario_result *r;
+	struct async_result ares;
+	struct asym_result asres;
+	struct scenario *sc;
+	int num_res = 0;
+	int i, j;
+
+	res = calloc(num_scenarios * MAX_SCENARIO_SIZES, sizeof(*res));
+	if (!res) {
+		perror("calloc");
+		exit(1);
+	}
+	for (i = 0; i < num_scenarios; i++) {
+		sc = &scenarios[i];
+		cur_scenario = sc->name;
+		cfg->mode = sc->mode;
+		cfg->keysize = sc->keysize;
+		cfg->decrypt = sc->decrypt;
+		cfg->shm_type = sc->shm;
+		n = sc->n;
+		l = sc->l;
+		precision = sc->precision;
+
+		if (is_asym_mode(cfg->mode)) {
+			printf("scenario %s: %s, keysize=%d\n", sc->name,
+			       mode_str(cfg->mode), cfg->keysize);
+			run_asym(&asres);
+			r = &res[num_res++];
+			r->sc = sc;
+			r->op = op_str();
+			r->lat = asres.lat;
+			r->tput = asres.ops;
+			continue;
+		}
+
+		prepare_key(&ap.sess);
+		for (j = 0; j < sc->num_sizes; j++) {
+			r = &res[num_res++];
+			r->sc = sc;
+			r->op = op_str();
+			r->size = size = sc->sizes[j];
+			printf("scenario %s: %s, %s, keysize=%d, size=%zu, ",
+			       sc->name, mode_str(cfg->mode), r->op,
+			       cfg->keysize, size);
+			printf("threads=%u\n", sc->threads);
+			if (sc->threads > 1) {
+				run_async(size, n, l, sc->threads, &ares);
+				r->lat = ares.lat;
+				r->tput = ares.mbs;
+			} else {
+				run_test(size, n, l, cache_modes[0],
+					 offsets[0], &r->lat);
+				r->tput = aesperf_stats_mb_per_sec(&r->lat,
+								   center);
+			}
+		}
+	}
+	print_scenario_table(res, num_res);
+	free(res);
+}
+
+/* Summary of a run, used to compare CPUs and TA models */
+struct run_result {
+	struct aesperf_stats stats;	/* Latency */
+	double mbs;			/* Throughput */
+	int asym;			/* Asymmetric modes: ops/s, no MiB/s */
+	double ops;			/* Operations per second, 0 if none */
+	unsigned int instances;		/* TA instances */
+	size_t footprint;		/* Memory reserved by the TA instances */
+};
+
+/*
+ * Run the test for each cache mode and offset, or for each queue depth in
+ * asynchronous mode. Returns the first result.
+ */
+static void run_all(struct run_result *res)
+{
+	struct aesperf_stats stats[3][MAX_OFFSETS];
+	struct async_result ares[MAX_QDS];
+	struct stream_result sres[MAX_CHUNKS];
+	struct aesperf_stats rstats[NUM_RNG_SIZES];
+	struct asym_result asres[NUM_ASYM_TESTS];
+	struct storage_result stres[NUM_STORAGE_RESULTS];
+	size_t k;
+	uint32_t sessions;
+	uint32_t inst_size;
+	int i, j;
+
+	memset(res, 0, sizeof(*res));
+	get_ta_info(&ap.sess, &sessions, &inst_size);
+	res->instances = 1;
+	res->footprint = inst_size;
+
+	if (storage_size) {
+		run_storage(stres);
+		print_storage_table(stres);
+		/* Sequential writes */
+		res->stats = stres[2].lat;
+		res->mbs = aesperf_stats_mb_per_sec(&stres[2].lat, center);
+		return;
+	}
+
+	if (asym_suite) {
+		for (k = 0; k < NUM_ASYM_TESTS; k++) {
+			cfg->mode = asym_tests[k].mode;
+			cfg->keysize = asym_tests[k].keysize;
+			run_asym(&asres[k]);
+		}
+		print_asym_table(asres);
+		/* The first supported mode */
+		for (k = 0; k < NUM_ASYM_TESTS - 1; k++)
+			if (asres[k].supported)
+				break;
+		res->stats = asres[k].lat;
+		res->asym = 1;
+		res->ops = asres[k].supported ? asres[k].ops : 0;
+		return;
+	}
+
+	if (rng_sweep) {
+		for (i = 0; i < (int)NUM_RNG_SIZES; i++)
+			run_test(rng_sizes[i], n, l, cache_modes[0],
+				 offsets[0], &rstats[i]);
+		print_rng_table(rstats);
+		res->stats = rstats[0];
+		res->mbs = aesperf_stats_mb_per_sec(&rstats[0], center);
+		return;
+	}
+
+	if (total) {
+		for (i = 0; i < num_chunks; i++)
+			run_stream(chunks[i], &sres[i]);
+		print_chunk_table(sres);
+		res->stats = sres[0].lat;
+		res->mbs = sres[0].mbs;
+		return;
+	}
+
+	if (num_qds) {
+		for (i = 0; i < num_qds; i++)
+			run_async(size, n, l, qds[i], &ares[i]);
+		print_qd_table(ares);
+		res->stats = ares[0].lat;
+		res->mbs = ares[0].mbs;
+		res->instances = ares[0].instances;
+		res->footprint = ares[0].footprint;
+		return;
+	}
+
+	if (is_asym_mode(cfg->mode)) {
+		run_asym(&asres[0]);
+		res->stats = asres[0].lat;
+		res->asym = 1;
+		res->ops = asres[0].supported ? asres[0].ops : 0;
+		return;
+	}
+
+	for (i = 0; i < num_cache_modes; i++)
+		for (j = 0; j < num_offsets; j++)
+			run_test(size, n, l, cache_modes[i], offsets[j],
+				 &stats[i][j]);
+	print_cache_deltas(stats);
+	print_offset_table(stats);
+	res->stats = stats[0][0];
+	res->mbs = aesperf_stats_mb_per_sec(&stats[0][0], center);
+}
+
+/* Throughput of a result: ops/s for asymmetric modes, else MiB/s */
+static double run_tput(const struct run_result *r)
+{
+	return r->asym ? r->ops : r->mbs;
+}
+
+static const char *run_tput_unit(const struct run_result *r)
+{
+	return r->asym ? "ops/s" : "MiB/s";
+}
+
+/* Reference of the deltas: the first result with a throughput, or 0 */
+static double run_tput_ref(const struct run_result *r, int num)
+{
+	int i;
+
+	for (i = 0; i < num; i++)
+		if (run_tput(&r[i]) > 0)
+			return run_tput(&r[i]);
+	return 0;
+}
+
+static void print_tput_delta(const struct run_result *r, double ref)
+{
+	if (ref > 0 && run_tput(r) > 0)
+		printf(" %+7.1f%%", 100 * (run_tput(r) - ref) / ref);
+	else
+		printf(" %8s", "n/a");
+}
+
+/* Compare the first result of each CPU against the first CPU */
+static void print_cpu_table(struct run_result *r)
+{
+	double ref = run_tput_ref(r, num_cpus);
+	int i;
+
+	if (num_cpus < 2)
+		return;
+	printf("Per-CPU comparison:\n");
+	printf("%4s %8s %10s %10s %10s %12s %8s\n", "cpu", "capacity",
+	       "max_khz", "min(μs)", "mean(μs)", run_tput_unit(&r[0]),
+	       "delta");
+	for (i = 0; i < num_cpus; i++) {
+		printf("%4d %8ld %10ld %10.3f %10.3f %12.3f", cpus[i],
+		       cpu_capacity(cpus[i]), cpu_max_freq(cpus[i]),
+		       r[i].stats.min/1000, r[i].stats.m/1000,
+		       run_tput(&r[i]));
+		print_tput_delta(&r[i], ref);
+		printf("\n");
+	}
+}
+
+/* Run on each CPU of the --cpu list, or without pinning */
+static void run_cpus(struct run_result *res)
+{
+	struct run_result cres[MAX_CPUS];
+	int i;
+
+	if (!num_cpus) {
+		run_all(res);
+		return;
+	}
+	for (i = 0; i < num_cpus; i++) {
+		pin_to_cpu(cpus[i]);
+		if (num_cpus > 1)
+			printf("cpu=%d:\n", cpus[i]);
+		run_all(&cres[i]);
+	}
+	print_cpu_table(cres);
+	*res = cres[0];
+}
+
+/* Compare the multi-instance and single-instance TA models */
+static void print_ta_table(struct run_result *r)
+{
+	int i;
+
+	if (num_ta_models < 2)
+		return;
+	printf("TA instance models:\n");
+	printf("%8s %12s %8s %10s %10s %14s\n", "ta", run_tput_unit(&r[0]),
+	       "delta", "mean(μs)", "instances", "footprint(KiB)");
+	for (i = 0; i < num_ta_models; i++) {
+		printf("%8s %12.3f", ta_model_str(ta_models[i]),
+		       run_tput(&r[i]));
+		print_tput_delta(&r[i], run_tput_ref(r, num_ta_models));
+		printf(" %10.3f %10u %14zu\n", r[i].stats.m/1000,
+		       r[i].instances, r[i].footprint / 1024);
+	}
+}
+
+#define NEXT_ARG(i) \
+	do { \
+		if (++i == argc) { \
+			fprintf(stderr, "%s: %s: missing argument\n", \
 				argv[0], argv[i-1]); \
 			return 1; \
 		} \
@@ -386,6 +4219,10 @@ int main(int argc, char *argv[])
 {
 	int i;
 	struct timespec ts;
+	struct run_result res[2];
+	const char *val;
+	char *end;
+	int metric_set = 0;
 
 	/* Parse command line */
 	for (i = 1; i < argc; i++) {
@@ -394,35 +4231,25 @@ int main(int argc, char *argv[])
 			return 0;
 		}
 	}
-	for (i = 1; i < argc; i++) {
+	if (argc > 1 && !strcmp(argv[1], "history"))
+		history = 1;
+	for (i = history + 1; i < argc; i++) {
 		if (!strcmp(argv[i], "-d")) {
-			decrypt = 1;
+			cfg->decrypt = 1;
 		} else if (!strcmp(argv[i], "-i")) {
-			in_place = 1;
+			cfg->in_place = 1;
 		} else if (!strcmp(argv[i], "-k")) {
 			NEXT_ARG(i);
-			keysize = atoi(argv[i]);
-			if (keysize != 128 && keysize != 192 &&
-				keysize != 256) {
-				fprintf(stderr, "%s: invalid key size\n",
-					argv[0]);
-				usage(argv[0]);
-				return 1;
-			}
+			cfg->keysize = atoi(argv[i]);
 		} else if (!strcmp(argv[i], "-l")) {
 			NEXT_ARG(i);
 			l = atoi(argv[i]);
 		} else if (!strcmp(argv[i], "-m")) {
 			NEXT_ARG(i);
-			if (!strcasecmp(argv[i], "ECB"))
-				mode = TA_AES_ECB;
-			else if (!strcasecmp(argv[i], "CBC"))
-				mode = TA_AES_CBC;
-			else if (!strcasecmp(argv[i], "CTR"))
-				mode = TA_AES_CTR;
-			else if (!strcasecmp(argv[i], "XTS"))
-				mode = TA_AES_XTS;
-			else {
+			for (cfg->mode = 0; cfg->mode <= TA_ECDH; cfg->mode++)
+				if (!strcasecmp(argv[i], mode_str(cfg->mode)))
+					break;
+			if (cfg->mode > TA_ECDH) {
 				fprintf(stderr, "%s, invalid mode\n",
 					argv[0]);
 				usage(argv[0]);
@@ -431,16 +4258,278 @@ int main(int argc, char *argv[])
 		} else if (!strcmp(argv[i], "-n")) {
 			NEXT_ARG(i);
 			n = atoi(argv[i]);
+			n_set = 1;
 		} else if (!strcmp(argv[i], "-r")) {
-			random_in = 1;
+			cfg->random = 1;
 		} else if (!strcmp(argv[i], "-s")) {
 			NEXT_ARG(i);
 			size = atoi(argv[i]);
+			size_set = 1;
 		} else if (!strcmp(argv[i], "-v")) {
 			verbosity++;
 		} else if (!strcmp(argv[i], "-w")) {
 			NEXT_ARG(i);
 			warmup = atoi(argv[i]);
+		} else if ((val = long_opt(argv[i], "--cache"))) {
+			if (parse_cache_modes(val) < 0) {
+				fprintf(stderr, "%s: invalid cache mode\n",
+					argv[0]);
+				usage(argv[0]);
+				return 1;
+			}
+		} else if ((val = long_opt(argv[i], "--llc"))) {
+			llc_size = parse_size(val);
+			if (!llc_size) {
+				fprintf(stderr, "%s: invalid LLC size\n",
+					argv[0]);
+				usage(argv[0]);
+				return 1;
+			}
+		} else if ((val = long_opt(argv[i], "--size-dist"))) {
+			if (parse_size_dist(val) < 0) {
+				fprintf(stderr, "%s: invalid size distribution\n",
+					argv[0]);
+				usage(argv[0]);
+				return 1;
+			}
+			size_dist_spec = val;
+		} else if ((val = long_opt(argv[i], "--duration"))) {
+			duration = parse_duration(val);
+			if (!duration) {
+				fprintf(stderr, "%s: invalid duration\n",
+					argv[0]);
+				usage(argv[0]);
+				return 1;
+			}
+		} else if ((val = long_opt(argv[i], "--interval"))) {
+			interval = parse_duration(val);
+			if (!interval) {
+				fprintf(stderr, "%s: invalid interval\n",
+					argv[0]);
+				usage(argv[0]);
+				return 1;
+			}
+		} else if ((val = long_opt(argv[i], "--cpu"))) {
+			if (parse_cpus(val) < 0) {
+				fprintf(stderr, "%s: invalid CPU list\n",
+					argv[0]);
+				usage(argv[0]);
+				return 1;
+			}
+		} else if ((val = long_opt(argv[i], "--sched"))) {
+			if (parse_sched(val) < 0) {
+				fprintf(stderr, "%s: invalid scheduling policy\n",
+					argv[0]);
+				usage(argv[0]);
+				return 1;
+			}
+		} else if (!strcmp(argv[i], "--mlock")) {
+			lock_mem = 1;
+		} else if ((val = long_opt(argv[i], "--qd"))) {
+			if (parse_qds(val) < 0) {
+				fprintf(stderr, "%s: invalid queue depth\n",
+					argv[0]);
+				usage(argv[0]);
+				return 1;
+			}
+		} else if ((val = long_opt(argv[i], "--procs"))) {
+			procs = strtoul(val, &end, 0);
+			if (*end || !procs || procs > MAX_PROCS) {
+				fprintf(stderr, "%s: invalid number of "
+					"processes\n", argv[0]);
+				usage(argv[0]);
+				return 1;
+			}
+		} else if (!strcmp(argv[i], "--cancel")) {
+			cancel = 1;
+		} else if ((val = long_opt(argv[i], "--cancel"))) {
+			cancel = 1;
+			cancel_delay = parse_duration(val);
+			if (!cancel_delay) {
+				fprintf(stderr, "%s: invalid delay\n",
+					argv[0]);
+				usage(argv[0]);
+				return 1;
+			}
+		} else if ((val = long_opt(argv[i], "--total"))) {
+			total = parse_size(val);
+			if (!total) {
+				fprintf(stderr, "%s: invalid total size\n",
+					argv[0]);
+				usage(argv[0]);
+				return 1;
+			}
+		} else if ((val = long_opt(argv[i], "--chunk"))) {
+			if (parse_chunks(val) < 0) {
+				fprintf(stderr, "%s: invalid chunk size\n",
+					argv[0]);
+				usage(argv[0]);
+				return 1;
+			}
+		} else if ((val = long_opt(argv[i], "--ta"))) {
+			num_ta_models = 1;
+			if (!strcasecmp(val, "multi")) {
+				ta_models[0] = AESPERF_TA_MULTI_INSTANCE;
+			} else if (!strcasecmp(val, "single")) {
+				ta_models[0] = AESPERF_TA_SINGLE_INSTANCE;
+			} else if (!strcasecmp(val, "both")) {
+				ta_models[0] = AESPERF_TA_MULTI_INSTANCE;
+				ta_models[1] = AESPERF_TA_SINGLE_INSTANCE;
+				num_ta_models = 2;
+			} else {
+				fprintf(stderr, "%s: invalid TA model\n",
+					argv[0]);
+				usage(argv[0]);
+				return 1;
+			}
+		} else if ((val = long_opt(argv[i], "--timer"))) {
+			if (!strcasecmp(val, "clock")) {
+				cfg->timer = AESPERF_TIMER_CLOCK;
+			} else if (!strcasecmp(val, "counter")) {
+				cfg->timer = AESPERF_TIMER_COUNTER;
+			} else {
+				fprintf(stderr, "%s: invalid timer\n",
+					argv[0]);
+				usage(argv[0]);
+				return 1;
+			}
+		} else if ((val = long_opt(argv[i], "--scenario"))) {
+			scenario_file = val;
+		} else if (!strcmp(argv[i], "--scenario")) {
+			NEXT_ARG(i);
+			scenario_file = argv[i];
+		} else if ((val = long_opt(argv[i], "--shm"))) {
+			if (!strcasecmp(val, "alloc")) {
+				cfg->shm_type = AESPERF_SHM_ALLOCATED;
+			} else if (!strcasecmp(val, "register")) {
+				cfg->shm_type = AESPERF_SHM_REGISTERED;
+			} else {
+				fprintf(stderr, "%s: invalid shm type\n",
+					argv[0]);
+				usage(argv[0]);
+				return 1;
+			}
+		} else if ((val = long_opt(argv[i], "--precision"))) {
+			precision = strtod(val, &end);
+			if (*end == '%')
+				end++;
+			if (*end || !(precision > 0)) {
+				fprintf(stderr, "%s: invalid precision\n",
+					argv[0]);
+				usage(argv[0]);
+				return 1;
+			}
+		} else if ((val = long_opt(argv[i], "--export"))) {
+			export_addr = val;
+		} else if ((val = long_opt(argv[i], "--probe-interval"))) {
+			probe_interval = parse_duration(val);
+			if (!probe_interval) {
+				fprintf(stderr, "%s: invalid probe interval\n",
+					argv[0]);
+				usage(argv[0]);
+				return 1;
+			}
+		} else if ((val = long_opt(argv[i], "--probe-modes"))) {
+			if (parse_probe_modes(val) < 0) {
+				fprintf(stderr, "%s: invalid probe modes\n",
+					argv[0]);
+				usage(argv[0]);
+				return 1;
+			}
+		} else if ((val = long_opt(argv[i], "--cpu-budget"))) {
+			cpu_budget = strtod(val, &end);
+			if (*end || !(cpu_budget > 0 && cpu_budget <= 100)) {
+				fprintf(stderr, "%s: invalid CPU budget\n",
+					argv[0]);
+				usage(argv[0]);
+				return 1;
+			}
+		} else if ((val = long_opt(argv[i], "--throughput"))) {
+			if (!strcasecmp(val, "mean")) {
+				center = AESPERF_CENTER_MEAN;
+			} else if (!strcasecmp(val, "median")) {
+				center = AESPERF_CENTER_MEDIAN;
+			} else if (!strcasecmp(val, "trimmed")) {
+				center = AESPERF_CENTER_TRIMMED;
+			} else {
+				fprintf(stderr, "%s: invalid estimator\n",
+					argv[0]);
+				usage(argv[0]);
+				return 1;
+			}
+		} else if (!strcmp(argv[i], "--attribute-outliers")) {
+			outlier_pct = 99;
+		} else if ((val = long_opt(argv[i], "--attribute-outliers"))) {
+			outlier_pct = strtod(val, &end);
+			if (*end || !(outlier_pct > 0 && outlier_pct < 100)) {
+				fprintf(stderr, "%s: invalid percentile\n",
+					argv[0]);
+				usage(argv[0]);
+				return 1;
+			}
+		} else if (!strcmp(argv[i], "--storage")) {
+			storage_size = 1024 * 1024;
+		} else if ((val = long_opt(argv[i], "--storage"))) {
+			storage_size = parse_size(val);
+			if (!storage_size || storage_size > UINT32_MAX) {
+				fprintf(stderr, "%s: invalid object size\n",
+					argv[0]);
+				usage(argv[0]);
+				return 1;
+			}
+		} else if (!strcmp(argv[i], "--store")) {
+			store_path = DEFAULT_STORE;
+		} else if ((val = long_opt(argv[i], "--store"))) {
+			store_path = val;
+		} else if (!strcmp(argv[i], "--store-hist")) {
+			store_hist = 1;
+		} else if ((val = long_opt(argv[i], "--metric"))) {
+			metric = results_metric(val);
+			if (metric < 0) {
+				fprintf(stderr, "%s: invalid metric\n",
+					argv[0]);
+				usage(argv[0]);
+				return 1;
+			}
+			metric_set = 1;
+		} else if ((val = long_opt(argv[i], "--plot"))) {
+			plot_dir = val;
+		} else if ((val = long_opt(argv[i], "--baseline"))) {
+			baseline = val;
+		} else if (!strcmp(argv[i], "--asym")) {
+			asym_suite = 1;
+		} else if (!strcmp(argv[i], "--final")) {
+			cfg->final = 1;
+		} else if (!strcmp(argv[i], "--rng")) {
+			rng = 1;
+		} else if (!strcmp(argv[i], "--copy")) {
+			copy = 1;
+		} else if ((val = long_opt(argv[i], "--copy"))) {
+			copy = 1;
+			copy_chunk = parse_size(val);
+			if (!copy_chunk || copy_chunk > UINT32_MAX) {
+				fprintf(stderr, "%s: invalid chunk size\n",
+					argv[0]);
+				usage(argv[0]);
+				return 1;
+			}
+		} else if (!strcmp(argv[i], "--verify")) {
+			verify = VERIFY_OUTPUT;
+		} else if ((val = long_opt(argv[i], "--verify"))) {
+			if (strcasecmp(val, "roundtrip")) {
+				fprintf(stderr, "%s: invalid verify mode\n",
+					argv[0]);
+				usage(argv[0]);
+				return 1;
+			}
+			verify = VERIFY_ROUNDTRIP;
+		} else if ((val = long_opt(argv[i], "--offset"))) {
+			if (parse_offsets(val) < 0) {
+				fprintf(stderr, "%s: invalid offset\n",
+					argv[0]);
+				usage(argv[0]);
+				return 1;
+			}
 		} else {
 			fprintf(stderr, "%s: invalid argument: %s\n",
 				argv[0], argv[i]);
@@ -456,10 +4545,330 @@ int main(int argc, char *argv[])
 	}
 	vverbose("Clock resolution is %lu ns\n", ts.tv_sec*1000000000 +
 		ts.tv_nsec);
+	if (!history && calibrate_timer() < 0)
+		return 1;
 
-	open_ta();
-	prepare_key();
-	run_test(size, n, l);
+	if (check_keysize(cfg->mode, &cfg->keysize) < 0) {
+		fprintf(stderr, "%s: invalid key size for %s\n", argv[0],
+			mode_str(cfg->mode));
+		usage(argv[0]);
+		return 1;
+	}
+	if (size_dist)
+		size = finalize_size_dist();
+	if (history) {
+		char config[RESULTS_CONFIG_LEN];
+
+		cfg->ta_model = ta_models[0];
+		config_str(config, sizeof(config), size, cache_modes[0],
+			   offsets[0], num_cpus ? cpus[0] : -1);
+		return results_history(store_path ? store_path : DEFAULT_STORE,
+				       config, metric) < 0;
+	}
+	if (metric_set) {
+		fprintf(stderr, "%s: --metric requires history\n", argv[0]);
+		return 1;
+	}
+	if (baseline && !plot_dir) {
+		fprintf(stderr, "%s: --baseline requires --plot\n", argv[0]);
+		return 1;
+	}
+	if (baseline && access(baseline, R_OK) < 0) {
+		perror(baseline);
+		return 1;
+	}
+	if (store_hist && !store_path) {
+		fprintf(stderr, "%s: --store-hist requires --store\n",
+			argv[0]);
+		return 1;
+	}
+	if (verify && num_qds) {
+		fprintf(stderr, "%s: --verify is not supported with --qd\n",
+			argv[0]);
+		return 1;
+	}
+	if (asym_suite || is_asym_mode(cfg->mode)) {
+		if (verify || copy || total || rng || size_dist || duration) {
+			fprintf(stderr, "%s: asymmetric modes do not support ",
+				argv[0]);
+			fprintf(stderr, "--verify, --copy, --total, --rng, ");
+			fprintf(stderr, "--size-dist or --duration\n");
+			return 1;
+		}
+		if (asym_suite && num_qds) {
+			fprintf(stderr, "%s: --asym is not supported with ",
+				argv[0]);
+			fprintf(stderr, "--qd\n");
+			return 1;
+		}
+	}
+	if (scenario_file) {
+		if (total || rng || num_qds || size_dist || duration ||
+		    storage_size || asym_suite || export_addr || copy ||
+		    num_cpus > 1 || num_ta_models > 1 ||
+		    num_cache_modes > 1 || num_offsets > 1) {
+			fprintf(stderr, "%s: --scenario is not supported ",
+				argv[0]);
+			fprintf(stderr, "with --total, --rng, --qd, ");
+			fprintf(stderr, "--size-dist, --duration, --storage, ");
+			fprintf(stderr, "--asym, --export, --copy or lists of ");
+			fprintf(stderr, "CPUs, TA models, cache modes or ");
+			fprintf(stderr, "offsets\n");
+			return 1;
+		}
+		if (verify) {
+			fprintf(stderr, "%s: --verify is not supported with ",
+				argv[0]);
+			fprintf(stderr, "--scenario\n");
+			return 1;
+		}
+		if (parse_scenarios(scenario_file) < 0)
+			return 1;
+	}
+	if (export_addr) {
+		if (verify || copy || total || rng || num_qds || size_dist ||
+		    duration || storage_size || asym_suite || outlier_pct ||
+		    num_cpus > 1 || num_ta_models > 1) {
+			fprintf(stderr, "%s: --export only supports ", argv[0]);
+			fprintf(stderr, "-m, -k, -s, -n, -l, -i, --final, ");
+			fprintf(stderr, "--timer, --cpu (one CPU), --sched, ");
+			fprintf(stderr, "--mlock and --ta=multi|single\n");
+			return 1;
+		}
+		if (!num_probe_modes)
+			probe_modes[num_probe_modes++] = cfg->mode;
+		for (i = 0; i < num_probe_modes; i++) {
+			if (is_asym_mode(probe_modes[i])) {
+				fprintf(stderr, "%s: --export does not ",
+					argv[0]);
+				fprintf(stderr, "support asymmetric modes\n");
+				return 1;
+			}
+			if (needs_blocks(probe_modes[i]) &&
+			    size % AES_BLOCK_SIZE) {
+				fprintf(stderr, "%s: --export: size must be a ",
+					argv[0]);
+				fprintf(stderr, "multiple of %d bytes\n",
+					AES_BLOCK_SIZE);
+				return 1;
+			}
+		}
+		if (!n_set)
+			n = 16;
+	} else if (num_probe_modes) {
+		fprintf(stderr, "%s: --probe-modes requires --export\n",
+			argv[0]);
+		return 1;
+	}
+	if (outlier_pct && (duration || num_qds || total || storage_size ||
+			    asym_suite || is_asym_mode(cfg->mode))) {
+		fprintf(stderr, "%s: --attribute-outliers is not supported ",
+			argv[0]);
+		fprintf(stderr, "with --duration, --qd, --total, --storage or ");
+		fprintf(stderr, "asymmetric modes\n");
+		return 1;
+	}
+	if (storage_size) {
+		if (verify || copy || total || rng || num_qds || size_dist ||
+		    duration || asym_suite) {
+			fprintf(stderr, "%s: --storage is not supported with ",
+				argv[0]);
+			fprintf(stderr, "--verify, --copy, --total, --rng, ");
+			fprintf(stderr, "--qd, --size-dist, --duration or ");
+			fprintf(stderr, "--asym\n");
+			return 1;
+		}
+		if (!size || size > storage_size) {
+			fprintf(stderr, "%s: --storage: -s must be between 1 ",
+				argv[0]);
+			fprintf(stderr, "and the object size\n");
+			return 1;
+		}
+	}
+	if (procs) {
+		if (verify || copy || total || num_qds || size_dist ||
+		    duration || storage_size || asym_suite ||
+		    is_asym_mode(cfg->mode) || scenario_file || export_addr ||
+		    outlier_pct || precision || store_path || plot_dir ||
+		    num_ta_models > 1 || num_cache_modes > 1 ||
+		    cache_modes[0] != CACHE_WARM || num_offsets > 1 ||
+		    offsets[0]) {
+			fprintf(stderr, "%s: --procs only supports ", argv[0]);
+			fprintf(stderr, "-m, -k, -s, -n, -l, -d, -i, -r, -w, ");
+			fprintf(stderr, "--final, --rng, --timer, --shm, ");
+			fprintf(stderr, "--cpu, --sched, --mlock and ");
+			fprintf(stderr, "--ta=multi|single\n");
+			return 1;
+		}
+	}
+	if (cancel) {
+		if (verify || copy || total || rng || num_qds || size_dist ||
+		    duration || storage_size || asym_suite || procs ||
+		    num_cpus > 1 ||
+		    scenario_file || export_addr || outlier_pct ||
+		    precision || store_path || plot_dir ||
+		    num_ta_models > 1 || num_cache_modes > 1 ||
+		    cache_modes[0] != CACHE_WARM || num_offsets > 1 ||
+		    offsets[0]) {
+			fprintf(stderr, "%s: --cancel only supports ", argv[0]);
+			fprintf(stderr, "-m, -k, -s, -n, -l, -d, -i, -r, -w, ");
+			fprintf(stderr, "--timer, --shm, --cpu (one CPU), ");
+			fprintf(stderr, "--sched, --mlock and ");
+			fprintf(stderr, "--ta=multi|single\n");
+			return 1;
+		}
+		if (is_hash_mode(cfg->mode) || is_asym_mode(cfg->mode)) {
+			fprintf(stderr, "%s: --cancel only supports AES ",
+				argv[0]);
+			fprintf(stderr, "ciphers\n");
+			return 1;
+		}
+	}
+	if (rng) {
+		if (verify || copy || total) {
+			fprintf(stderr, "%s: --rng is not supported with ",
+				argv[0]);
+			fprintf(stderr, "--verify, --copy or --total\n");
+			return 1;
+		}
+		cfg->cmd = TA_AES_PERF_CMD_RANDOM;
+		rng_sweep = !size_set && !size_dist && !num_qds && !procs;
+		if (rng_sweep)
+			size = rng_sizes[NUM_RNG_SIZES - 1];
+	}
+	if (copy)
+		cfg->cmd = TA_AES_PERF_CMD_PROCESS_COPY;
+	if (total) {
+		if (num_qds || size_dist || duration) {
+			fprintf(stderr, "%s: --total is not supported with ",
+				argv[0]);
+			fprintf(stderr, "--qd, --size-dist or --duration\n");
+			return 1;
+		}
+		if (!num_chunks)
+			chunks[num_chunks++] = size;
+		for (i = 0; i < num_chunks; i++) {
+			if (needs_blocks(cfg->mode) &&
+			    (chunks[i] % AES_BLOCK_SIZE ||
+			     total % AES_BLOCK_SIZE)) {
+				fprintf(stderr, "%s: --total and --chunk must ",
+					argv[0]);
+				fprintf(stderr, "be multiples of %d bytes\n",
+					AES_BLOCK_SIZE);
+				return 1;
+			}
+			if (chunks[i] > size)
+				size = chunks[i];
+		}
+		l = 1;
+	} else if (num_chunks) {
+		fprintf(stderr, "%s: --chunk requires --total\n", argv[0]);
+		return 1;
+	}
+	if (copy && num_qds) {
+		fprintf(stderr, "%s: --copy is not supported with --qd\n",
+			argv[0]);
+		return 1;
+	}
+	if (copy && is_hash_mode(cfg->mode)) {
+		fprintf(stderr, "%s: --copy only supports AES ciphers\n",
+			argv[0]);
+		return 1;
+	}
+	if (copy && needs_blocks(cfg->mode) && copy_chunk % AES_BLOCK_SIZE) {
+		fprintf(stderr, "%s: --copy: chunk size must be a multiple",
+			argv[0]);
+		fprintf(stderr, " of %d bytes\n", AES_BLOCK_SIZE);
+		return 1;
+	}
+	if (verify) {
+		if (is_hash_mode(cfg->mode) &&
+		    (!cfg->final || verify == VERIFY_ROUNDTRIP)) {
+			fprintf(stderr, "%s: --verify of digests and MACs ",
+				argv[0]);
+			fprintf(stderr, "requires --final (no round trip)\n");
+			return 1;
+		}
+		if (needs_blocks(cfg->mode) && size % AES_BLOCK_SIZE) {
+			fprintf(stderr, "%s: --verify: size must be a multiple",
+				argv[0]);
+			fprintf(stderr, " of %d bytes\n", AES_BLOCK_SIZE);
+			return 1;
+		}
+		if (verify == VERIFY_ROUNDTRIP && l != 1) {
+			fprintf(stderr, "%s: --verify=roundtrip requires -l 1\n",
+				argv[0]);
+			return 1;
+		}
+		verify_alloc(size);
+	}
+	if (!llc_size)
+		llc_size = get_llc_size();
+	vverbose("Last-level cache size is %zu bytes\n", llc_size);
+
+	if (lock_mem && mlockall(MCL_CURRENT | MCL_FUTURE) < 0) {
+		perror("mlockall");
+		return 1;
+	}
+	if (sched_policy >= 0)
+		set_sched();
+
+	if (scenario_file) {
+		cfg->ta_model = ta_models[0];
+		if (num_cpus)
+			pin_to_cpu(cpus[0]);
+		open_ta();
+		run_scenarios();
+		close_ta();
+		if (plot_dir)
+			write_plots();
+		return 0;
+	}
+
+	if (cancel) {
+		cfg->ta_model = ta_models[0];
+		if (num_cpus)
+			pin_to_cpu(cpus[0]);
+		open_ta();
+		prepare_key(&ap.sess);
+		run_cancel(size, n, l);
+		close_ta();
+		return 0;
+	}
+
+	if (procs) {
+		cfg->ta_model = ta_models[0];
+		/* Each worker opens the TA */
+		run_procs(size, n, l);
+		return 0;
+	}
+
+	if (export_addr) {
+		cfg->ta_model = ta_models[0];
+		if (num_cpus)
+			pin_to_cpu(cpus[0]);
+		open_ta();
+		/* Closes the TA */
+		run_exporter();
+		return 0;
+	}
+
+	for (i = 0; i < num_ta_models; i++) {
+		cfg->ta_model = ta_models[i];
+		if (num_ta_models > 1)
+			printf("ta=%s:\n", ta_model_str(cfg->ta_model));
+		open_ta();
+		/* Asymmetric key pairs are generated by run_asym() */
+		if (!asym_suite && !is_asym_mode(cfg->mode) && !storage_size)
+			prepare_key(&ap.sess);
+		if (verify)
+			verify_init();
+		run_cpus(&res[i]);
+		close_ta();
+	}
+	print_ta_table(res);
+	if (plot_dir)
+		write_plots();
 
 	return 0;
 }
@@ -0,0 +1,380 @@
+/*
+ * Copyright (c) 2015, Linaro Limited
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <string.h>
+
+#include "aes_ref.h"
+#include "ta_aes_perf.h"
+
+static const uint8_t sbox[256] = {
+	0x63, 0x7c, 0x77, 0x7b, 0xf2, 0x6b, 0x6f, 0xc5,
+	0x30, 0x01, 0x67, 0x2b, 0xfe, 0xd7, 0xab, 0x76,
+	0xca, 0x82, 0xc9, 0x7d, 0xfa, 0x59, 0x47, 0xf0,
+	0xad, 0xd4, 0xa2, 0xaf, 0x9c, 0xa4, 0x72, 0xc0,
+	0xb7, 0xfd, 0x93, 0x26, 0x36, 0x3f, 0xf7, 0xcc,
+	0x34, 0xa5, 0xe5, 0xf1, 0x71, 0xd8, 0x31, 0x15,
+	0x04, 0xc7, 0x23, 0xc3, 0x18, 0x96, 0x05, 0x9a,
+	0x07, 0x12, 0x80, 0xe2, 0xeb, 0x27, 0xb2, 0x75,
+	0x09, 0x83, 0x2c, 0x1a, 0x1b, 0x6e, 0x5a, 0xa0,
+	0x52, 0x3b, 0xd6, 0xb3, 0x29, 0xe3, 0x2f, 0x84,
+	0x53, 0xd1, 0x00, 0xed, 0x20, 0xfc, 0xb1, 0x5b,
+	0x6a, 0xcb, 0xbe, 0x39, 0x4a, 0x4c, 0x58, 0xcf,
+	0xd0, 0xef, 0xaa, 0xfb, 0x43, 0x4d, 0x33, 0x85,
+	0x45, 0xf9, 0x02, 0x7f, 0x50, 0x3c, 0x9f, 0xa8,
+	0x51, 0xa3, 0x40, 0x8f, 0x92, 0x9d, 0x38, 0xf5,
+	0xbc, 0xb6, 0xda, 0x21, 0x10, 0xff, 0xf3, 0xd2,
+	0xcd, 0x0c, 0x13, 0xec, 0x5f, 0x97, 0x44, 0x17,
+	0xc4, 0xa7, 0x7e, 0x3d, 0x64, 0x5d, 0x19, 0x73,
+	0x60, 0x81, 0x4f, 0xdc, 0x22, 0x2a, 0x90, 0x88,
+	0x46, 0xee, 0xb8, 0x14, 0xde, 0x5e, 0x0b, 0xdb,
+	0xe0, 0x32, 0x3a, 0x0a, 0x49, 0x06, 0x24, 0x5c,
+	0xc2, 0xd3, 0xac, 0x62, 0x91, 0x95, 0xe4, 0x79,
+	0xe7, 0xc8, 0x37, 0x6d, 0x8d, 0xd5, 0x4e, 0xa9,
+	0x6c, 0x56, 0xf4, 0xea, 0x65, 0x7a, 0xae, 0x08,
+	0xba, 0x78, 0x25, 0x2e, 0x1c, 0xa6, 0xb4, 0xc6,
+	0xe8, 0xdd, 0x74, 0x1f, 0x4b, 0xbd, 0x8b, 0x8a,
+	0x70, 0x3e, 0xb5, 0x66, 0x48, 0x03, 0xf6, 0x0e,
+	0x61, 0x35, 0x57, 0xb9, 0x86, 0xc1, 0x1d, 0x9e,
+	0xe1, 0xf8, 0x98, 0x11, 0x69, 0xd9, 0x8e, 0x94,
+	0x9b, 0x1e, 0x87, 0xe9, 0xce, 0x55, 0x28, 0xdf,
+	0x8c, 0xa1, 0x89, 0x0d, 0xbf, 0xe6, 0x42, 0x68,
+	0x41, 0x99, 0x2d, 0x0f, 0xb0, 0x54, 0xbb, 0x16,
+};
+
+static const uint8_t inv_sbox[256] = {
+	0x52, 0x09, 0x6a, 0xd5, 0x30, 0x36, 0xa5, 0x38,
+	0xbf, 0x40, 0xa3, 0x9e, 0x81, 0xf3, 0xd7, 0xfb,
+	0x7c, 0xe3, 0x39, 0x82, 0x9b, 0x2f, 0xff, 0x87,
+	0x34, 0x8e, 0x43, 0x44, 0xc4, 0xde, 0xe9, 0xcb,
+	0x54, 0x7b, 0x94, 0x32, 0xa6, 0xc2, 0x23, 0x3d,
+	0xee, 0x4c, 0x95, 0x0b, 0x42, 0xfa, 0xc3, 0x4e,
+	0x08, 0x2e, 0xa1, 0x66, 0x28, 0xd9, 0x24, 0xb2,
+	0x76, 0x5b, 0xa2, 0x49, 0x6d, 0x8b, 0xd1, 0x25,
+	0x72, 0xf8, 0xf6, 0x64, 0x86, 0x68, 0x98, 0x16,
+	0xd4, 0xa4, 0x5c, 0xcc, 0x5d, 0x65, 0xb6, 0x92,
+	0x6c, 0x70, 0x48, 0x50, 0xfd, 0xed, 0xb9, 0xda,
+	0x5e, 0x15, 0x46, 0x57, 0xa7, 0x8d, 0x9d, 0x84,
+	0x90, 0xd8, 0xab, 0x00, 0x8c, 0xbc, 0xd3, 0x0a,
+	0xf7, 0xe4, 0x58, 0x05, 0xb8, 0xb3, 0x45, 0x06,
+	0xd0, 0x2c, 0x1e, 0x8f, 0xca, 0x3f, 0x0f, 0x02,
+	0xc1, 0xaf, 0xbd, 0x03, 0x01, 0x13, 0x8a, 0x6b,
+	0x3a, 0x91, 0x11, 0x41, 0x4f, 0x67, 0xdc, 0xea,
+	0x97, 0xf2, 0xcf, 0xce, 0xf0, 0xb4, 0xe6, 0x73,
+	0x96, 0xac, 0x74, 0x22, 0xe7, 0xad, 0x35, 0x85,
+	0xe2, 0xf9, 0x37, 0xe8, 0x1c, 0x75, 0xdf, 0x6e,
+	0x47, 0xf1, 0x1a, 0x71, 0x1d, 0x29, 0xc5, 0x89,
+	0x6f, 0xb7, 0x62, 0x0e, 0xaa, 0x18, 0xbe, 0x1b,
+	0xfc, 0x56, 0x3e, 0x4b, 0xc6, 0xd2, 0x79, 0x20,
+	0x9a, 0xdb, 0xc0, 0xfe, 0x78, 0xcd, 0x5a, 0xf4,
+	0x1f, 0xdd, 0xa8, 0x33, 0x88, 0x07, 0xc7, 0x31,
+	0xb1, 0x12, 0x10, 0x59, 0x27, 0x80, 0xec, 0x5f,
+	0x60, 0x51, 0x7f, 0xa9, 0x19, 0xb5, 0x4a, 0x0d,
+	0x2d, 0xe5, 0x7a, 0x9f, 0x93, 0xc9, 0x9c, 0xef,
+	0xa0, 0xe0, 0x3b, 0x4d, 0xae, 0x2a, 0xf5, 0xb0,
+	0xc8, 0xeb, 0xbb, 0x3c, 0x83, 0x53, 0x99, 0x61,
+	0x17, 0x2b, 0x04, 0x7e, 0xba, 0x77, 0xd6, 0x26,
+	0xe1, 0x69, 0x14, 0x63, 0x55, 0x21, 0x0c, 0x7d,
+};
+
+static uint8_t xtime(uint8_t x)
+{
+	return (x << 1) ^ ((x & 0x80) ? 0x1b : 0);
+}
+
+static uint8_t gmul(uint8_t a, uint8_t b)
+{
+	uint8_t r = 0;
+
+	while (b) {
+		if (b & 1)
+			r ^= a;
+		a = xtime(a);
+		b >>= 1;
+	}
+	return r;
+}
+
+void aes_ref_set_key(struct aes_ref_key *k, const uint8_t *key,
+		     size_t keylen)
+{
+	uint8_t *w = &k->rk[0][0];
+	size_t nk = keylen / 4;
+	size_t nwords;
+	uint8_t rcon = 1;
+	uint8_t t[4];
+	uint8_t tmp;
+	size_t i;
+
+	k->rounds = nk + 6;
+	nwords = 4 * (k->rounds + 1);
+	memcpy(w, key, keylen);
+	for (i = nk; i < nwords; i++) {
+		memcpy(t, w + 4 * (i - 1), 4);
+		if (i % nk == 0) {
+			tmp = t[0];
+			t[0] = sbox[t[1]] ^ rcon;
+			t[1] = sbox[t[2]];
+			t[2] = sbox[t[3]];
+			t[3] = sbox[tmp];
+			rcon = xtime(rcon);
+		} else if (nk > 6 && i % nk == 4) {
+			t[0] = sbox[t[0]];
+			t[1] = sbox[t[1]];
+			t[2] = sbox[t[2]];
+			t[3] = sbox[t[3]];
+		}
+		w[4 * i + 0] = w[4 * (i - nk) + 0] ^ t[0];
+		w[4 * i + 1] = w[4 * (i - nk) + 1] ^ t[1];
+		w[4 * i + 2] = w[4 * (i - nk) + 2] ^ t[2];
+		w[4 * i + 3] = w[4 * (i - nk) + 3] ^ t[3];
+	}
+}
+
+static void add_round_key(uint8_t *s, const uint8_t *rk)
+{
+	int i;
+
+	for (i = 0; i < AES_BLOCK_SIZE; i++)
+		s[i] ^= rk[i];
+}
+
+/* SubBytes and ShiftRows. The state is stored column by column. */
+static void sub_shift(uint8_t *s)
+{
+	uint8_t t[AES_BLOCK_SIZE];
+	int r, c;
+
+	for (c = 0; c < 4; c++)
+		for (r = 0; r < 4; r++)
+			t[4 * c + r] = sbox[s[4 * ((c + r) % 4) + r]];
+	memcpy(s, t, sizeof(t));
+}
+
+static void inv_sub_shift(uint8_t *s)
+{
+	uint8_t t[AES_BLOCK_SIZE];
+	int r, c;
+
+	for (c = 0; c < 4; c++)
+		for (r = 0; r < 4; r++)
+			t[4 * ((c + r) % 4) + r] = inv_sbox[s[4 * c + r]];
+	memcpy(s, t, sizeof(t));
+}
+
+static void mix_columns(uint8_t *s)
+{
+	uint8_t a0, a1, a2, a3, all;
+	int c;
+
+	for (c = 0; c < 4; c++, s += 4) {
+		a0 = s[0];
+		a1 = s[1];
+		a2 = s[2];
+		a3 = s[3];
+		all = a0 ^ a1 ^ a2 ^ a3;
+		s[0] ^= all ^ xtime(a0 ^ a1);
+		s[1] ^= all ^ xtime(a1 ^ a2);
+		s[2] ^= all ^ xtime(a2 ^ a3);
+		s[3] ^= all ^ xtime(a3 ^ a0);
+	}
+}
+
+static void inv_mix_columns(uint8_t *s)
+{
+	uint8_t a0, a1, a2, a3;
+	int c;
+
+	for (c = 0; c < 4; c++, s += 4) {
+		a0 = s[0];
+		a1 = s[1];
+		a2 = s[2];
+		a3 = s[3];
+		s[0] = gmul(a0, 14) ^ gmul(a1, 11) ^ gmul(a2, 13) ^ gmul(a3, 9);
+		s[1] = gmul(a0, 9) ^ gmul(a1, 14) ^ gmul(a2, 11) ^ gmul(a3, 13);
+		s[2] = gmul(a0, 13) ^ gmul(a1, 9) ^ gmul(a2, 14) ^ gmul(a3, 11);
+		s[3] = gmul(a0, 11) ^ gmul(a1, 13) ^ gmul(a2, 9) ^ gmul(a3, 14);
+	}
+}
+
+void aes_ref_encrypt_block(const struct aes_ref_key *k, const uint8_t *in,
+			   uint8_t *out)
+{
+	uint8_t s[AES_BLOCK_SIZE];
+	int r;
+
+	memcpy(s, in, sizeof(s));
+	add_round_key(s, k->rk[0]);
+	for (r = 1; r < k->rounds; r++) {
+		sub_shift(s);
+		mix_columns(s);
+		add_round_key(s, k->rk[r]);
+	}
+	sub_shift(s);
+	add_round_key(s, k->rk[k->rounds]);
+	memcpy(out, s, sizeof(s));
+}
+
+void aes_ref_decrypt_block(const struct aes_ref_key *k, const uint8_t *in,
+			   uint8_t *out)
+{
+	uint8_t s[AES_BLOCK_SIZE];
+	int r;
+
+	memcpy(s, in, sizeof(s));
+	add_round_key(s, k->rk[k->rounds]);
+	for (r = k->rounds - 1; r > 0; r--) {
+		inv_sub_shift(s);
+		add_round_key(s, k->rk[r]);
+		inv_mix_columns(s);
+	}
+	inv_sub_shift(s);
+	add_round_key(s, k->rk[0]);
+	memcpy(out, s, sizeof(s));
+}
+
+static void xor_block(uint8_t *dst, const uint8_t *a, const uint8_t *b)
+{
+	int i;
+
+	for (i = 0; i < AES_BLOCK_SIZE; i++)
+		dst[i] = a[i] ^ b[i];
+}
+
+/* Big-endian 128-bit counter increment */
+static void ctr_inc(uint8_t *ctr)
+{
+	int i;
+
+	for (i = AES_BLOCK_SIZE - 1; i >= 0; i--)
+		if (++ctr[i])
+			break;
+}
+
+/* Multiply the XTS tweak by alpha in GF(2^128) (little-endian) */
+static void xts_mul_alpha(uint8_t *t)
+{
+	uint8_t carry = 0;
+	uint8_t c;
+	int i;
+
+	for (i = 0; i < AES_BLOCK_SIZE; i++) {
+		c = t[i] >> 7;
+		t[i] = (t[i] << 1) | carry;
+		carry = c;
+	}
+	if (carry)
+		t[0] ^= 0x87;
+}
+
+int aes_ref_init(struct aes_ref_ctx *ctx, int mode, int decrypt,
+		 const uint8_t *key, const uint8_t *key2, size_t keylen,
+		 const uint8_t *iv)
+{
+	memset(ctx, 0, sizeof(*ctx));
+	ctx->mode = mode;
+	ctx->decrypt = decrypt;
+	aes_ref_set_key(&ctx->key, key, keylen);
+
+	switch (mode) {
+	case TA_AES_ECB:
+		break;
+	case TA_AES_CBC:
+		memcpy(ctx->iv, iv, AES_BLOCK_SIZE);
+		break;
+	case TA_AES_CTR:
+		memcpy(ctx->iv, iv, AES_BLOCK_SIZE);
+		ctx->ks_pos = AES_BLOCK_SIZE;
+		break;
+	case TA_AES_XTS:
+		/* Keep the encrypted tweak */
+		aes_ref_set_key(&ctx->key2, key2, keylen);
+		aes_ref_encrypt_block(&ctx->key2, iv, ctx->iv);
+		break;
+	default:
+		return -1;
+	}
+	return 0;
+}
+
+int aes_ref_update(struct aes_ref_ctx *ctx, const uint8_t *in, uint8_t *out,
+		   size_t len)
+{
+	uint8_t b[AES_BLOCK_SIZE];
+	size_t i;
+
+	if (ctx->mode == TA_AES_CTR) {
+		for (i = 0; i < len; i++) {
+			if (ctx->ks_pos == AES_BLOCK_SIZE) {
+				aes_ref_encrypt_block(&ctx->key, ctx->iv,
+						      ctx->ks);
+				ctr_inc(ctx->iv);
+				ctx->ks_pos = 0;
+			}
+			out[i] = in[i] ^ ctx->ks[ctx->ks_pos++];
+		}
+		return 0;
+	}
+
+	if (len % AES_BLOCK_SIZE)
+		return -1;
+
+	for (i = 0; i < len; i += AES_BLOCK_SIZE, in += AES_BLOCK_SIZE,
+	     out += AES_BLOCK_SIZE) {
+		switch (ctx->mode) {
+		case TA_AES_ECB:
+			if (ctx->decrypt)
+				aes_ref_decrypt_block(&ctx->key, in, out);
+			else
+				aes_ref_encrypt_block(&ctx->key, in, out);
+			break;
+		case TA_AES_CBC:
+			if (ctx->decrypt) {
+				memcpy(b, in, AES_BLOCK_SIZE);
+				aes_ref_decrypt_block(&ctx->key, in, out);
+				xor_block(out, out, ctx->iv);
+				memcpy(ctx->iv, b, AES_BLOCK_SIZE);
+			} else {
+				xor_block(b, in, ctx->iv);
+				aes_ref_encrypt_block(&ctx->key, b, out);
+				memcpy(ctx->iv, out, AES_BLOCK_SIZE);
+			}
+			break;
+		case TA_AES_XTS:
+			xor_block(b, in, ctx->iv);
+			if (ctx->decrypt)
+				aes_ref_decrypt_block(&ctx->key, b, b);
+			else
+				aes_ref_encrypt_block(&ctx->key, b, b);
+			xor_block(out, b, ctx->iv);
+			xts_mul_alpha(ctx->iv);
+			break;
+		default:
+			return -1;
+		}
+	}
+	return 0;
+}
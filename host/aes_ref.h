@@ -0,0 +1,85 @@
+/*
+ * Copyright (c) 2015, Linaro Limited
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef AES_REF_H
+#define AES_REF_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * Reference AES implementation, used to check the output of the TA.
+ * This is a straightforward byte-oriented implementation of FIPS-197; it is
+ * not meant to be fast nor to resist side-channel attacks.
+ */
+
+#define AES_BLOCK_SIZE	16
+
+struct aes_ref_key {
+	uint8_t rk[15][AES_BLOCK_SIZE];	/* Round keys */
+	int rounds;
+};
+
+/*
+ * Streaming cipher context: successive calls to aes_ref_update() behave like
+ * successive TEE_CipherUpdate() calls after a single TEE_CipherInit(), i.e.,
+ * the CBC chaining value, CTR counter and keystream position and XTS tweak
+ * carry over from one call to the next.
+ */
+struct aes_ref_ctx {
+	int mode;		/* TA_AES_ECB, TA_AES_CBC, ... */
+	int decrypt;
+	struct aes_ref_key key;
+	struct aes_ref_key key2;	/* XTS tweak key */
+	uint8_t iv[AES_BLOCK_SIZE];	/* CBC chain, CTR counter, XTS tweak */
+	uint8_t ks[AES_BLOCK_SIZE];	/* CTR keystream block */
+	size_t ks_pos;			/* Bytes of ks already used */
+};
+
+void aes_ref_set_key(struct aes_ref_key *k, const uint8_t *key,
+		     size_t keylen);
+void aes_ref_encrypt_block(const struct aes_ref_key *k, const uint8_t *in,
+			   uint8_t *out);
+void aes_ref_decrypt_block(const struct aes_ref_key *k, const uint8_t *in,
+			   uint8_t *out);
+
+/*
+ * keylen is in bytes. key2 is only used in XTS mode, iv is ignored in ECB
+ * mode. Returns -1 if the mode is not supported.
+ */
+int aes_ref_init(struct aes_ref_ctx *ctx, int mode, int decrypt,
+		 const uint8_t *key, const uint8_t *key2, size_t keylen,
+		 const uint8_t *iv);
+
+/*
+ * Process len bytes from in to out (which may be the same buffer). Returns -1
+ * if len is not a multiple of the block size in ECB, CBC or XTS mode.
+ */
+int aes_ref_update(struct aes_ref_ctx *ctx, const uint8_t *in, uint8_t *out,
+		   size_t len);
+
+#endif /* AES_REF_H */
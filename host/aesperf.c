@@ -0,0 +1,554 @@
+/*
+ * Copyright (c) 2015, Linaro Limited
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <fcntl.h>
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "aesperf.h"
+
+void aesperf_config_init(struct aesperf_config *cfg)
+{
+	memset(cfg, 0, sizeof(*cfg));
+	cfg->mode = TA_AES_ECB;
+	cfg->keysize = 128;
+	cfg->size = 1024;
+	cfg->loops = 1;
+	cfg->shm_type = AESPERF_SHM_ALLOCATED;
+	cfg->ta_model = AESPERF_TA_MULTI_INSTANCE;
+	cfg->timer = AESPERF_TIMER_CLOCK;
+	cfg->cmd = TA_AES_PERF_CMD_PROCESS;
+}
+
+/*
+ * Statistics
+ */
+
+/* Take new sample into account (Knuth/Welford algorithm) */
+void aesperf_stats_update(struct aesperf_stats *s, uint64_t t)
+{
+	double x = (double)t;
+	double delta = x - s->m;
+
+	s->n++;
+	s->m += delta/s->n;
+	s->M2 += delta*(x - s->m);
+	if (!s->initialized) {
+		s->min = s->max = x;
+		s->initialized = 1;
+	} else {
+		if (s->min > x)
+			s->min = x;
+		if (s->max < x)
+			s->max = x;
+	}
+}
+
+double aesperf_stats_stddev(const struct aesperf_stats *s)
+{
+	if (s->n < 2)
+		return NAN;
+	return sqrt(s->M2/s->n);
+}
+
+double aesperf_stats_ci_pct(const struct aesperf_stats *s)
+{
+	if (s->n < 2)
+		return INFINITY;
+	return 100 * 1.96 * aesperf_stats_stddev(s) / sqrt(s->n) / s->m;
+}
+
+double aesperf_stats_center(const struct aesperf_stats *s, int center)
+{
+	if (s->robust && center == AESPERF_CENTER_MEDIAN)
+		return s->median;
+	if (s->robust && center == AESPERF_CENTER_TRIMMED)
+		return s->trimmed;
+	return s->m;
+}
+
+double aesperf_stats_mb_per_sec(const struct aesperf_stats *s, int center)
+{
+	return (1000000000/aesperf_stats_center(s, center))*
+	       (s->bytes/s->n/(1024*1024));
+}
+
+int aesperf_cmp_u64(const void *a, const void *b)
+{
+	uint64_t x = *(const uint64_t *)a;
+	uint64_t y = *(const uint64_t *)b;
+
+	return (x > y) - (x < y);
+}
+
+uint64_t aesperf_percentile(const uint64_t *sorted, size_t n, double p)
+{
+	size_t rank = ceil(p / 100 * n);
+
+	if (rank < 1)
+		rank = 1;
+	return sorted[rank - 1];
+}
+
+double aesperf_quantile(const uint64_t *sorted, size_t n, double q)
+{
+	double h = q * (n - 1);
+	size_t i = h;
+
+	if (i + 1 >= n)
+		return sorted[n - 1];
+	return sorted[i] + (h - i) * ((double)sorted[i + 1] - sorted[i]);
+}
+
+int aesperf_stats_robust(struct aesperf_stats *s, uint64_t *samples,
+			 size_t n)
+{
+	uint64_t *dev;
+	double iqr;
+	double sum = 0;
+	size_t k = n / 20;
+	size_t i;
+
+	if (!n)
+		return 0;
+	qsort(samples, n, sizeof(*samples), aesperf_cmp_u64);
+	s->median = aesperf_quantile(samples, n, 0.5);
+	s->q1 = aesperf_quantile(samples, n, 0.25);
+	s->q3 = aesperf_quantile(samples, n, 0.75);
+	iqr = s->q3 - s->q1;
+
+	dev = malloc(n * sizeof(*dev));
+	if (!dev) {
+		perror("malloc");
+		return -1;
+	}
+	for (i = 0; i < n; i++)
+		dev[i] = fabs(samples[i] - s->median) + 0.5;
+	qsort(dev, n, sizeof(*dev), aesperf_cmp_u64);
+	s->mad = aesperf_quantile(dev, n, 0.5);
+	free(dev);
+
+	for (i = k; i < n - k; i++)
+		sum += samples[i];
+	s->trimmed = sum / (n - 2 * k);
+
+	s->low_outliers = s->high_outliers = s->far_outliers = 0;
+	for (i = 0; i < n; i++) {
+		if (samples[i] < s->q1 - 1.5 * iqr)
+			s->low_outliers++;
+		if (samples[i] > s->q3 + 1.5 * iqr)
+			s->high_outliers++;
+		if (samples[i] > s->q3 + 3 * iqr)
+			s->far_outliers++;
+	}
+	s->robust = 1;
+	return 0;
+}
+
+void aesperf_report(FILE *f, const struct aesperf_stats *s, int center)
+{
+	fprintf(f, "min=%gμs max=%gμs mean=%gμs stddev=%gμs (%gMiB/s)\n",
+		s->min/1000, s->max/1000, s->m/1000,
+		aesperf_stats_stddev(s)/1000,
+		aesperf_stats_mb_per_sec(s, center));
+	if (!s->robust)
+		return;
+	fprintf(f, "median=%gμs MAD=%gμs IQR=%gμs trimmed mean(5%%)=%gμs ",
+		s->median/1000, s->mad/1000, (s->q3 - s->q1)/1000,
+		s->trimmed/1000);
+	fprintf(f, "outliers: %d low, %d high (%d far)\n", s->low_outliers,
+		s->high_outliers, s->far_outliers);
+}
+
+/*
+ * Timer
+ */
+
+/* Frequency advertised by the system, 0 if unknown (TSC) */
+static uint64_t counter_freq(void)
+{
+	uint64_t f = 0;
+#if defined(__aarch64__)
+	asm volatile("mrs %0, cntfrq_el0" : "=r" (f));
+#elif defined(__arm__)
+	uint32_t f32;
+
+	asm volatile("mrc p15, 0, %0, c14, c0, 0" : "=r" (f32));
+	f = f32;
+#endif
+	return f;
+}
+
+static uint64_t raw_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC_RAW, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+/* Measure the counter frequency over 100 ms of CLOCK_MONOTONIC_RAW */
+static int calibrate_counter(struct aesperf_timer *t)
+{
+	struct timespec d = { 0, 100000000 };
+	uint64_t r0, r1, c0, c1;
+	uint64_t f = counter_freq();
+	double hz;
+
+	if (!AESPERF_HAVE_COUNTER) {
+		fprintf(stderr, "No cycle counter on this architecture\n");
+		return -1;
+	}
+	r0 = raw_ns();
+	c0 = aesperf_read_counter();
+	nanosleep(&d, NULL);
+	r1 = raw_ns();
+	c1 = aesperf_read_counter();
+	if (c1 <= c0) {
+		fprintf(stderr, "Cycle counter is not running\n");
+		return -1;
+	}
+	hz = (double)(c1 - c0) * 1000000000 / (r1 - r0);
+	if (f && fabs(hz - f) > f / 100) {
+		fprintf(stderr, "Warning: counter runs at %.0f Hz, ", hz);
+		fprintf(stderr, "CNTFRQ says %llu Hz\n", (unsigned long long)f);
+	} else if (f) {
+		hz = f;
+	}
+	t->hz = hz;
+	t->counter_ns = 1000000000 / hz;
+	return 0;
+}
+
+/* Calibrate, then measure the median cost of an empty pair of reads */
+int aesperf_timer_init(struct aesperf_timer *t, int type)
+{
+	uint64_t samples[1001];
+	uint64_t t0, t1;
+	size_t i;
+
+	memset(t, 0, sizeof(*t));
+	t->type = type;
+	if (type == AESPERF_TIMER_COUNTER && calibrate_counter(t) < 0)
+		return -1;
+	for (i = 0; i < sizeof(samples) / sizeof(samples[0]); i++) {
+		t0 = aesperf_timer_read(t);
+		t1 = aesperf_timer_read(t);
+		samples[i] = aesperf_timer_diff_ns(t, t0, t1);
+	}
+	qsort(samples, i, sizeof(samples[0]), aesperf_cmp_u64);
+	t->overhead = samples[i / 2];
+	t->overhead_min = samples[0];
+	t->overhead_max = samples[i - 1];
+	return 0;
+}
+
+/*
+ * TEE client stuff
+ */
+
+TEEC_Result aesperf_open_session(struct aesperf_ctx *c, TEEC_Session *s)
+{
+	TEEC_UUID uuid = TA_AES_PERF_UUID;
+	TEEC_UUID si_uuid = TA_AES_PERF_SI_UUID;
+	uint32_t err_origin;
+
+	return TEEC_OpenSession(&c->ctx, s,
+				c->cfg.ta_model == AESPERF_TA_SINGLE_INSTANCE ?
+				&si_uuid : &uuid, TEEC_LOGIN_PUBLIC, NULL,
+				NULL, &err_origin);
+}
+
+TEEC_Result aesperf_open_ta(struct aesperf_ctx *c,
+			    const struct aesperf_config *cfg)
+{
+	TEEC_Result res;
+
+	/* c->timer is left alone, cfg may be &c->cfg */
+	if (cfg != &c->cfg)
+		c->cfg = *cfg;
+	memset(&c->in_shm, 0, sizeof(c->in_shm));
+	memset(&c->out_shm, 0, sizeof(c->out_shm));
+	memset(&c->op, 0, sizeof(c->op));
+	c->in_shm.flags = TEEC_MEM_INPUT | TEEC_MEM_OUTPUT;
+	c->out_shm.flags = TEEC_MEM_INPUT | TEEC_MEM_OUTPUT;
+	c->rnd = -1;
+
+	res = TEEC_InitializeContext(NULL, &c->ctx);
+	if (res != TEEC_SUCCESS)
+		return res;
+	res = aesperf_open_session(c, &c->sess);
+	if (res != TEEC_SUCCESS)
+		TEEC_FinalizeContext(&c->ctx);
+	return res;
+}
+
+void aesperf_close_ta(struct aesperf_ctx *c)
+{
+	TEEC_CloseSession(&c->sess);
+	TEEC_FinalizeContext(&c->ctx);
+	if (c->rnd >= 0)
+		close(c->rnd);
+	c->rnd = -1;
+}
+
+TEEC_Result aesperf_prepare_key(struct aesperf_ctx *c, TEEC_Session *s)
+{
+	uint32_t ret_origin;
+	TEEC_Operation op;
+
+	memset(&op, 0, sizeof(op));
+	op.paramTypes = TEEC_PARAM_TYPES(TEEC_VALUE_INPUT, TEEC_VALUE_INPUT,
+					 TEEC_NONE, TEEC_NONE);
+	op.params[0].value.a = c->cfg.decrypt;
+	op.params[0].value.b = c->cfg.keysize;
+	op.params[1].value.a = c->cfg.mode;
+	op.params[1].value.b = c->cfg.final;
+	return TEEC_InvokeCommand(s, TA_AES_PERF_CMD_PREPARE_KEY, &op,
+				  &ret_origin);
+}
+
+static TEEC_Result alloc_one_shm(struct aesperf_ctx *c, TEEC_SharedMemory *shm,
+				 size_t sz)
+{
+	TEEC_Result res;
+
+	shm->buffer = NULL;
+	shm->size = sz;
+	if (c->cfg.shm_type == AESPERF_SHM_REGISTERED) {
+		if (posix_memalign(&shm->buffer, sysconf(_SC_PAGESIZE),
+				   sz ? sz : 1)) {
+			shm->buffer = NULL;
+			return TEEC_ERROR_OUT_OF_MEMORY;
+		}
+		res = TEEC_RegisterSharedMemory(&c->ctx, shm);
+		if (res != TEEC_SUCCESS) {
+			free(shm->buffer);
+			shm->buffer = NULL;
+		}
+		return res;
+	}
+	return TEEC_AllocateSharedMemory(&c->ctx, shm);
+}
+
+TEEC_Result aesperf_alloc_shm(struct aesperf_ctx *c, size_t sz)
+{
+	TEEC_Result res;
+
+	res = alloc_one_shm(c, &c->in_shm, sz);
+	if (res != TEEC_SUCCESS || c->cfg.in_place)
+		return res;
+	res = alloc_one_shm(c, &c->out_shm, sz);
+	if (res != TEEC_SUCCESS) {
+		TEEC_ReleaseSharedMemory(&c->in_shm);
+		if (c->cfg.shm_type == AESPERF_SHM_REGISTERED)
+			free(c->in_shm.buffer);
+	}
+	return res;
+}
+
+void aesperf_free_shm(struct aesperf_ctx *c)
+{
+	void *in = c->in_shm.buffer;
+	void *out = c->out_shm.buffer;
+
+	TEEC_ReleaseSharedMemory(&c->in_shm);
+	TEEC_ReleaseSharedMemory(&c->out_shm);
+	if (c->cfg.shm_type == AESPERF_SHM_REGISTERED) {
+		free(in);
+		if (!c->cfg.in_place)
+			free(out);
+	}
+}
+
+int aesperf_fill_random(struct aesperf_ctx *c, void *buf, size_t len)
+{
+	ssize_t s;
+
+	if (c->rnd < 0) {
+		c->rnd = open("/dev/urandom", O_RDONLY);
+		if (c->rnd < 0) {
+			perror("open");
+			return -1;
+		}
+	}
+	s = read(c->rnd, buf, len);
+	if (s < 0) {
+		perror("read");
+		return -1;
+	}
+	if ((size_t)s != len) {
+		fprintf(stderr, "read: requested %zu bytes, got %zd\n", len,
+			s);
+		return -1;
+	}
+	return 0;
+}
+
+TEEC_Result aesperf_invoke(struct aesperf_ctx *c, TEEC_Session *s,
+			   uint32_t cmd, TEEC_Operation *op, uint64_t *ns)
+{
+	uint32_t ret_origin;
+	TEEC_Result res;
+	uint64_t t0, t1;
+
+	t0 = aesperf_timer_read(&c->timer);
+	res = TEEC_InvokeCommand(s, cmd, op, &ret_origin);
+	t1 = aesperf_timer_read(&c->timer);
+	*ns = aesperf_timer_sample_ns(&c->timer, t0, t1);
+	return res;
+}
+
+/*
+ * Measurements
+ */
+
+TEEC_Result aesperf_open(struct aesperf_ctx *c,
+			 const struct aesperf_config *cfg)
+{
+	TEEC_Result res;
+
+	if (cfg->mode > TA_AES_CMAC) {
+		fprintf(stderr, "aesperf: unsupported mode %d\n", cfg->mode);
+		return TEEC_ERROR_NOT_SUPPORTED;
+	}
+	res = aesperf_open_ta(c, cfg);
+	if (res != TEEC_SUCCESS)
+		return res;
+	if (aesperf_timer_init(&c->timer, cfg->timer) < 0) {
+		res = TEEC_ERROR_NOT_SUPPORTED;
+		goto err;
+	}
+	res = aesperf_prepare_key(c, &c->sess);
+	if (res != TEEC_SUCCESS)
+		goto err;
+	res = aesperf_setup(c, cfg->size);
+	if (res != TEEC_SUCCESS)
+		goto err;
+	return TEEC_SUCCESS;
+err:
+	aesperf_close_ta(c);
+	return res;
+}
+
+void aesperf_close(struct aesperf_ctx *c)
+{
+	aesperf_free_shm(c);
+	aesperf_close_ta(c);
+}
+
+TEEC_Result aesperf_setup(struct aesperf_ctx *c, size_t shm_size)
+{
+	TEEC_Result res;
+
+	res = aesperf_alloc_shm(c, shm_size);
+	if (res != TEEC_SUCCESS)
+		return res;
+	memset(c->in_shm.buffer, 0, shm_size);
+
+	memset(&c->op, 0, sizeof(c->op));
+	/* Using INOUT to handle the case in_place == 1 */
+	if (c->cfg.cmd == TA_AES_PERF_CMD_PROCESS_COPY)
+		c->op.paramTypes = TEEC_PARAM_TYPES(TEEC_MEMREF_PARTIAL_INOUT,
+						    TEEC_MEMREF_PARTIAL_INOUT,
+						    TEEC_VALUE_INOUT,
+						    TEEC_VALUE_OUTPUT);
+	else
+		c->op.paramTypes = TEEC_PARAM_TYPES(TEEC_MEMREF_PARTIAL_INOUT,
+						    TEEC_MEMREF_PARTIAL_INOUT,
+						    TEEC_VALUE_INPUT,
+						    TEEC_NONE);
+	c->op.params[0].memref.parent = &c->in_shm;
+	c->op.params[0].memref.size = c->cfg.size;
+	c->op.params[1].memref.parent = c->cfg.in_place ? &c->in_shm :
+							  &c->out_shm;
+	c->op.params[1].memref.size = c->cfg.size;
+	c->op.params[2].value.a = c->cfg.loops;
+	return TEEC_SUCCESS;
+}
+
+TEEC_Result aesperf_sample_prep(struct aesperf_ctx *c, size_t offset,
+				size_t size)
+{
+	if (c->cfg.random &&
+	    aesperf_fill_random(c, (uint8_t *)c->in_shm.buffer + offset,
+				size) < 0)
+		return TEEC_ERROR_GENERIC;
+	c->op.params[0].memref.offset = offset;
+	c->op.params[0].memref.size = size;
+	c->op.params[1].memref.offset = offset;
+	c->op.params[1].memref.size = size;
+	return TEEC_SUCCESS;
+}
+
+TEEC_Result aesperf_sample_invoke(struct aesperf_ctx *c, uint64_t *ns)
+{
+	return aesperf_invoke(c, &c->sess, c->cfg.cmd, &c->op, ns);
+}
+
+TEEC_Result aesperf_sample_at(struct aesperf_ctx *c, size_t offset,
+			      size_t size, uint64_t *ns)
+{
+	TEEC_Result res;
+
+	res = aesperf_sample_prep(c, offset, size);
+	if (res != TEEC_SUCCESS)
+		return res;
+	return aesperf_sample_invoke(c, ns);
+}
+
+TEEC_Result aesperf_sample(struct aesperf_ctx *c, uint64_t *ns)
+{
+	return aesperf_sample_at(c, 0, c->cfg.size, ns);
+}
+
+TEEC_Result aesperf_run(struct aesperf_ctx *c, unsigned int n,
+			struct aesperf_stats *s)
+{
+	TEEC_Result res = TEEC_SUCCESS;
+	uint64_t *samples;
+	unsigned int i;
+
+	memset(s, 0, sizeof(*s));
+	samples = malloc(n * sizeof(*samples));
+	if (!samples)
+		return TEEC_ERROR_OUT_OF_MEMORY;
+	for (i = 0; i < n; i++) {
+		res = aesperf_sample(c, &samples[i]);
+		if (res != TEEC_SUCCESS)
+			break;
+		aesperf_stats_update(s, samples[i]);
+		s->bytes += c->cfg.size;
+	}
+	if (aesperf_stats_robust(s, samples, s->n) < 0 &&
+	    res == TEEC_SUCCESS)
+		res = TEEC_ERROR_OUT_OF_MEMORY;
+	free(samples);
+	return res;
+}
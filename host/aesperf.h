@@ -0,0 +1,288 @@
+/*
+ * Copyright (c) 2015, Linaro Limited
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef AESPERF_H
+#define AESPERF_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <time.h>
+
+#include <tee_client_api.h>
+#include "ta_aes_perf.h"
+
+/*
+ * libaesperf: time the AES, digest and MAC invocations of the aes_perf TA
+ *
+ * All the state of a measurement lives in a struct aesperf_ctx allocated by
+ * the caller, so several contexts may be used in one process (one thread
+ * each). The simplest use:
+ *
+ *	struct aesperf_config cfg;
+ *	struct aesperf_ctx c;
+ *	struct aesperf_stats s;
+ *
+ *	aesperf_config_init(&cfg);
+ *	cfg.mode = TA_AES_CBC;
+ *	if (aesperf_open(&c, &cfg) == TEEC_SUCCESS) {
+ *		aesperf_run(&c, 1000, &s);
+ *		aesperf_report(stdout, &s, AESPERF_CENTER_MEAN);
+ *		aesperf_close(&c);
+ *	}
+ *
+ * The functions return TEEC results or -1 on error and print the details on
+ * stderr; they never exit.
+ */
+
+#define AESPERF_TIMER_CLOCK	0	/* clock_gettime(CLOCK_MONOTONIC) */
+#define AESPERF_TIMER_COUNTER	1	/* Architectural counter: CNTVCT, TSC */
+
+#define AESPERF_SHM_ALLOCATED	0	/* TEEC_AllocateSharedMemory() */
+#define AESPERF_SHM_REGISTERED	1	/* Application buffers, registered */
+
+#define AESPERF_TA_MULTI_INSTANCE	0
+#define AESPERF_TA_SINGLE_INSTANCE	1
+
+struct aesperf_config {
+	int mode;		/* TA_AES_ECB ... TA_AES_CMAC */
+	int keysize;		/* Bits */
+	int decrypt;
+	int final;		/* Digests/MACs: one message per inner loop */
+	size_t size;		/* Bytes per invocation */
+	unsigned int loops;	/* Inner loops in the TA */
+	int in_place;		/* Same buffer for input and output */
+	int random;		/* New input from /dev/urandom for each sample */
+	int shm_type;
+	int ta_model;
+	int timer;
+	/*
+	 * Command timed by aesperf_sample(): TA_AES_PERF_CMD_PROCESS,
+	 * TA_AES_PERF_CMD_PROCESS_COPY or TA_AES_PERF_CMD_RANDOM
+	 */
+	uint32_t cmd;
+};
+
+/*
+ * Statistics: min, max, mean and standard deviation (Welford), and the
+ * robust estimators of aesperf_stats_robust()
+ */
+struct aesperf_stats {
+	int n;
+	double m;
+	double M2;
+	double min;
+	double max;
+	int initialized;
+	double bytes;	/* Total bytes processed, for throughput */
+
+	int robust;
+	double median;
+	double mad;		/* Median absolute deviation */
+	double q1;
+	double q3;
+	double trimmed;		/* Mean of the samples between p5 and p95 */
+	int low_outliers;	/* Below Q1 - 1.5 IQR (Tukey fences) */
+	int high_outliers;	/* Above Q3 + 1.5 IQR */
+	int far_outliers;	/* Above Q3 + 3 IQR */
+};
+
+/* Latency estimators for throughput figures */
+#define AESPERF_CENTER_MEAN	0
+#define AESPERF_CENTER_MEDIAN	1
+#define AESPERF_CENTER_TRIMMED	2
+
+/*
+ * Timer: clock_gettime(), or the architectural counter read directly (no
+ * vDSO call), converted to ns with the frequency checked against
+ * CLOCK_MONOTONIC_RAW. The cost of an empty pair of reads is measured by
+ * aesperf_timer_init() and subtracted from each sample.
+ */
+struct aesperf_timer {
+	int type;
+	double hz;		/* Counter frequency */
+	double counter_ns;	/* ns per counter tick */
+	uint64_t overhead;	/* ns, median */
+	uint64_t overhead_min;
+	uint64_t overhead_max;
+};
+
+struct aesperf_ctx {
+	struct aesperf_config cfg;
+	struct aesperf_timer timer;
+	TEEC_Context ctx;
+	TEEC_Session sess;
+	/*
+	 * in_shm and out_shm are both IN/OUT to support dynamically choosing
+	 * in_place == 1 or in_place == 0.
+	 */
+	TEEC_SharedMemory in_shm;
+	TEEC_SharedMemory out_shm;
+	TEEC_Operation op;	/* Invocation of aesperf_sample() */
+	int rnd;		/* /dev/urandom, -1: not open */
+};
+
+/* Defaults: AES-ECB, 128-bit key, encryption, 1024 bytes, one inner loop */
+void aesperf_config_init(struct aesperf_config *cfg);
+
+/*
+ * Open a context: timer, TEE context and session, key, and shared buffers of
+ * cfg->size bytes
+ */
+TEEC_Result aesperf_open(struct aesperf_ctx *c,
+			 const struct aesperf_config *cfg);
+void aesperf_close(struct aesperf_ctx *c);
+/* Time one invocation of cfg.loops inner loops over cfg.size bytes */
+TEEC_Result aesperf_sample(struct aesperf_ctx *c, uint64_t *ns);
+/*
+ * Same, over size bytes at offset in the shared buffers (size at most the
+ * cfg.size of the op set up by aesperf_setup())
+ */
+TEEC_Result aesperf_sample_at(struct aesperf_ctx *c, size_t offset,
+			      size_t size, uint64_t *ns);
+/*
+ * The two halves of aesperf_sample_at(), for callers that need the input
+ * between them: point c->op at size bytes at offset and fill them if
+ * cfg.random, then time the invocation
+ */
+TEEC_Result aesperf_sample_prep(struct aesperf_ctx *c, size_t offset,
+				size_t size);
+TEEC_Result aesperf_sample_invoke(struct aesperf_ctx *c, uint64_t *ns);
+/* Take n samples into s, including the robust estimators */
+TEEC_Result aesperf_run(struct aesperf_ctx *c, unsigned int n,
+			struct aesperf_stats *s);
+/* Print the statistics of s, with throughput from the given estimator */
+void aesperf_report(FILE *f, const struct aesperf_stats *s, int center);
+
+/*
+ * Building blocks of aesperf_open() and aesperf_sample(), for callers that
+ * manage buffers and operations themselves. The configuration is read from
+ * c->cfg at each call.
+ */
+
+/* TEE context and session only; c->timer is not touched */
+TEEC_Result aesperf_open_ta(struct aesperf_ctx *c,
+			    const struct aesperf_config *cfg);
+void aesperf_close_ta(struct aesperf_ctx *c);
+/* Open another session on the TA of c->cfg.ta_model */
+TEEC_Result aesperf_open_session(struct aesperf_ctx *c, TEEC_Session *s);
+/* Set up the cipher, digest or MAC of c->cfg in the TA */
+TEEC_Result aesperf_prepare_key(struct aesperf_ctx *c, TEEC_Session *s);
+/*
+ * Shared buffers of shm_size bytes, with a zeroed input, and c->op for
+ * cfg.cmd, cfg.size and cfg.loops
+ */
+TEEC_Result aesperf_setup(struct aesperf_ctx *c, size_t shm_size);
+/* Shared buffers of sz bytes: in_shm, and out_shm unless in place */
+TEEC_Result aesperf_alloc_shm(struct aesperf_ctx *c, size_t sz);
+void aesperf_free_shm(struct aesperf_ctx *c);
+/* Fill buf from /dev/urandom. Returns 0 on success, -1 on error. */
+int aesperf_fill_random(struct aesperf_ctx *c, void *buf, size_t len);
+/* Timed TEEC_InvokeCommand() on session s */
+TEEC_Result aesperf_invoke(struct aesperf_ctx *c, TEEC_Session *s,
+			   uint32_t cmd, TEEC_Operation *op, uint64_t *ns);
+
+/* Statistics */
+
+void aesperf_stats_update(struct aesperf_stats *s, uint64_t t);
+double aesperf_stats_stddev(const struct aesperf_stats *s);
+/* Half-width of the 95% confidence interval of the mean, in % of the mean */
+double aesperf_stats_ci_pct(const struct aesperf_stats *s);
+/* Mean, or the median or trimmed mean if selected and computed */
+double aesperf_stats_center(const struct aesperf_stats *s, int center);
+/* Throughput in MiB/s: average bytes per sample over typical latency */
+double aesperf_stats_mb_per_sec(const struct aesperf_stats *s, int center);
+/*
+ * Compute the robust estimators of s from its n samples, which get sorted.
+ * Returns 0 on success, -1 on error.
+ */
+int aesperf_stats_robust(struct aesperf_stats *s, uint64_t *samples,
+			 size_t n);
+int aesperf_cmp_u64(const void *a, const void *b);
+/* p-th percentile (nearest rank) of n sorted samples */
+uint64_t aesperf_percentile(const uint64_t *sorted, size_t n, double p);
+/* q-quantile of n sorted samples, interpolated between closest ranks */
+double aesperf_quantile(const uint64_t *sorted, size_t n, double q);
+
+/* Timer */
+
+#if defined(__aarch64__) || defined(__arm__) || defined(__x86_64__) || \
+    defined(__i386__)
+#define AESPERF_HAVE_COUNTER	1
+#else
+#define AESPERF_HAVE_COUNTER	0
+#endif
+
+/* Select the backend and calibrate it. Returns 0 on success, -1 on error. */
+int aesperf_timer_init(struct aesperf_timer *t, int type);
+
+static inline uint64_t aesperf_read_counter(void)
+{
+	uint64_t v = 0;
+#if defined(__aarch64__)
+	asm volatile("isb; mrs %0, cntvct_el0" : "=r" (v) : : "memory");
+#elif defined(__arm__)
+	asm volatile("isb; mrrc p15, 1, %Q0, %R0, c14" : "=r" (v) : : "memory");
+#elif defined(__x86_64__) || defined(__i386__)
+	uint32_t lo, hi;
+
+	asm volatile("lfence; rdtsc; lfence" : "=a" (lo), "=d" (hi) : :
+		     "memory");
+	v = ((uint64_t)hi << 32) | lo;
+#endif
+	return v;
+}
+
+/* Raw timer value: ns or counter ticks */
+static inline uint64_t aesperf_timer_read(const struct aesperf_timer *t)
+{
+	struct timespec ts;
+
+	if (t->type == AESPERF_TIMER_COUNTER)
+		return aesperf_read_counter();
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+static inline uint64_t aesperf_timer_diff_ns(const struct aesperf_timer *t,
+					     uint64_t start, uint64_t end)
+{
+	if (t->type == AESPERF_TIMER_COUNTER)
+		return (end - start) * t->counter_ns + 0.5;
+	return end - start;
+}
+
+/* Measured time minus the timer overhead */
+static inline uint64_t aesperf_timer_sample_ns(const struct aesperf_timer *t,
+					       uint64_t start, uint64_t end)
+{
+	uint64_t d = aesperf_timer_diff_ns(t, start, end);
+
+	return d > t->overhead ? d - t->overhead : 0;
+}
+
+#endif /* AESPERF_H */
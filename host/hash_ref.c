@@ -0,0 +1,471 @@
+/*
+ * Copyright (c) 2015, Linaro Limited
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <string.h>
+
+#include "hash_ref.h"
+#include "ta_aes_perf.h"
+
+#define ROR32(x, n)	(((x) >> (n)) | ((x) << (32 - (n))))
+#define ROL32(x, n)	(((x) << (n)) | ((x) >> (32 - (n))))
+#define ROR64(x, n)	(((x) >> (n)) | ((x) << (64 - (n))))
+
+static const uint32_t sha256_k[64] = {
+	0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5,
+	0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+	0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3,
+	0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+	0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc,
+	0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+	0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7,
+	0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+	0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13,
+	0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+	0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3,
+	0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+	0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5,
+	0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+	0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208,
+	0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2,
+};
+
+static const uint64_t sha512_k[80] = {
+	0x428a2f98d728ae22ULL, 0x7137449123ef65cdULL,
+	0xb5c0fbcfec4d3b2fULL, 0xe9b5dba58189dbbcULL,
+	0x3956c25bf348b538ULL, 0x59f111f1b605d019ULL,
+	0x923f82a4af194f9bULL, 0xab1c5ed5da6d8118ULL,
+	0xd807aa98a3030242ULL, 0x12835b0145706fbeULL,
+	0x243185be4ee4b28cULL, 0x550c7dc3d5ffb4e2ULL,
+	0x72be5d74f27b896fULL, 0x80deb1fe3b1696b1ULL,
+	0x9bdc06a725c71235ULL, 0xc19bf174cf692694ULL,
+	0xe49b69c19ef14ad2ULL, 0xefbe4786384f25e3ULL,
+	0x0fc19dc68b8cd5b5ULL, 0x240ca1cc77ac9c65ULL,
+	0x2de92c6f592b0275ULL, 0x4a7484aa6ea6e483ULL,
+	0x5cb0a9dcbd41fbd4ULL, 0x76f988da831153b5ULL,
+	0x983e5152ee66dfabULL, 0xa831c66d2db43210ULL,
+	0xb00327c898fb213fULL, 0xbf597fc7beef0ee4ULL,
+	0xc6e00bf33da88fc2ULL, 0xd5a79147930aa725ULL,
+	0x06ca6351e003826fULL, 0x142929670a0e6e70ULL,
+	0x27b70a8546d22ffcULL, 0x2e1b21385c26c926ULL,
+	0x4d2c6dfc5ac42aedULL, 0x53380d139d95b3dfULL,
+	0x650a73548baf63deULL, 0x766a0abb3c77b2a8ULL,
+	0x81c2c92e47edaee6ULL, 0x92722c851482353bULL,
+	0xa2bfe8a14cf10364ULL, 0xa81a664bbc423001ULL,
+	0xc24b8b70d0f89791ULL, 0xc76c51a30654be30ULL,
+	0xd192e819d6ef5218ULL, 0xd69906245565a910ULL,
+	0xf40e35855771202aULL, 0x106aa07032bbd1b8ULL,
+	0x19a4c116b8d2d0c8ULL, 0x1e376c085141ab53ULL,
+	0x2748774cdf8eeb99ULL, 0x34b0bcb5e19b48a8ULL,
+	0x391c0cb3c5c95a63ULL, 0x4ed8aa4ae3418acbULL,
+	0x5b9cca4f7763e373ULL, 0x682e6ff3d6b2b8a3ULL,
+	0x748f82ee5defb2fcULL, 0x78a5636f43172f60ULL,
+	0x84c87814a1f0ab72ULL, 0x8cc702081a6439ecULL,
+	0x90befffa23631e28ULL, 0xa4506cebde82bde9ULL,
+	0xbef9a3f7b2c67915ULL, 0xc67178f2e372532bULL,
+	0xca273eceea26619cULL, 0xd186b8c721c0c207ULL,
+	0xeada7dd6cde0eb1eULL, 0xf57d4f7fee6ed178ULL,
+	0x06f067aa72176fbaULL, 0x0a637dc5a2c898a6ULL,
+	0x113f9804bef90daeULL, 0x1b710b35131c471bULL,
+	0x28db77f523047d84ULL, 0x32caab7b40c72493ULL,
+	0x3c9ebe0a15c9bebcULL, 0x431d67c49c100d4cULL,
+	0x4cc5d4becb3e42b6ULL, 0x597f299cfc657e2aULL,
+	0x5fcb6fab3ad6faecULL, 0x6c44198c4a475817ULL,
+};
+
+static uint32_t get_be32(const uint8_t *p)
+{
+	return (uint32_t)p[0] << 24 | (uint32_t)p[1] << 16 |
+	       (uint32_t)p[2] << 8 | p[3];
+}
+
+static uint64_t get_be64(const uint8_t *p)
+{
+	return (uint64_t)get_be32(p) << 32 | get_be32(p + 4);
+}
+
+static void put_be32(uint8_t *p, uint32_t v)
+{
+	p[0] = v >> 24;
+	p[1] = v >> 16;
+	p[2] = v >> 8;
+	p[3] = v;
+}
+
+static void put_be64(uint8_t *p, uint64_t v)
+{
+	put_be32(p, v >> 32);
+	put_be32(p + 4, v);
+}
+
+static void sha1_block(uint32_t *h, const uint8_t *p)
+{
+	uint32_t w[80];
+	uint32_t a, b, c, d, e, f, k, t;
+	int i;
+
+	for (i = 0; i < 16; i++)
+		w[i] = get_be32(p + 4 * i);
+	for (i = 16; i < 80; i++)
+		w[i] = ROL32(w[i - 3] ^ w[i - 8] ^ w[i - 14] ^ w[i - 16], 1);
+
+	a = h[0];
+	b = h[1];
+	c = h[2];
+	d = h[3];
+	e = h[4];
+	for (i = 0; i < 80; i++) {
+		if (i < 20) {
+			f = (b & c) | (~b & d);
+			k = 0x5a827999;
+		} else if (i < 40) {
+			f = b ^ c ^ d;
+			k = 0x6ed9eba1;
+		} else if (i < 60) {
+			f = (b & c) | (b & d) | (c & d);
+			k = 0x8f1bbcdc;
+		} else {
+			f = b ^ c ^ d;
+			k = 0xca62c1d6;
+		}
+		t = ROL32(a, 5) + f + e + k + w[i];
+		e = d;
+		d = c;
+		c = ROL32(b, 30);
+		b = a;
+		a = t;
+	}
+	h[0] += a;
+	h[1] += b;
+	h[2] += c;
+	h[3] += d;
+	h[4] += e;
+}
+
+static void sha256_block(uint32_t *h, const uint8_t *p)
+{
+	uint32_t w[64];
+	uint32_t s[8];
+	uint32_t t1, t2;
+	int i;
+
+	for (i = 0; i < 16; i++)
+		w[i] = get_be32(p + 4 * i);
+	for (i = 16; i < 64; i++)
+		w[i] = w[i - 16] + w[i - 7] +
+		       (ROR32(w[i - 15], 7) ^ ROR32(w[i - 15], 18) ^
+			(w[i - 15] >> 3)) +
+		       (ROR32(w[i - 2], 17) ^ ROR32(w[i - 2], 19) ^
+			(w[i - 2] >> 10));
+
+	memcpy(s, h, sizeof(s));
+	for (i = 0; i < 64; i++) {
+		t1 = s[7] + (ROR32(s[4], 6) ^ ROR32(s[4], 11) ^
+			     ROR32(s[4], 25)) +
+		     ((s[4] & s[5]) ^ (~s[4] & s[6])) + sha256_k[i] + w[i];
+		t2 = (ROR32(s[0], 2) ^ ROR32(s[0], 13) ^ ROR32(s[0], 22)) +
+		     ((s[0] & s[1]) ^ (s[0] & s[2]) ^ (s[1] & s[2]));
+		memmove(s + 1, s, 7 * sizeof(s[0]));
+		s[4] += t1;
+		s[0] = t1 + t2;
+	}
+	for (i = 0; i < 8; i++)
+		h[i] += s[i];
+}
+
+static void sha512_block(uint64_t *h, const uint8_t *p)
+{
+	uint64_t w[80];
+	uint64_t s[8];
+	uint64_t t1, t2;
+	int i;
+
+	for (i = 0; i < 16; i++)
+		w[i] = get_be64(p + 8 * i);
+	for (i = 16; i < 80; i++)
+		w[i] = w[i - 16] + w[i - 7] +
+		       (ROR64(w[i - 15], 1) ^ ROR64(w[i - 15], 8) ^
+			(w[i - 15] >> 7)) +
+		       (ROR64(w[i - 2], 19) ^ ROR64(w[i - 2], 61) ^
+			(w[i - 2] >> 6));
+
+	memcpy(s, h, sizeof(s));
+	for (i = 0; i < 80; i++) {
+		t1 = s[7] + (ROR64(s[4], 14) ^ ROR64(s[4], 18) ^
+			     ROR64(s[4], 41)) +
+		     ((s[4] & s[5]) ^ (~s[4] & s[6])) + sha512_k[i] + w[i];
+		t2 = (ROR64(s[0], 28) ^ ROR64(s[0], 34) ^ ROR64(s[0], 39)) +
+		     ((s[0] & s[1]) ^ (s[0] & s[2]) ^ (s[1] & s[2]));
+		memmove(s + 1, s, 7 * sizeof(s[0]));
+		s[4] += t1;
+		s[0] = t1 + t2;
+	}
+	for (i = 0; i < 8; i++)
+		h[i] += s[i];
+}
+
+static void hash_block(struct hash_ref_ctx *ctx, const uint8_t *p)
+{
+	switch (ctx->algo) {
+	case TA_SHA1:
+		sha1_block(ctx->h.h32, p);
+		break;
+	case TA_SHA256:
+		sha256_block(ctx->h.h32, p);
+		break;
+	default:
+		sha512_block(ctx->h.h64, p);
+		break;
+	}
+}
+
+size_t hash_ref_size(int algo)
+{
+	switch (algo) {
+	case TA_SHA1:
+		return 20;
+	case TA_SHA256:
+		return 32;
+	case TA_SHA512:
+		return 64;
+	default:
+		return 0;
+	}
+}
+
+size_t hash_ref_block_size(int algo)
+{
+	switch (algo) {
+	case TA_SHA1:
+	case TA_SHA256:
+		return 64;
+	case TA_SHA512:
+		return 128;
+	default:
+		return 0;
+	}
+}
+
+int hash_ref_init(struct hash_ref_ctx *ctx, int algo)
+{
+	static const uint32_t sha1_h0[5] = {
+		0x67452301, 0xefcdab89, 0x98badcfe, 0x10325476, 0xc3d2e1f0
+	};
+	static const uint32_t sha256_h0[8] = {
+		0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a,
+		0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19
+	};
+	static const uint64_t sha512_h0[8] = {
+		0x6a09e667f3bcc908ULL, 0xbb67ae8584caa73bULL,
+		0x3c6ef372fe94f82bULL, 0xa54ff53a5f1d36f1ULL,
+		0x510e527fade682d1ULL, 0x9b05688c2b3e6c1fULL,
+		0x1f83d9abfb41bd6bULL, 0x5be0cd19137e2179ULL
+	};
+
+	memset(ctx, 0, sizeof(*ctx));
+	ctx->algo = algo;
+	switch (algo) {
+	case TA_SHA1:
+		memcpy(ctx->h.h32, sha1_h0, sizeof(sha1_h0));
+		break;
+	case TA_SHA256:
+		memcpy(ctx->h.h32, sha256_h0, sizeof(sha256_h0));
+		break;
+	case TA_SHA512:
+		memcpy(ctx->h.h64, sha512_h0, sizeof(sha512_h0));
+		break;
+	default:
+		return -1;
+	}
+	return 0;
+}
+
+void hash_ref_update(struct hash_ref_ctx *ctx, const void *data, size_t len)
+{
+	const uint8_t *p = data;
+	size_t bs = hash_ref_block_size(ctx->algo);
+	size_t n;
+
+	ctx->len += len;
+	while (len) {
+		n = bs - ctx->buf_len;
+		if (n > len)
+			n = len;
+		memcpy(ctx->buf + ctx->buf_len, p, n);
+		ctx->buf_len += n;
+		p += n;
+		len -= n;
+		if (ctx->buf_len == bs) {
+			hash_block(ctx, ctx->buf);
+			ctx->buf_len = 0;
+		}
+	}
+}
+
+void hash_ref_final(struct hash_ref_ctx *ctx, uint8_t *out)
+{
+	size_t bs = hash_ref_block_size(ctx->algo);
+	size_t lenlen = bs / 8;		/* 8 or 16 bytes of length */
+	uint64_t bits = ctx->len * 8;
+	size_t i;
+
+	ctx->buf[ctx->buf_len++] = 0x80;
+	if (ctx->buf_len > bs - lenlen) {
+		memset(ctx->buf + ctx->buf_len, 0, bs - ctx->buf_len);
+		hash_block(ctx, ctx->buf);
+		ctx->buf_len = 0;
+	}
+	memset(ctx->buf + ctx->buf_len, 0, bs - ctx->buf_len);
+	put_be64(ctx->buf + bs - 8, bits);
+	hash_block(ctx, ctx->buf);
+
+	if (ctx->algo == TA_SHA512) {
+		for (i = 0; i < 8; i++)
+			put_be64(out + 8 * i, ctx->h.h64[i]);
+	} else {
+		for (i = 0; i < hash_ref_size(ctx->algo) / 4; i++)
+			put_be32(out + 4 * i, ctx->h.h32[i]);
+	}
+	hash_ref_init(ctx, ctx->algo);
+}
+
+int hmac_ref_init(struct hmac_ref_ctx *ctx, int algo, const uint8_t *key,
+		  size_t keylen)
+{
+	uint8_t k[HASH_REF_MAX_BLOCK];
+	size_t bs = hash_ref_block_size(algo);
+	size_t i;
+
+	if (hash_ref_init(&ctx->inner, algo))
+		return -1;
+	memset(k, 0, sizeof(k));
+	if (keylen > bs) {
+		hash_ref_update(&ctx->inner, key, keylen);
+		hash_ref_final(&ctx->inner, k);
+	} else {
+		memcpy(k, key, keylen);
+	}
+
+	for (i = 0; i < bs; i++)
+		k[i] ^= 0x36;
+	hash_ref_update(&ctx->inner, k, bs);
+	ctx->inner0 = ctx->inner;
+
+	hash_ref_init(&ctx->outer, algo);
+	for (i = 0; i < bs; i++)
+		k[i] ^= 0x36 ^ 0x5c;
+	hash_ref_update(&ctx->outer, k, bs);
+	return 0;
+}
+
+void hmac_ref_update(struct hmac_ref_ctx *ctx, const void *data, size_t len)
+{
+	hash_ref_update(&ctx->inner, data, len);
+}
+
+void hmac_ref_final(struct hmac_ref_ctx *ctx, uint8_t *out)
+{
+	struct hash_ref_ctx outer = ctx->outer;
+	uint8_t md[HASH_REF_MAX_SIZE];
+
+	hash_ref_final(&ctx->inner, md);
+	hash_ref_update(&outer, md, hash_ref_size(ctx->inner.algo));
+	hash_ref_final(&outer, out);
+	ctx->inner = ctx->inner0;
+}
+
+/* Multiply by x in GF(2^128) (big-endian), for the CMAC subkeys */
+static void cmac_dbl(uint8_t *out, const uint8_t *in)
+{
+	uint8_t carry = in[0] >> 7;
+	int i;
+
+	for (i = 0; i < AES_BLOCK_SIZE - 1; i++)
+		out[i] = (in[i] << 1) | (in[i + 1] >> 7);
+	out[AES_BLOCK_SIZE - 1] = (in[AES_BLOCK_SIZE - 1] << 1) ^
+				  (carry ? 0x87 : 0);
+}
+
+void cmac_ref_init(struct cmac_ref_ctx *ctx, const uint8_t *key,
+		   size_t keylen)
+{
+	uint8_t l[AES_BLOCK_SIZE] = { 0 };
+
+	memset(ctx, 0, sizeof(*ctx));
+	aes_ref_set_key(&ctx->key, key, keylen);
+	aes_ref_encrypt_block(&ctx->key, l, l);
+	cmac_dbl(ctx->k1, l);
+	cmac_dbl(ctx->k2, ctx->k1);
+}
+
+static void cmac_block(struct cmac_ref_ctx *ctx, const uint8_t *p)
+{
+	int i;
+
+	for (i = 0; i < AES_BLOCK_SIZE; i++)
+		ctx->x[i] ^= p[i];
+	aes_ref_encrypt_block(&ctx->key, ctx->x, ctx->x);
+}
+
+void cmac_ref_update(struct cmac_ref_ctx *ctx, const void *data, size_t len)
+{
+	const uint8_t *p = data;
+	size_t n;
+
+	/* The last block is kept until final, as it is processed differently */
+	while (len) {
+		if (ctx->buf_len == AES_BLOCK_SIZE) {
+			cmac_block(ctx, ctx->buf);
+			ctx->buf_len = 0;
+		}
+		n = AES_BLOCK_SIZE - ctx->buf_len;
+		if (n > len)
+			n = len;
+		memcpy(ctx->buf + ctx->buf_len, p, n);
+		ctx->buf_len += n;
+		p += n;
+		len -= n;
+	}
+}
+
+void cmac_ref_final(struct cmac_ref_ctx *ctx, uint8_t *out)
+{
+	const uint8_t *k = ctx->k1;
+	int i;
+
+	if (ctx->buf_len < AES_BLOCK_SIZE) {
+		ctx->buf[ctx->buf_len] = 0x80;
+		memset(ctx->buf + ctx->buf_len + 1, 0,
+		       AES_BLOCK_SIZE - ctx->buf_len - 1);
+		k = ctx->k2;
+	}
+	for (i = 0; i < AES_BLOCK_SIZE; i++)
+		ctx->buf[i] ^= k[i];
+	cmac_block(ctx, ctx->buf);
+	memcpy(out, ctx->x, AES_BLOCK_SIZE);
+	memset(ctx->x, 0, AES_BLOCK_SIZE);
+	ctx->buf_len = 0;
+}
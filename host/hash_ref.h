@@ -0,0 +1,92 @@
+/*
+ * Copyright (c) 2015, Linaro Limited
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef HASH_REF_H
+#define HASH_REF_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "aes_ref.h"
+
+/*
+ * Reference SHA-1, SHA-256, SHA-512 (FIPS 180-4), HMAC (RFC 2104) and
+ * AES-CMAC (NIST SP 800-38B), used to check the output of the TA and by the
+ * emulated TEE. Like aes_ref.c, this is not meant to be fast.
+ */
+
+#define HASH_REF_MAX_SIZE	64	/* Largest digest (SHA-512) */
+#define HASH_REF_MAX_BLOCK	128	/* Largest block (SHA-512) */
+
+struct hash_ref_ctx {
+	int algo;			/* TA_SHA1, TA_SHA256 or TA_SHA512 */
+	union {
+		uint32_t h32[8];
+		uint64_t h64[8];
+	} h;
+	uint8_t buf[HASH_REF_MAX_BLOCK];
+	size_t buf_len;
+	uint64_t len;			/* Bytes hashed so far */
+};
+
+struct hmac_ref_ctx {
+	struct hash_ref_ctx inner;
+	struct hash_ref_ctx outer;
+	struct hash_ref_ctx inner0;	/* State after the inner padded key */
+};
+
+struct cmac_ref_ctx {
+	struct aes_ref_key key;
+	uint8_t k1[AES_BLOCK_SIZE];
+	uint8_t k2[AES_BLOCK_SIZE];
+	uint8_t x[AES_BLOCK_SIZE];	/* CBC-MAC chaining value */
+	uint8_t buf[AES_BLOCK_SIZE];	/* Last, possibly partial, block */
+	size_t buf_len;
+};
+
+/* Digest and block sizes in bytes, 0 if algo is not supported */
+size_t hash_ref_size(int algo);
+size_t hash_ref_block_size(int algo);
+
+/* hash_ref_final() writes hash_ref_size() bytes and resets the context */
+int hash_ref_init(struct hash_ref_ctx *ctx, int algo);
+void hash_ref_update(struct hash_ref_ctx *ctx, const void *data, size_t len);
+void hash_ref_final(struct hash_ref_ctx *ctx, uint8_t *out);
+
+/* HMAC with any of the above; hmac_ref_final() resets the context */
+int hmac_ref_init(struct hmac_ref_ctx *ctx, int algo, const uint8_t *key,
+		  size_t keylen);
+void hmac_ref_update(struct hmac_ref_ctx *ctx, const void *data, size_t len);
+void hmac_ref_final(struct hmac_ref_ctx *ctx, uint8_t *out);
+
+/* AES-CMAC, keylen in bytes; cmac_ref_final() resets the context */
+void cmac_ref_init(struct cmac_ref_ctx *ctx, const uint8_t *key,
+		   size_t keylen);
+void cmac_ref_update(struct cmac_ref_ctx *ctx, const void *data, size_t len);
+void cmac_ref_final(struct cmac_ref_ctx *ctx, uint8_t *out);
+
+#endif /* HASH_REF_H */
@@ -0,0 +1,411 @@
+/*
+ * Copyright (c) 2015, Linaro Limited
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <ctype.h>
+#include <fcntl.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/resource.h>
+#include <unistd.h>
+
+#include "aesperf.h"
+#include "outliers.h"
+
+/* Fields of /proc/self/sched */
+static const char *sched_fields[] = {
+	"nr_switches", "nr_voluntary_switches", "nr_involuntary_switches",
+	"se.nr_migrations",
+};
+
+#define NUM_SCHED_FIELDS (sizeof(sched_fields) / sizeof(sched_fields[0]))
+
+static void *xrealloc(void *p, size_t sz)
+{
+	p = realloc(p, sz);
+	if (!p) {
+		perror("realloc");
+		exit(1);
+	}
+	return p;
+}
+
+/*
+ * Store counter "name". The counters are discovered by the first snapshot,
+ * later ones are looked up by name, starting at the position following the
+ * previous counter since the order of the files does not change often. New
+ * counters (hotplugged IRQ lines) are ignored.
+ */
+static void set_counter(struct outliers *o, uint64_t *vals, size_t *k,
+			const char *name, uint64_t v, int discover)
+{
+	size_t i;
+
+	if (discover) {
+		if (o->num_counters == o->max_counters) {
+			o->max_counters = o->max_counters * 2 + 64;
+			o->names = xrealloc(o->names, o->max_counters *
+						      sizeof(*o->names));
+			o->prev = xrealloc(o->prev, o->max_counters *
+						    sizeof(*o->prev));
+		}
+		snprintf(o->names[o->num_counters], OUTLIERS_NAME_LEN, "%s",
+			 name);
+		vals = o->prev;
+		vals[o->num_counters++] = v;
+		return;
+	}
+	if (*k < o->num_counters && !strcmp(o->names[*k], name)) {
+		vals[(*k)++] = v;
+		return;
+	}
+	for (i = 0; i < o->num_counters; i++) {
+		if (!strcmp(o->names[i], name)) {
+			vals[i] = v;
+			*k = i + 1;
+			return;
+		}
+	}
+}
+
+/* Read a /proc file from the start into o->buf */
+static char *read_proc(struct outliers *o, int fd)
+{
+	size_t len = 0;
+	ssize_t r;
+
+	while ((r = pread(fd, o->buf + len, o->buf_size - len - 1, len)) > 0) {
+		len += r;
+		if (len == o->buf_size - 1) {
+			o->buf_size *= 2;
+			o->buf = xrealloc(o->buf, o->buf_size);
+		}
+	}
+	if (r < 0)
+		return NULL;
+	o->buf[len] = '\0';
+	return o->buf;
+}
+
+/* Trim leading blanks and collapse the others into single spaces */
+static void collapse(char *s)
+{
+	char *d = s;
+
+	while (isspace((unsigned char)*s))
+		s++;
+	while (*s) {
+		if (isspace((unsigned char)*s)) {
+			while (isspace((unsigned char)*s))
+				s++;
+			if (*s)
+				*d++ = ' ';
+		} else {
+			*d++ = *s++;
+		}
+	}
+	*d = '\0';
+}
+
+/*
+ * /proc/interrupts and /proc/softirqs: a header of CPU columns, then one line
+ * per counter, "label: count... [description]"
+ */
+static void parse_percpu(struct outliers *o, int fd, const char *prefix,
+			 uint64_t *vals, int discover)
+{
+	char name[OUTLIERS_NAME_LEN];
+	char *p, *line, *next, *end, *desc;
+	unsigned long long v;
+	uint64_t sum;
+	size_t k = 0;
+	int ncols = 0;
+	int col = -1;
+	int i;
+
+	p = read_proc(o, fd);
+	if (!p)
+		return;
+	next = strchr(p, '\n');
+	if (!next)
+		return;
+	*next++ = '\0';
+	for (p = strstr(p, "CPU"); p; p = strstr(p + 3, "CPU")) {
+		if (atoi(p + 3) == o->cpu)
+			col = ncols;
+		ncols++;
+	}
+	if (o->cpu >= 0 && col < 0)
+		return;
+
+	for (line = next; line && *line; line = next) {
+		next = strchr(line, '\n');
+		if (next)
+			*next++ = '\0';
+		p = strchr(line, ':');
+		if (!p)
+			continue;
+		*p++ = '\0';
+		sum = 0;
+		for (i = 0; i < ncols; i++) {
+			v = strtoull(p, &end, 10);
+			if (end == p)
+				break;
+			if (col < 0 || i == col)
+				sum += v;
+			p = end;
+		}
+		collapse(line);
+		desc = p;
+		collapse(desc);
+		/* Numbered IRQs: only keep the device name */
+		if (isdigit((unsigned char)*line) && strrchr(desc, ' '))
+			desc = strrchr(desc, ' ') + 1;
+		snprintf(name, sizeof(name), "%s %s%s%s", prefix, line,
+			 *desc ? ": " : "", desc);
+		set_counter(o, vals, &k, name, sum, discover);
+	}
+}
+
+static void parse_sched(struct outliers *o, uint64_t *vals, int discover)
+{
+	char name[OUTLIERS_NAME_LEN];
+	char *p, *line, *next;
+	size_t k = 0;
+	size_t i;
+
+	p = read_proc(o, o->sched_fd);
+	if (!p)
+		return;
+	for (line = p; line && *line; line = next) {
+		next = strchr(line, '\n');
+		if (next)
+			*next++ = '\0';
+		p = strchr(line, ':');
+		if (!p)
+			continue;
+		*p++ = '\0';
+		collapse(line);
+		for (i = 0; i < NUM_SCHED_FIELDS; i++) {
+			if (strcmp(line, sched_fields[i]))
+				continue;
+			snprintf(name, sizeof(name), "sched %s", line);
+			set_counter(o, vals, &k, name, strtoull(p, NULL, 10),
+				    discover);
+		}
+	}
+}
+
+static void parse_rusage(struct outliers *o, uint64_t *vals, int discover)
+{
+	struct rusage ru;
+	size_t k = 0;
+
+	if (getrusage(RUSAGE_THREAD, &ru) < 0)
+		return;
+	set_counter(o, vals, &k, "rusage voluntary ctxsw", ru.ru_nvcsw,
+		    discover);
+	set_counter(o, vals, &k, "rusage involuntary ctxsw", ru.ru_nivcsw,
+		    discover);
+	set_counter(o, vals, &k, "rusage minor faults", ru.ru_minflt,
+		    discover);
+	set_counter(o, vals, &k, "rusage major faults", ru.ru_majflt,
+		    discover);
+}
+
+static void snapshot(struct outliers *o, uint64_t *vals, int discover)
+{
+	if (!discover)
+		memset(vals, 0, o->num_counters * sizeof(*vals));
+	if (o->irq_fd >= 0)
+		parse_percpu(o, o->irq_fd, "irq", vals, discover);
+	if (o->softirq_fd >= 0)
+		parse_percpu(o, o->softirq_fd, "softirq", vals, discover);
+	if (o->sched_fd >= 0)
+		parse_sched(o, vals, discover);
+	parse_rusage(o, vals, discover);
+}
+
+int outliers_init(struct outliers *o, size_t max_samples, int cpu)
+{
+	memset(o, 0, sizeof(*o));
+	o->cpu = cpu;
+	o->irq_fd = open("/proc/interrupts", O_RDONLY);
+	o->softirq_fd = open("/proc/softirqs", O_RDONLY);
+	o->sched_fd = open("/proc/self/sched", O_RDONLY);
+	o->buf_size = 64 * 1024;
+	o->buf = malloc(o->buf_size);
+	if (!o->buf) {
+		perror("malloc");
+		outliers_free(o);
+		return -1;
+	}
+
+	snapshot(o, NULL, 1);
+	o->cur = malloc(o->num_counters * sizeof(*o->cur));
+	o->lat = malloc(max_samples * sizeof(*o->lat));
+	o->deltas = malloc(max_samples * o->num_counters *
+			   sizeof(*o->deltas));
+	if (!o->cur || !o->lat || !o->deltas) {
+		perror("malloc");
+		outliers_free(o);
+		return -1;
+	}
+	o->max_samples = max_samples;
+	return 0;
+}
+
+void outliers_record(struct outliers *o, uint64_t lat)
+{
+	uint32_t *d;
+	uint64_t *tmp;
+	uint64_t v;
+	size_t i;
+
+	if (o->num_samples == o->max_samples)
+		return;
+	snapshot(o, o->cur, 0);
+	d = o->deltas + o->num_samples * o->num_counters;
+	for (i = 0; i < o->num_counters; i++) {
+		v = o->cur[i] > o->prev[i] ? o->cur[i] - o->prev[i] : 0;
+		d[i] = v > UINT32_MAX ? UINT32_MAX : v;
+	}
+	o->lat[o->num_samples++] = lat;
+	tmp = o->prev;
+	o->prev = o->cur;
+	o->cur = tmp;
+}
+
+struct counter_hits {
+	size_t idx;
+	size_t tail;		/* Tail samples in which the counter moved */
+	size_t other;		/* Same for the other samples */
+	uint64_t events;	/* Increments during the tail samples */
+	double lift;		/* Difference of the two rates */
+};
+
+static int cmp_lift(const void *a, const void *b)
+{
+	const struct counter_hits *x = a;
+	const struct counter_hits *y = b;
+
+	return (x->lift < y->lift) - (x->lift > y->lift);
+}
+
+#define MAX_REPORTED	20
+
+void outliers_report(struct outliers *o, double pct)
+{
+	struct counter_hits *h;
+	uint64_t *sorted;
+	uint64_t thr;
+	uint32_t *d;
+	size_t n = o->num_samples;
+	size_t ntail = 0;
+	size_t quiet = 0;
+	size_t rank;
+	size_t i, j;
+	int any;
+
+	if (!n)
+		return;
+	sorted = malloc(n * sizeof(*sorted));
+	h = calloc(o->num_counters, sizeof(*h));
+	if (!sorted || !h) {
+		perror("malloc");
+		exit(1);
+	}
+	memcpy(sorted, o->lat, n * sizeof(*sorted));
+	qsort(sorted, n, sizeof(*sorted), aesperf_cmp_u64);
+	/* Nearest rank */
+	rank = ceil(pct / 100 * n);
+	thr = sorted[rank ? rank - 1 : 0];
+
+	for (j = 0; j < o->num_counters; j++)
+		h[j].idx = j;
+	for (i = 0; i < n; i++) {
+		d = o->deltas + i * o->num_counters;
+		any = 0;
+		for (j = 0; j < o->num_counters; j++) {
+			if (!d[j])
+				continue;
+			any = 1;
+			if (o->lat[i] > thr) {
+				h[j].tail++;
+				h[j].events += d[j];
+			} else {
+				h[j].other++;
+			}
+		}
+		if (o->lat[i] > thr) {
+			ntail++;
+			quiet += !any;
+		}
+	}
+
+	printf("Outliers: %zu samples above p%g (%gμs), max %gμs\n", ntail,
+	       pct, (double)thr / 1000, (double)sorted[n - 1] / 1000);
+	if (!ntail)
+		goto out;
+	printf("Tail samples without any counted event: %zu\n", quiet);
+	for (j = 0; j < o->num_counters; j++)
+		h[j].lift = (double)h[j].tail / ntail -
+			    (n > ntail ? (double)h[j].other / (n - ntail) : 0);
+	qsort(h, o->num_counters, sizeof(*h), cmp_lift);
+	printf("%-*s %8s %8s %12s\n", OUTLIERS_NAME_LEN, "counter", "tail%",
+	       "other%", "events/tail");
+	for (j = 0; j < o->num_counters && j < MAX_REPORTED; j++) {
+		if (!h[j].tail)
+			break;
+		printf("%-*s %8.1f %8.1f %12.2f\n", OUTLIERS_NAME_LEN,
+		       o->names[h[j].idx], 100.0 * h[j].tail / ntail,
+		       n > ntail ? 100.0 * h[j].other / (n - ntail) : 0,
+		       (double)h[j].events / ntail);
+	}
+out:
+	free(sorted);
+	free(h);
+}
+
+void outliers_free(struct outliers *o)
+{
+	if (o->irq_fd >= 0)
+		close(o->irq_fd);
+	if (o->softirq_fd >= 0)
+		close(o->softirq_fd);
+	if (o->sched_fd >= 0)
+		close(o->sched_fd);
+	free(o->buf);
+	free(o->names);
+	free(o->prev);
+	free(o->cur);
+	free(o->lat);
+	free(o->deltas);
+	memset(o, 0, sizeof(*o));
+	o->irq_fd = o->softirq_fd = o->sched_fd = -1;
+}
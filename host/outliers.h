@@ -0,0 +1,77 @@
+/*
+ * Copyright (c) 2015, Linaro Limited
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef OUTLIERS_H
+#define OUTLIERS_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * Outlier attribution: snapshot the interrupt, softirq and scheduler counters
+ * of the system after each timed sample (outside the timed region) and keep
+ * the increments seen by each sample. The report compares how often each
+ * counter moved during the samples above a latency percentile and during the
+ * other samples.
+ *
+ * Counters: /proc/interrupts and /proc/softirqs (one CPU, or all CPUs if cpu
+ * is -1), /proc/self/sched (CONFIG_SCHED_DEBUG) and getrusage(RUSAGE_THREAD).
+ * Missing sources are skipped.
+ */
+
+#define OUTLIERS_NAME_LEN	40
+
+struct outliers {
+	int cpu;
+	int irq_fd;
+	int softirq_fd;
+	int sched_fd;
+	char *buf;		/* Contents of the /proc file being parsed */
+	size_t buf_size;
+	size_t num_counters;
+	size_t max_counters;
+	char (*names)[OUTLIERS_NAME_LEN];
+	uint64_t *prev;		/* Last snapshot */
+	uint64_t *cur;
+	size_t max_samples;
+	size_t num_samples;
+	uint64_t *lat;		/* Latency of each sample */
+	uint32_t *deltas;	/* num_counters increments per sample */
+};
+
+/*
+ * Take the first snapshot. Call right before the first timed sample. Returns
+ * 0 on success, -1 on error.
+ */
+int outliers_init(struct outliers *o, size_t max_samples, int cpu);
+/* Take a snapshot and record the increments since the previous one */
+void outliers_record(struct outliers *o, uint64_t lat);
+/* Print the counters that moved during the samples above percentile pct */
+void outliers_report(struct outliers *o, double pct);
+void outliers_free(struct outliers *o);
+
+#endif /* OUTLIERS_H */
@@ -0,0 +1,323 @@
+/*
+ * Copyright (c) 2015, Linaro Limited
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <math.h>
+#include <stdio.h>
+
+#include "plot.h"
+
+#define WIDTH		800
+#define HEIGHT		480
+#define LEFT		80
+#define RIGHT		240	/* Legend */
+#define TOP		40
+#define BOTTOM		60
+#define PW		(WIDTH - LEFT - RIGHT)
+#define PH		(HEIGHT - TOP - BOTTOM)
+
+static const char *palette[] = {
+	"#1f77b4", "#ff7f0e", "#2ca02c", "#d62728",
+	"#9467bd", "#8c564b", "#e377c2", "#17becf",
+};
+
+#define NUM_COLORS	(sizeof(palette) / sizeof(palette[0]))
+
+struct axis {
+	int scale;
+	double min;
+	double max;
+};
+
+static void print_escaped(FILE *f, const char *s)
+{
+	for (; *s; s++) {
+		if (*s == '&')
+			fputs("&amp;", f);
+		else if (*s == '<')
+			fputs("&lt;", f);
+		else if (*s == '>')
+			fputs("&gt;", f);
+		else
+			fputc(*s, f);
+	}
+}
+
+/* Position of v on the axis, from 0 to 1 */
+static double axis_pos(const struct axis *a, double v)
+{
+	if (a->scale != PLOT_LINEAR)
+		return (log(v) - log(a->min)) / (log(a->max) - log(a->min));
+	return (v - a->min) / (a->max - a->min);
+}
+
+static double px(const struct axis *a, double v)
+{
+	return LEFT + PW * axis_pos(a, v);
+}
+
+static double py(const struct axis *a, double v)
+{
+	return TOP + PH * (1 - axis_pos(a, v));
+}
+
+/* Round step up to 1, 2 or 5 x 10^k */
+static double nice_step(double step)
+{
+	double e = pow(10, floor(log10(step)));
+	double f = step / e;
+
+	if (f <= 1)
+		return e;
+	if (f <= 2)
+		return 2 * e;
+	if (f <= 5)
+		return 5 * e;
+	return 10 * e;
+}
+
+static void format_tick(char *buf, size_t len, int scale, double v)
+{
+	static const char *suffix[] = { "", "K", "M", "G", "T" };
+	int i = 0;
+
+	if (scale == PLOT_LOG2) {
+		while (v >= 1024 && i < 4) {
+			v /= 1024;
+			i++;
+		}
+	}
+	snprintf(buf, len, "%g%s", v, suffix[i]);
+}
+
+static void tick(FILE *f, const struct axis *x, const struct axis *y,
+		 int vertical, double v)
+{
+	char buf[32];
+
+	format_tick(buf, sizeof(buf), vertical ? x->scale : y->scale, v);
+	if (vertical) {
+		fprintf(f, "<line x1=\"%.1f\" y1=\"%d\" x2=\"%.1f\" y2=\"%d\" "
+			"class=\"grid\"/>\n", px(x, v), TOP, px(x, v),
+			TOP + PH);
+		fprintf(f, "<text x=\"%.1f\" y=\"%d\" "
+			"text-anchor=\"middle\">%s</text>\n", px(x, v),
+			TOP + PH + 18, buf);
+	} else {
+		fprintf(f, "<line x1=\"%d\" y1=\"%.1f\" x2=\"%d\" y2=\"%.1f\" "
+			"class=\"grid\"/>\n", LEFT, py(y, v), LEFT + PW,
+			py(y, v));
+		fprintf(f, "<text x=\"%d\" y=\"%.1f\" text-anchor=\"end\">"
+			"%s</text>\n", LEFT - 6, py(y, v) + 4, buf);
+	}
+}
+
+static void ticks(FILE *f, const struct axis *x, const struct axis *y,
+		  int vertical)
+{
+	const struct axis *a = vertical ? x : y;
+	double step;
+	double v;
+	int k;
+	int m;
+	int s;
+
+	if (a->scale == PLOT_LOG2) {
+		/* At most about 10 ticks */
+		s = ceil(log2(a->max / a->min) / 10);
+		if (s < 1)
+			s = 1;
+		for (k = floor(log2(a->min)); ldexp(1, k) <= a->max; k++) {
+			v = ldexp(1, k);
+			if (k % s == 0 && v >= a->min)
+				tick(f, x, y, vertical, v);
+		}
+	} else if (a->scale == PLOT_LOG10) {
+		for (k = floor(log10(a->min)); pow(10, k) <= a->max; k++) {
+			for (m = 1; m < 10; m++) {
+				v = m * pow(10, k);
+				/* 1, 2, 5, or all of 1-9 over short ranges */
+				if (a->max / a->min > 1000 && m > 1)
+					continue;
+				if (a->max / a->min > 10 && m != 1 && m != 2 &&
+				    m != 5)
+					continue;
+				if (v >= a->min && v <= a->max)
+					tick(f, x, y, vertical, v);
+			}
+		}
+	} else {
+		step = nice_step((a->max - a->min) / 5);
+		for (v = ceil(a->min / step) * step; v <= a->max + step / 1e6;
+		     v += step)
+			tick(f, x, y, vertical, v);
+	}
+}
+
+/* Range of the data of one axis; log axes skip the values <= 0 */
+static int data_range(const struct plot *p, int use_x, int scale,
+		      double *min, double *max)
+{
+	const double *d;
+	size_t i;
+	size_t j;
+
+	*min = INFINITY;
+	*max = -INFINITY;
+	for (i = 0; i < p->num_series; i++) {
+		d = use_x ? p->series[i].x : p->series[i].y;
+		for (j = 0; j < p->series[i].n; j++) {
+			if (!isfinite(d[j]) ||
+			    (scale != PLOT_LINEAR && d[j] <= 0))
+				continue;
+			if (d[j] < *min)
+				*min = d[j];
+			if (d[j] > *max)
+				*max = d[j];
+		}
+	}
+	return *min <= *max ? 0 : -1;
+}
+
+static void polyline(FILE *f, const struct plot_series *s,
+		     const struct axis *x, const struct axis *y)
+{
+	const char *color = palette[s->color % NUM_COLORS];
+	size_t i;
+
+	fprintf(f, "<polyline fill=\"none\" stroke=\"%s\" stroke-width=\"2\"",
+		color);
+	if (s->dashed)
+		fprintf(f, " stroke-dasharray=\"6,4\"");
+	fprintf(f, " points=\"");
+	for (i = 0; i < s->n; i++) {
+		if (!isfinite(s->x[i]) || !isfinite(s->y[i]) ||
+		    (x->scale != PLOT_LINEAR && s->x[i] <= 0))
+			continue;
+		fprintf(f, "%.1f,%.1f ", px(x, s->x[i]), py(y, s->y[i]));
+	}
+	fprintf(f, "\"/>\n");
+	/* Markers on sparse series */
+	if (s->n > 32)
+		return;
+	for (i = 0; i < s->n; i++) {
+		if (!isfinite(s->x[i]) || !isfinite(s->y[i]) ||
+		    (x->scale != PLOT_LINEAR && s->x[i] <= 0))
+			continue;
+		fprintf(f, "<circle cx=\"%.1f\" cy=\"%.1f\" r=\"3\" "
+			"fill=\"%s\"/>\n", px(x, s->x[i]), py(y, s->y[i]),
+			s->dashed ? "white" : color);
+	}
+}
+
+int plot_svg(const char *path, const struct plot *p)
+{
+	struct axis x = { .scale = p->xscale };
+	struct axis y = { .scale = PLOT_LINEAR };
+	double step;
+	size_t i;
+	int ly;
+	FILE *f;
+
+	if (data_range(p, 1, x.scale, &x.min, &x.max) < 0) {
+		fprintf(stderr, "%s: nothing to plot\n", path);
+		return -1;
+	}
+	if (x.min == x.max) {
+		if (x.scale == PLOT_LINEAR) {
+			x.min -= 1;
+			x.max += 1;
+		} else {
+			x.min /= 2;
+			x.max *= 2;
+		}
+	}
+	if (p->ymax > p->ymin) {
+		y.min = p->ymin;
+		y.max = p->ymax;
+	} else {
+		if (data_range(p, 0, y.scale, &y.min, &y.max) < 0 ||
+		    y.max <= 0)
+			y.max = 1;
+		y.min = 0;
+		step = nice_step(y.max / 5);
+		y.max = ceil(y.max * 1.05 / step) * step;
+	}
+
+	f = fopen(path, "w");
+	if (!f) {
+		perror(path);
+		return -1;
+	}
+	fprintf(f, "<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n");
+	fprintf(f, "<svg xmlns=\"http://www.w3.org/2000/svg\" width=\"%d\" "
+		"height=\"%d\" viewBox=\"0 0 %d %d\" font-family=\"sans-serif\" "
+		"font-size=\"12\">\n", WIDTH, HEIGHT, WIDTH, HEIGHT);
+	fprintf(f, "<style>.grid { stroke: #ddd; stroke-width: 1 }</style>\n");
+	fprintf(f, "<rect width=\"100%%\" height=\"100%%\" fill=\"white\"/>\n");
+
+	fprintf(f, "<text x=\"%d\" y=\"%d\" text-anchor=\"middle\" "
+		"font-size=\"14\" font-weight=\"bold\">", LEFT + PW / 2,
+		TOP - 16);
+	print_escaped(f, p->title);
+	fprintf(f, "</text>\n");
+
+	ticks(f, &x, &y, 1);
+	ticks(f, &x, &y, 0);
+	fprintf(f, "<rect x=\"%d\" y=\"%d\" width=\"%d\" height=\"%d\" "
+		"fill=\"none\" stroke=\"black\"/>\n", LEFT, TOP, PW, PH);
+	fprintf(f, "<text x=\"%d\" y=\"%d\" text-anchor=\"middle\">",
+		LEFT + PW / 2, HEIGHT - 16);
+	print_escaped(f, p->xlabel);
+	fprintf(f, "</text>\n");
+	fprintf(f, "<text transform=\"translate(%d,%d) rotate(-90)\" "
+		"text-anchor=\"middle\">", 20, TOP + PH / 2);
+	print_escaped(f, p->ylabel);
+	fprintf(f, "</text>\n");
+
+	for (i = 0; i < p->num_series; i++)
+		polyline(f, &p->series[i], &x, &y);
+
+	for (i = 0; i < p->num_series; i++) {
+		ly = TOP + 10 + 18 * i;
+		fprintf(f, "<line x1=\"%d\" y1=\"%d\" x2=\"%d\" y2=\"%d\" "
+			"stroke=\"%s\" stroke-width=\"2\"%s/>\n",
+			LEFT + PW + 12, ly, LEFT + PW + 36, ly,
+			palette[p->series[i].color % NUM_COLORS],
+			p->series[i].dashed ?
+			" stroke-dasharray=\"6,4\"" : "");
+		fprintf(f, "<text x=\"%d\" y=\"%d\">", LEFT + PW + 42, ly + 4);
+		print_escaped(f, p->series[i].label);
+		fprintf(f, "</text>\n");
+	}
+	fprintf(f, "</svg>\n");
+
+	if (fclose(f) == EOF) {
+		perror(path);
+		return -1;
+	}
+	return 0;
+}
@@ -0,0 +1,65 @@
+/*
+ * Copyright (c) 2015, Linaro Limited
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef PLOT_H
+#define PLOT_H
+
+#include <stddef.h>
+
+/*
+ * Minimal line charts written as standalone SVG files, for --plot: no
+ * scripts, fonts or external stylesheets
+ */
+
+#define PLOT_LINEAR	0
+#define PLOT_LOG2	2	/* Ticks at powers of 2, K/M/G (1024) labels */
+#define PLOT_LOG10	10	/* Ticks at 1, 2, 5 (or 1-9) x 10^k */
+
+struct plot_series {
+	const char *label;
+	int color;		/* Index into the palette */
+	int dashed;		/* Baselines */
+	size_t n;
+	const double *x;
+	const double *y;
+};
+
+struct plot {
+	const char *title;
+	const char *xlabel;
+	const char *ylabel;
+	int xscale;
+	double ymin;		/* Fixed y range if ymax > ymin, otherwise */
+	double ymax;		/* from 0 to the largest y value */
+	size_t num_series;
+	const struct plot_series *series;
+};
+
+/* Write p to path. Returns 0 on success, -1 on error. */
+int plot_svg(const char *path, const struct plot *p);
+
+#endif /* PLOT_H */
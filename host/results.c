@@ -0,0 +1,556 @@
+/*
+ * Copyright (c) 2015, Linaro Limited
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <fcntl.h>
+#include <math.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <sys/file.h>
+#include <sys/stat.h>
+#include <sys/utsname.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "results.h"
+
+#define RESULTS_MAGIC	0x53525041	/* "APRS" */
+#define RESULTS_VERSION	1
+
+/* Precedes each record; check covers the record and its histogram */
+struct results_header {
+	uint32_t magic;
+	uint16_t version;
+	uint16_t reserved;
+	uint32_t size;		/* Header, record and histogram */
+	uint32_t check;
+};
+
+#define MAX_RECORD_SIZE	(sizeof(struct results_header) + \
+			 sizeof(struct results_record) + \
+			 RESULTS_HIST_BUCKETS * sizeof(uint32_t))
+
+struct metric {
+	const char *name;
+	size_t offset;		/* Field of struct results_record */
+	double q;		/* Or quantile of the histogram if non-zero */
+};
+
+#define FIELD(f)	offsetof(struct results_record, f)
+
+static const struct metric metrics[] = {
+	{ .name = "mean", .offset = FIELD(mean) },
+	{ .name = "median", .offset = FIELD(median) },
+	{ .name = "min", .offset = FIELD(min) },
+	{ .name = "max", .offset = FIELD(max) },
+	{ .name = "stddev", .offset = FIELD(stddev) },
+	{ .name = "mad", .offset = FIELD(mad) },
+	{ .name = "q1", .offset = FIELD(q1) },
+	{ .name = "q3", .offset = FIELD(q3) },
+	{ .name = "trimmed", .offset = FIELD(trimmed) },
+	{ .name = "mibs", .offset = FIELD(mib_s) },
+	{ .name = "p90", .q = 0.9 },
+	{ .name = "p99", .q = 0.99 },
+	{ .name = "p99.9", .q = 0.999 },
+};
+
+#define NUM_METRICS	(sizeof(metrics) / sizeof(metrics[0]))
+
+/* Throughput rather than latency */
+static int is_mib_s(const struct metric *m)
+{
+	return !m->q && m->offset == FIELD(mib_s);
+}
+
+uint64_t results_hash(const char *s)
+{
+	uint64_t h = 0xcbf29ce484222325ULL;
+
+	while (*s) {
+		h ^= (uint8_t)*s++;
+		h *= 0x100000001b3ULL;
+	}
+	return h;
+}
+
+/* 32-bit FNV-1a of a buffer */
+static uint32_t checksum(const void *buf, size_t len)
+{
+	const uint8_t *p = buf;
+	uint32_t h = 0x811c9dc5;
+
+	while (len--) {
+		h ^= *p++;
+		h *= 0x01000193;
+	}
+	return h;
+}
+
+#ifndef CFG_TEE_EMU
+/* Copy the first line of a file to buf, without the newline */
+static int read_line(const char *path, char *buf, size_t len)
+{
+	FILE *f = fopen(path, "r");
+	int ret = -1;
+
+	if (!f)
+		return -1;
+	if (fgets(buf, len, f)) {
+		buf[strcspn(buf, "\n")] = '\0';
+		ret = 0;
+	}
+	fclose(f);
+	return ret;
+}
+#endif
+
+/* Value of "key : value" in /proc/cpuinfo */
+static int cpuinfo(const char *key, char *buf, size_t len)
+{
+	FILE *f = fopen("/proc/cpuinfo", "r");
+	char line[256];
+	size_t klen = strlen(key);
+	char *p;
+	int ret = -1;
+
+	if (!f)
+		return -1;
+	while (fgets(line, sizeof(line), f)) {
+		if (strncmp(line, key, klen) || !strchr(line, ':'))
+			continue;
+		p = strchr(line, ':') + 1;
+		p += strspn(p, " \t");
+		p[strcspn(p, "\n")] = '\0';
+		snprintf(buf, len, "%s", p);
+		ret = 0;
+		break;
+	}
+	fclose(f);
+	return ret;
+}
+
+void results_env(char *buf, size_t len, const char *version)
+{
+	struct utsname u;
+	char tee[64] = "unknown";
+	char cpu[96] = "unknown";
+	char impl[16];
+	char part[16];
+
+	if (uname(&u) < 0) {
+		strcpy(u.sysname, "unknown");
+		u.release[0] = u.machine[0] = '\0';
+	}
+#ifdef CFG_TEE_EMU
+	strcpy(tee, "emu");
+#else
+	/* Exposed by the optee driver of recent kernels */
+	read_line("/sys/class/tee/tee0/revision", tee, sizeof(tee));
+#endif
+	if (cpuinfo("model name", cpu, sizeof(cpu)) < 0 &&
+	    !cpuinfo("CPU implementer", impl, sizeof(impl)) &&
+	    !cpuinfo("CPU part", part, sizeof(part)))
+		snprintf(cpu, sizeof(cpu), "implementer %s part %s", impl,
+			 part);
+	snprintf(buf, len, "%s %s %s; OP-TEE %s; CPU %s; aes-perf %s",
+		 u.sysname, u.release, u.machine, tee, cpu, version);
+}
+
+static unsigned int bucket(uint64_t t)
+{
+	int e;
+
+	if (t < 8)
+		return t;
+	e = 63 - __builtin_clzll(t);
+	return 8 * (e - 2) + ((t >> (e - 3)) & 7);
+}
+
+/* Middle of a bucket, in ns */
+static double bucket_mid(unsigned int i)
+{
+	int e = i / 8 + 2;
+
+	if (i < 8)
+		return i;
+	return ldexp(8 + i % 8, e - 3) + ldexp(1, e - 3) / 2;
+}
+
+void results_hist(struct results_record *r, uint32_t *hist,
+		  const uint64_t *samples, size_t n)
+{
+	unsigned int first = RESULTS_HIST_BUCKETS;
+	unsigned int last = 0;
+	unsigned int b;
+	size_t i;
+
+	memset(hist, 0, RESULTS_HIST_BUCKETS * sizeof(*hist));
+	for (i = 0; i < n; i++) {
+		b = bucket(samples[i]);
+		hist[b]++;
+		if (b < first)
+			first = b;
+		if (b > last)
+			last = b;
+	}
+	r->hist_first = n ? first : 0;
+	r->hist_count = n ? last - first + 1 : 0;
+}
+
+int results_append(const char *path, struct results_record *r,
+		   const uint32_t *hist)
+{
+	struct results_header h;
+	struct stat st;
+	size_t hist_size;
+	uint8_t *buf;
+	size_t len;
+	ssize_t ret;
+	int rc = -1;
+	int fd;
+
+	if (!hist)
+		r->hist_first = r->hist_count = 0;
+	hist_size = r->hist_count * sizeof(*hist);
+	r->config_hash = results_hash(r->config);
+	r->env_hash = results_hash(r->env);
+	r->time = time(NULL);
+
+	len = sizeof(h) + sizeof(*r) + hist_size;
+	buf = malloc(len);
+	if (!buf) {
+		perror("malloc");
+		return -1;
+	}
+	memcpy(buf + sizeof(h), r, sizeof(*r));
+	if (hist_size)
+		memcpy(buf + sizeof(h) + sizeof(*r), hist + r->hist_first,
+		       hist_size);
+	memset(&h, 0, sizeof(h));
+	h.magic = RESULTS_MAGIC;
+	h.version = RESULTS_VERSION;
+	h.size = len;
+	h.check = checksum(buf + sizeof(h), len - sizeof(h));
+	memcpy(buf, &h, sizeof(h));
+
+	fd = open(path, O_WRONLY | O_CREAT | O_APPEND, 0644);
+	if (fd < 0) {
+		perror(path);
+		goto out;
+	}
+	if (flock(fd, LOCK_EX) < 0 || fstat(fd, &st) < 0) {
+		perror(path);
+		goto close;
+	}
+	ret = write(fd, buf, len);
+	if (ret != (ssize_t)len) {
+		if (ret < 0)
+			perror(path);
+		else
+			fprintf(stderr, "%s: short write\n", path);
+		/* Do not leave a partial record behind */
+		if (ftruncate(fd, st.st_size) < 0)
+			perror(path);
+		goto close;
+	}
+	if (fdatasync(fd) < 0) {
+		perror(path);
+		goto close;
+	}
+	rc = 0;
+close:
+	close(fd);
+out:
+	free(buf);
+	return rc;
+}
+
+int results_metric(const char *name)
+{
+	size_t i;
+
+	for (i = 0; i < NUM_METRICS; i++)
+		if (!strcasecmp(name, metrics[i].name))
+			return i;
+	return -1;
+}
+
+/* q-quantile of the stored histogram in ns (nearest rank), NAN if none */
+static double hist_quantile(const struct results_record *r,
+			    const uint32_t *hist, double q)
+{
+	uint64_t total = 0;
+	uint64_t cum = 0;
+	uint64_t rank;
+	uint32_t i;
+
+	for (i = 0; i < r->hist_count; i++)
+		total += hist[i];
+	if (!total)
+		return NAN;
+	rank = ceil(q * total);
+	if (rank < 1)
+		rank = 1;
+	for (i = 0; i < r->hist_count; i++) {
+		cum += hist[i];
+		if (cum >= rank)
+			break;
+	}
+	return bucket_mid(r->hist_first + i);
+}
+
+int results_cdf(const struct results_record *r, const uint32_t *hist,
+		double *lat, size_t num)
+{
+	size_t i;
+
+	if (!r->hist_count)
+		return -1;
+	for (i = 0; i < num; i++)
+		lat[i] = hist_quantile(r, hist, (double)i / (num - 1));
+	return 0;
+}
+
+/* Metric of a record in μs or MiB/s, NAN if not available */
+static double metric_value(const struct results_record *r,
+			   const uint32_t *hist, int metric)
+{
+	const struct metric *m = &metrics[metric];
+
+	if (!m->q) {
+		double v = *(const double *)((const char *)r + m->offset);
+
+		return is_mib_s(m) ? v : v / 1000;
+	}
+	return hist_quantile(r, hist, m->q) / 1000;
+}
+
+/* Index of an environment in the legend, adding it if new */
+static int env_index(uint64_t **envs, int *num_envs, uint64_t hash)
+{
+	uint64_t *p;
+	int i;
+
+	for (i = 0; i < *num_envs; i++)
+		if ((*envs)[i] == hash)
+			return i;
+	p = realloc(*envs, (*num_envs + 1) * sizeof(*p));
+	if (!p) {
+		perror("realloc");
+		exit(1);
+	}
+	*envs = p;
+	(*envs)[*num_envs] = hash;
+	return (*num_envs)++;
+}
+
+/*
+ * Read the next valid record of the store into buf: the record, followed by
+ * its histogram. Returns 1, or 0 at the end of the usable data.
+ */
+static int read_record(FILE *f, const char *path, uint8_t *buf)
+{
+	struct results_header h;
+	struct results_record *r = (struct results_record *)buf;
+	long pos;
+	size_t len;
+
+	while (1) {
+		pos = ftell(f);
+		len = fread(&h, 1, sizeof(h), f);
+		if (!len)
+			return 0;
+		if (len < sizeof(h)) {
+			fprintf(stderr, "%s: truncated record at offset %ld\n",
+				path, pos);
+			return 0;
+		}
+		if (h.magic != RESULTS_MAGIC || h.size < sizeof(h) ||
+		    h.size > MAX_RECORD_SIZE) {
+			/* Cannot find the next record */
+			fprintf(stderr, "%s: invalid record at offset %ld, ",
+				path, pos);
+			fprintf(stderr, "ignoring the rest of the file\n");
+			return 0;
+		}
+		len = h.size - sizeof(h);
+		if (fread(buf, 1, len, f) != len) {
+			fprintf(stderr, "%s: truncated record at offset %ld\n",
+				path, pos);
+			return 0;
+		}
+		if (checksum(buf, len) != h.check) {
+			fprintf(stderr, "%s: corrupt record at offset %ld, ",
+				path, pos);
+			fprintf(stderr, "skipped\n");
+			continue;
+		}
+		/* Newer format */
+		if (h.version != RESULTS_VERSION || len < sizeof(*r))
+			continue;
+		if (len != sizeof(*r) + r->hist_count * sizeof(uint32_t) ||
+		    r->hist_first + r->hist_count > RESULTS_HIST_BUCKETS)
+			continue;
+		r->config[RESULTS_CONFIG_LEN - 1] = '\0';
+		r->env[RESULTS_ENV_LEN - 1] = '\0';
+		return 1;
+	}
+}
+
+/* Open the store for reading, with a shared lock */
+static FILE *open_store(const char *path)
+{
+	FILE *f = fopen(path, "r");
+
+	if (!f) {
+		perror(path);
+		return NULL;
+	}
+	if (flock(fileno(f), LOCK_SH) < 0) {
+		perror(path);
+		fclose(f);
+		return NULL;
+	}
+	return f;
+}
+
+int results_latest(const char *path, const char *config,
+		   struct results_record *r, uint32_t *hist)
+{
+	uint64_t key = results_hash(config);
+	struct results_record *rec;
+	uint8_t *buf;
+	int found = 0;
+	FILE *f;
+
+	f = open_store(path);
+	if (!f)
+		return -1;
+	buf = malloc(MAX_RECORD_SIZE);
+	if (!buf) {
+		perror("malloc");
+		exit(1);
+	}
+	rec = (struct results_record *)buf;
+	while (read_record(f, path, buf)) {
+		if (rec->config_hash != key || strcmp(rec->config, config))
+			continue;
+		memcpy(r, rec, sizeof(*r));
+		memcpy(hist, buf + sizeof(*r),
+		       rec->hist_count * sizeof(*hist));
+		found = 1;
+	}
+	free(buf);
+	fclose(f);
+	return found;
+}
+
+int results_history(const char *path, const char *config, int metric)
+{
+	uint64_t key = results_hash(config);
+	struct results_record r;
+	uint8_t *buf;
+	uint32_t *hist;
+	uint64_t *envs = NULL;
+	int num_envs = 0;
+	int env = -1;
+	int e;
+	FILE *f;
+	struct tm tm;
+	time_t t;
+	char date[32];
+	double v;
+	double first = NAN;
+	double last = NAN;
+	double lo = INFINITY;
+	double hi = -INFINITY;
+	int runs = 0;
+
+	f = open_store(path);
+	if (!f)
+		return -1;
+	buf = malloc(MAX_RECORD_SIZE);
+	if (!buf) {
+		perror("malloc");
+		exit(1);
+	}
+	hist = (uint32_t *)(buf + sizeof(r));
+
+	printf("configuration: %s\n", config);
+	printf("metric: %s (%s)\n", metrics[metric].name,
+	       is_mib_s(&metrics[metric]) ? "MiB/s" : "μs");
+	while (read_record(f, path, buf)) {
+		memcpy(&r, buf, sizeof(r));
+		if (r.config_hash != key || strcmp(r.config, config))
+			continue;
+
+		if (!runs)
+			printf("%4s  %-19s  %3s  %8s  %12s  %9s\n", "run",
+			       "date", "env", "samples", "value", "vs first");
+		e = env_index(&envs, &num_envs, r.env_hash);
+		if (e != env) {
+			printf("      environment [%d]: %s\n", e, r.env);
+			env = e;
+		}
+		t = r.time;
+		localtime_r(&t, &tm);
+		strftime(date, sizeof(date), "%Y-%m-%d %H:%M:%S", &tm);
+		v = metric_value(&r, hist, metric);
+		runs++;
+		if (isnan(v)) {
+			printf("%4d  %s  %3d  %8u  %12s\n", runs, date, e, r.n,
+			       "n/a");
+			continue;
+		}
+		if (isnan(first))
+			first = v;
+		last = v;
+		if (v < lo)
+			lo = v;
+		if (v > hi)
+			hi = v;
+		printf("%4d  %s  %3d  %8u  %12.3f  %+8.2f%%\n", runs, date, e,
+		       r.n, v, 100 * (v - first) / first);
+	}
+	free(buf);
+	free(envs);
+	fclose(f);
+
+	if (!runs) {
+		printf("no stored runs of this configuration\n");
+		return 0;
+	}
+	if (isnan(first))
+		printf("%d runs, no histograms (see --store-hist)\n", runs);
+	else
+		printf("%d runs, first=%.3f last=%.3f (%+.2f%%) min=%.3f "
+		       "max=%.3f\n", runs, first, last,
+		       100 * (last - first) / first, lo, hi);
+	return 0;
+}
@@ -0,0 +1,116 @@
+/*
+ * Copyright (c) 2015, Linaro Limited
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef RESULTS_H
+#define RESULTS_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * Local results store (--store): an append-only file of fixed-size binary
+ * records, one per run_test(), holding the summary statistics of the run and
+ * optionally its latency histogram. Each record is keyed by a hash of the
+ * configuration string and of the environment fingerprint (kernel, OP-TEE
+ * revision, CPU model, aes-perf version), which are also stored in clear.
+ *
+ * Records are written with a single write() under an exclusive flock(), so
+ * concurrent writers do not interleave, and a failed write is truncated away.
+ * The format is native-endian: the store is meant for the machine that
+ * produced it.
+ */
+
+#define RESULTS_CONFIG_LEN	256
+#define RESULTS_ENV_LEN		192
+
+/*
+ * Histogram buckets: one per ns below 8 ns, then 8 linear sub-buckets per
+ * power of two (12.5% resolution) up to 2^64 ns
+ */
+#define RESULTS_HIST_BUCKETS	496
+
+struct results_record {
+	uint64_t config_hash;
+	uint64_t env_hash;
+	uint64_t time;			/* Seconds since the Epoch */
+	char config[RESULTS_CONFIG_LEN];
+	char env[RESULTS_ENV_LEN];
+	uint32_t n;			/* Samples */
+	uint32_t hist_first;		/* First non-empty bucket */
+	uint32_t hist_count;		/* Buckets stored, 0: no histogram */
+	uint32_t reserved;
+	/* Latencies in ns */
+	double min;
+	double max;
+	double mean;
+	double stddev;
+	double median;
+	double mad;
+	double q1;
+	double q3;
+	double trimmed;
+	double mib_s;			/* Throughput */
+};
+
+/* FNV-1a hash of a string */
+uint64_t results_hash(const char *s);
+/* Environment fingerprint of this machine */
+void results_env(char *buf, size_t len, const char *version);
+/*
+ * Fill hist[RESULTS_HIST_BUCKETS] from n samples and set the histogram range
+ * of r
+ */
+void results_hist(struct results_record *r, uint32_t *hist,
+		  const uint64_t *samples, size_t n);
+/*
+ * Append r (and its histogram if hist is not NULL) to the store at path.
+ * Sets the hashes and time of r. Returns 0 on success, -1 on error.
+ */
+int results_append(const char *path, struct results_record *r,
+		   const uint32_t *hist);
+/*
+ * Latest record of configuration config in the store at path, and its
+ * histogram (r->hist_count buckets from r->hist_first). Returns 1 if found,
+ * 0 if not, -1 on error.
+ */
+int results_latest(const char *path, const char *config,
+		   struct results_record *r, uint32_t *hist);
+/*
+ * Latencies in ns at num evenly spaced quantiles (min to max) from the
+ * histogram of a record read by results_latest(). Returns -1 if it has none.
+ */
+int results_cdf(const struct results_record *r, const uint32_t *hist,
+		double *lat, size_t num);
+/* Index of a metric for results_history(), -1 if unknown */
+int results_metric(const char *name);
+/*
+ * Print the given metric of all stored runs of configuration config, oldest
+ * first. Returns 0 on success, -1 on error.
+ */
+int results_history(const char *path, const char *config, int metric);
+
+#endif /* RESULTS_H */
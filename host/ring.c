@@ -0,0 +1,119 @@
+/*
+ * Copyright (c) 2015, Linaro Limited
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <string.h>
+
+#include "ring.h"
+
+/*
+ * Each cell starts with a sequence number: a cell at position pos is free for
+ * a producer when seq == pos and holds an entry for a consumer when
+ * seq == pos + 1.
+ */
+
+static size_t cell_size(size_t entry_size)
+{
+	size_t sz = sizeof(atomic_size_t) + entry_size;
+	size_t align = _Alignof(atomic_size_t);
+
+	return (sz + align - 1) & ~(align - 1);
+}
+
+static atomic_size_t *cell_seq(struct ring *r, size_t pos)
+{
+	return (atomic_size_t *)(r->cells + (pos & r->mask) * r->cell_size);
+}
+
+size_t ring_mem_size(size_t count, size_t entry_size)
+{
+	return sizeof(struct ring) + count * cell_size(entry_size);
+}
+
+void ring_init(struct ring *r, size_t count, size_t entry_size)
+{
+	size_t i;
+
+	r->mask = count - 1;
+	r->cell_size = cell_size(entry_size);
+	r->entry_size = entry_size;
+	atomic_init(&r->head, 0);
+	atomic_init(&r->tail, 0);
+	for (i = 0; i < count; i++)
+		atomic_init(cell_seq(r, i), i);
+}
+
+int ring_push(struct ring *r, const void *entry)
+{
+	size_t pos = atomic_load_explicit(&r->head, memory_order_relaxed);
+	atomic_size_t *seq;
+	size_t s;
+
+	for (;;) {
+		seq = cell_seq(r, pos);
+		s = atomic_load_explicit(seq, memory_order_acquire);
+		if (s == pos) {
+			if (atomic_compare_exchange_weak_explicit(&r->head,
+					&pos, pos + 1, memory_order_relaxed,
+					memory_order_relaxed))
+				break;
+		} else if (s < pos) {
+			return -1;
+		} else {
+			pos = atomic_load_explicit(&r->head,
+						   memory_order_relaxed);
+		}
+	}
+	memcpy(seq + 1, entry, r->entry_size);
+	atomic_store_explicit(seq, pos + 1, memory_order_release);
+	return 0;
+}
+
+int ring_pop(struct ring *r, void *entry)
+{
+	size_t pos = atomic_load_explicit(&r->tail, memory_order_relaxed);
+	atomic_size_t *seq;
+	size_t s;
+
+	for (;;) {
+		seq = cell_seq(r, pos);
+		s = atomic_load_explicit(seq, memory_order_acquire);
+		if (s == pos + 1) {
+			if (atomic_compare_exchange_weak_explicit(&r->tail,
+					&pos, pos + 1, memory_order_relaxed,
+					memory_order_relaxed))
+				break;
+		} else if (s < pos + 1) {
+			return -1;
+		} else {
+			pos = atomic_load_explicit(&r->tail,
+						   memory_order_relaxed);
+		}
+	}
+	memcpy(entry, seq + 1, r->entry_size);
+	atomic_store_explicit(seq, pos + r->mask + 1, memory_order_release);
+	return 0;
+}
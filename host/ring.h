@@ -0,0 +1,60 @@
+/*
+ * Copyright (c) 2015, Linaro Limited
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef RING_H
+#define RING_H
+
+#include <stdatomic.h>
+#include <stddef.h>
+
+/*
+ * Bounded lock-free queue of fixed-size entries (D. Vyukov's algorithm).
+ *
+ * Any number of threads may push and pop concurrently. The ring is a single
+ * flat block of memory without pointers, so it may be placed in memory shared
+ * between processes. Allocate ring_mem_size() bytes and call ring_init().
+ */
+
+struct ring {
+	size_t mask;		/* Number of cells - 1 */
+	size_t cell_size;
+	size_t entry_size;
+	_Alignas(64) atomic_size_t head;	/* Next cell to push */
+	_Alignas(64) atomic_size_t tail;	/* Next cell to pop */
+	_Alignas(64) unsigned char cells[];
+};
+
+/* count must be a power of two */
+size_t ring_mem_size(size_t count, size_t entry_size);
+void ring_init(struct ring *r, size_t count, size_t entry_size);
+
+/* Return 0 on success, -1 if the ring is full */
+int ring_push(struct ring *r, const void *entry);
+/* Return 0 on success, -1 if the ring is empty */
+int ring_pop(struct ring *r, void *entry);
+
+#endif /* RING_H */
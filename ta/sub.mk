@@ -1 +1,4 @@
 srcs-y += ta_aes_perf.c
+srcs-y += ta_asym.c
+srcs-y += ta_storage.c
+cppflags-$(CFG_TA_SINGLE_INSTANCE) += -DCFG_TA_SINGLE_INSTANCE
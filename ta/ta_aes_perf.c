@@ -32,19 +32,32 @@
 
 #include "ta_aes_perf.h"
 #include "ta_aes_perf_priv.h"
+#include "user_ta_header_defines.h"
 
-#define CHECK(res, name, action) do {			\
-		if ((res) != TEE_SUCCESS) {		\
-			DMSG(name ": 0x%08x", (res));	\
-			action				\
-		}					\
-	} while(0)
+static uint8_t iv[] = TA_AES_PERF_IV;
 
-static uint8_t iv[] = { 0xA0, 0xA1, 0xA2, 0xA3, 0xA4, 0xA5, 0xA6, 0xA7,
-			0xA8, 0xA9, 0xAA, 0xAB, 0xAC, 0xAD, 0xAE, 0xAF };
-static int use_iv;
+/*
+ * Number of sessions opened on the single instance. A multi-instance TA has
+ * one session per instance. Only the sessions of the single-instance variant
+ * are counted: the emulated TEE serves both variants with one copy of these
+ * globals.
+ */
+static uint32_t si_sessions;
 
-static TEE_OperationHandle crypto_op = NULL;
+/*
+ * Is this the single-instance variant? Asked to the TEE rather than taken
+ * from CFG_TA_SINGLE_INSTANCE, so that one build can serve both UUIDs.
+ */
+static int is_single_instance(void)
+{
+	bool single;
+
+	if (TEE_GetPropertyAsBool(TEE_PROPSET_CURRENT_TA,
+				  "gpd.ta.singleInstance", &single) !=
+	    TEE_SUCCESS)
+		return 0;
+	return single;
+}
 
 /*
  * Trusted Application Entry Points
@@ -66,19 +79,44 @@ TEE_Result TA_OpenSessionEntryPoint(uint32_t nParamTypes,
 				    TEE_Param pParams[4],
 				    void **ppSessionContext)
 {
+	struct aes_perf_session *s;
+
 	(void)nParamTypes;
 	(void)pParams;
-	(void)ppSessionContext;
+
+	s = TEE_Malloc(sizeof(*s), 0);
+	if (!s)
+		return TEE_ERROR_OUT_OF_MEMORY;
+	s->crypto_op = TEE_HANDLE_NULL;
+	s->op_mode = TEE_MODE_ENCRYPT;
+	s->use_iv = 0;
+	s->final = 0;
+	s->buf = NULL;
+	s->buf_size = 0;
+	s->alg = 0;
+	s->key = TEE_HANDLE_NULL;
+	s->secret = TEE_HANDLE_NULL;
+	s->obj = TEE_HANDLE_NULL;
+	s->single = is_single_instance();
+	*ppSessionContext = s;
+	if (s->single)
+		si_sessions++;
 	return TEE_SUCCESS;
 }
 
 /* Called each time a session is closed */
 void TA_CloseSessionEntryPoint(void *pSessionContext)
 {
-	(void)pSessionContext;
-
-	if (crypto_op)
-		TEE_FreeOperation(crypto_op);
+	struct aes_perf_session *s = pSessionContext;
+
+	if (s->crypto_op)
+		TEE_FreeOperation(s->crypto_op);
+	free_asym(s);
+	free_storage(s);
+	TEE_Free(s->buf);
+	if (s->single)
+		si_sessions--;
+	TEE_Free(s);
 }
 
 /* Called when a command is invoked */
@@ -86,21 +124,102 @@ TEE_Result TA_InvokeCommandEntryPoint(void *pSessionContext,
 				      uint32_t nCommandID, uint32_t nParamTypes,
 				      TEE_Param pParams[4])
 {
-	(void)pSessionContext;
+	struct aes_perf_session *s = pSessionContext;
 
 	switch (nCommandID) {
 	case TA_AES_PERF_CMD_PREPARE_KEY:
-		return cmd_prepare_key(nParamTypes, pParams);
+		return cmd_prepare_key(s, nParamTypes, pParams);
 
 	case TA_AES_PERF_CMD_PROCESS:
-		return cmd_process(nParamTypes, pParams);
+		return cmd_process(s, nParamTypes, pParams);
+
+	case TA_AES_PERF_CMD_PROCESS_COPY:
+		return cmd_process_copy(s, nParamTypes, pParams);
+
+	case TA_AES_PERF_CMD_RANDOM:
+		return cmd_random(nParamTypes, pParams);
+
+	case TA_AES_PERF_CMD_STORAGE:
+		return cmd_storage(s, nParamTypes, pParams);
+
+	case TA_AES_PERF_CMD_GET_INFO:
+		return cmd_get_info(s, nParamTypes, pParams);
 
 	default:
 		return TEE_ERROR_BAD_PARAMETERS;
 	}
 }
 
-TEE_Result cmd_process(uint32_t param_types, TEE_Param params[4])
+static int is_hash(struct aes_perf_session *s)
+{
+	return s->op_mode == TEE_MODE_DIGEST || s->op_mode == TEE_MODE_MAC;
+}
+
+/*
+ * Digest or MAC the input n times: as a single stream, or as n messages if
+ * s->final is set. In the latter case, the digest or MAC of the last message
+ * is returned at the beginning of the output buffer.
+ */
+static TEE_Result process_hash(struct aes_perf_session *s, const void *in,
+			       uint32_t insz, void *out, uint32_t outsz, int n)
+{
+	TEE_Result res;
+	uint8_t md[64];
+	uint32_t mdsz = 0;
+
+	while (n--) {
+		if (!s->final) {
+			if (s->op_mode == TEE_MODE_DIGEST)
+				TEE_DigestUpdate(s->crypto_op, in, insz);
+			else
+				TEE_MACUpdate(s->crypto_op, in, insz);
+			continue;
+		}
+		mdsz = sizeof(md);
+		if (s->op_mode == TEE_MODE_DIGEST) {
+			res = TEE_DigestDoFinal(s->crypto_op, in, insz, md,
+						&mdsz);
+			CHECK(res, "TEE_DigestDoFinal", return res;);
+		} else {
+			res = TEE_MACComputeFinal(s->crypto_op, in, insz, md,
+						  &mdsz);
+			CHECK(res, "TEE_MACComputeFinal", return res;);
+			TEE_MACInit(s->crypto_op, NULL, 0);
+		}
+	}
+	TEE_MemMove(out, md, mdsz < outsz ? mdsz : outsz);
+	return TEE_SUCCESS;
+}
+
+/*
+ * Cipher loop of cmd_process() that TEEC_RequestCancellation() can abort
+ * between two updates
+ */
+static TEE_Result process_cancellable(struct aes_perf_session *s,
+				      const void *in, uint32_t insz, void *out,
+				      uint32_t outsz, int n)
+{
+	TEE_Result res = TEE_SUCCESS;
+	bool masked;
+
+	if (!s->crypto_op)
+		return TEE_ERROR_BAD_STATE;
+	masked = TEE_UnmaskCancellation();
+	while (n--) {
+		if (TEE_GetCancellationFlag()) {
+			res = TEE_ERROR_CANCEL;
+			break;
+		}
+		res = TEE_CipherUpdate(s->crypto_op, in, insz, out, &outsz);
+		CHECK(res, "TEE_CipherUpdate", break;);
+	}
+	if (masked)
+		TEE_MaskCancellation();
+	return res;
+}
+
+TEE_Result cmd_process(struct aes_perf_session *s, uint32_t param_types,
+		       TEE_Param params[4])
 {
 	TEE_Result res;
 	int n;
@@ -114,6 +233,9 @@ TEE_Result cmd_process(uint32_t param_types, TEE_Param params[4])
 
 	if (param_types != exp_param_types)
 		return TEE_ERROR_BAD_PARAMETERS;
+	/* No key: the last cmd_prepare_key() failed */
+	if (!s->crypto_op)
+		return TEE_ERROR_BAD_STATE;
 
 	in = params[0].memref.buffer;
 	insz = params[0].memref.size;
@@ -121,14 +243,151 @@ TEE_Result cmd_process(uint32_t param_types, TEE_Param params[4])
 	outsz = params[1].memref.size;
 	n = params[2].value.a;
 
+	if (s->alg)
+		return process_asym(s, n);
+	if (is_hash(s))
+		return process_hash(s, in, insz, out, outsz, n);
+	if (params[2].value.b & TA_PROCESS_CANCELLABLE)
+		return process_cancellable(s, in, insz, out, outsz, n);
+
 	while (n--) {
-		res = TEE_CipherUpdate(crypto_op, in, insz, out, &outsz);
+		res = TEE_CipherUpdate(s->crypto_op, in, insz, out, &outsz);
 		CHECK(res, "TEE_CipherUpdate", return res;);
 	}
 	return TEE_SUCCESS;
 }
 
-TEE_Result cmd_prepare_key(uint32_t param_types, TEE_Param params[4])
+/*
+ * Current time in ns, used to time the stages of cmd_process_copy(). The
+ * generic timer of Arm is used when its frequency is set, otherwise
+ * TEE_GetSystemTime(), which only counts in milliseconds: *coarse is set
+ * then.
+ */
+static uint64_t now_ns(int *coarse)
+{
+	TEE_Time t;
+#if defined(__aarch64__) || defined(__arm__)
+	uint64_t cnt;
+	uint64_t frq;
+#ifdef __aarch64__
+	asm volatile("isb; mrs %0, cntvct_el0" : "=r" (cnt));
+	asm volatile("mrs %0, cntfrq_el0" : "=r" (frq));
+#else
+	uint32_t f;
+
+	asm volatile("isb; mrrc p15, 1, %Q0, %R0, c14" : "=r" (cnt));
+	asm volatile("mrc p15, 0, %0, c14, c0, 0" : "=r" (f));
+	frq = f;
+#endif
+	if (frq)
+		return cnt / frq * 1000000000 + cnt % frq * 1000000000 / frq;
+#endif
+	*coarse = 1;
+	TEE_GetSystemTime(&t);
+	return (uint64_t)t.seconds * 1000000000 + t.millis * 1000000ULL;
+}
+
+static uint32_t sat32(uint64_t v, int *saturated)
+{
+	if (v <= UINT32_MAX)
+		return v;
+	*saturated = 1;
+	return UINT32_MAX;
+}
+
+/*
+ * Same as cmd_process(), but following the pattern of TAs that do not work
+ * on shared memory directly (the normal world may modify it at any time):
+ * each chunk of the input is copied to a private heap buffer, encrypted in
+ * place and copied out.
+ *
+ * params[2].value.a: number of loops, params[2].value.b: chunk size (0: whole
+ * buffer). Returned: time spent copying in (params[3].value.a), encrypting
+ * (params[2].value.a) and copying out (params[3].value.b), in ns, and the
+ * size of the working buffer with the TA_COPY_* flags (params[2].value.b).
+ */
+TEE_Result cmd_process_copy(struct aes_perf_session *s, uint32_t param_types,
+			    TEE_Param params[4])
+{
+	TEE_Result res;
+	int n;
+	uint8_t *in, *out;
+	uint32_t insz;
+	uint32_t chunk;
+	uint32_t off;
+	uint32_t sz;
+	uint32_t outsz;
+	uint64_t t0, t1, t2, t3;
+	uint64_t t_in = 0;
+	uint64_t t_cipher = 0;
+	uint64_t t_out = 0;
+	int coarse = 0;
+	int saturated = 0;
+	uint32_t exp_param_types = TEE_PARAM_TYPES(TEE_PARAM_TYPE_MEMREF_INOUT,
+						   TEE_PARAM_TYPE_MEMREF_INOUT,
+						   TEE_PARAM_TYPE_VALUE_INOUT,
+						   TEE_PARAM_TYPE_VALUE_OUTPUT);
+
+	if (param_types != exp_param_types)
+		return TEE_ERROR_BAD_PARAMETERS;
+	if (!s->crypto_op)
+		return TEE_ERROR_BAD_STATE;
+	if (s->alg || is_hash(s))
+		return TEE_ERROR_NOT_SUPPORTED;
+
+	in = params[0].memref.buffer;
+	insz = params[0].memref.size;
+	out = params[1].memref.buffer;
+	if (params[1].memref.size < insz)
+		return TEE_ERROR_SHORT_BUFFER;
+	n = params[2].value.a;
+	chunk = params[2].value.b;
+	if (!chunk || chunk > insz)
+		chunk = insz;
+	if (chunk > TA_COPY_SIZE_MASK)
+		return TEE_ERROR_BAD_PARAMETERS;
+
+	if (s->buf_size < chunk) {
+		TEE_Free(s->buf);
+		s->buf_size = 0;
+		s->buf = TEE_Malloc(chunk, 0);
+		if (!s->buf)
+			return TEE_ERROR_OUT_OF_MEMORY;
+		s->buf_size = chunk;
+	}
+
+	while (n--) {
+		for (off = 0; off < insz; off += sz) {
+			sz = insz - off < chunk ? insz - off : chunk;
+			outsz = sz;
+			t0 = now_ns(&coarse);
+			TEE_MemMove(s->buf, in + off, sz);
+			t1 = now_ns(&coarse);
+			res = TEE_CipherUpdate(s->crypto_op, s->buf, sz,
+					       s->buf, &outsz);
+			CHECK(res, "TEE_CipherUpdate", return res;);
+			t2 = now_ns(&coarse);
+			TEE_MemMove(out + off, s->buf, sz);
+			t3 = now_ns(&coarse);
+			t_in += t1 - t0;
+			t_cipher += t2 - t1;
+			t_out += t3 - t2;
+		}
+	}
+
+	params[2].value.a = sat32(t_cipher, &saturated);
+	params[3].value.a = sat32(t_in, &saturated);
+	params[3].value.b = sat32(t_out, &saturated);
+	params[2].value.b = s->buf_size;
+	if (coarse)
+		params[2].value.b |= TA_COPY_COARSE;
+	if (saturated)
+		params[2].value.b |= TA_COPY_SATURATED;
+	return TEE_SUCCESS;
+}
+
+TEE_Result cmd_prepare_key(struct aes_perf_session *s, uint32_t param_types,
+			   TEE_Param params[4])
 {
 	TEE_Result res;
 	TEE_ObjectHandle hkey;
@@ -138,22 +397,9 @@ TEE_Result cmd_prepare_key(uint32_t param_types, TEE_Param params[4])
 	uint32_t op_keysize;
 	uint32_t keysize;
 	uint32_t algo;
-	static uint8_t aes_key[] = { 0x00, 0x01, 0x02, 0x03,
-				     0x04, 0x05, 0x06, 0x07,
-				     0x08, 0x09, 0x0A, 0x0B,
-				     0x0C, 0x0D, 0x0E, 0x0F,
-				     0x10, 0x11, 0x12, 0x13,
-				     0x14, 0x15, 0x16, 0x17,
-				     0x18, 0x19, 0x1A, 0x1B,
-				     0x1C, 0x1D, 0x1E, 0x1F };
-	static uint8_t aes_key2[] = { 0x20, 0x21, 0x22, 0x23,
-				      0x24, 0x25, 0x26, 0x27,
-				      0x28, 0x29, 0x2A, 0x2B,
-				      0x2C, 0x2D, 0x2E, 0x2F,
-				      0x30, 0x31, 0x32, 0x33,
-				      0x34, 0x35, 0x36, 0x37,
-				      0x38, 0x39, 0x3A, 0x3B,
-				      0x3C, 0x3D, 0x3E, 0x3F };
+	uint32_t key_type = TEE_TYPE_AES;
+	static uint8_t aes_key[] = TA_AES_PERF_KEY;
+	static uint8_t aes_key2[] = TA_AES_PERF_KEY2;
 
 	uint32_t exp_param_types = TEE_PARAM_TYPES(TEE_PARAM_TYPE_VALUE_INPUT,
 						   TEE_PARAM_TYPE_VALUE_INPUT,
@@ -165,36 +411,71 @@ TEE_Result cmd_prepare_key(uint32_t param_types, TEE_Param params[4])
 	mode = params[0].value.a ? TEE_MODE_DECRYPT : TEE_MODE_ENCRYPT;
 	keysize = params[0].value.b;
 	op_keysize = keysize;
+	s->use_iv = 0;
+	s->final = params[1].value.b;
+
+	if (s->crypto_op) {
+		TEE_FreeOperation(s->crypto_op);
+		s->crypto_op = TEE_HANDLE_NULL;
+	}
+	free_asym(s);
+	if (params[1].value.a >= TA_RSA_SIGN)
+		return prepare_asym(s, params[1].value.a, keysize);
 
 	switch (params[1].value.a) {
 	case TA_AES_ECB:
 		algo = TEE_ALG_AES_ECB_NOPAD;
-		use_iv = 0;
 		break;
 	case TA_AES_CBC:
 		algo = TEE_ALG_AES_CBC_NOPAD;
-		use_iv = 1;
+		s->use_iv = 1;
 		break;
 	case TA_AES_CTR:
 		algo = TEE_ALG_AES_CTR;
-		use_iv = 1;
+		s->use_iv = 1;
 		break;
 	case TA_AES_XTS:
 		algo = TEE_ALG_AES_XTS;
-		use_iv = 1;
+		s->use_iv = 1;
 		op_keysize *= 2;
 		break;
+	case TA_SHA1:
+		algo = TEE_ALG_SHA1;
+		mode = TEE_MODE_DIGEST;
+		break;
+	case TA_SHA256:
+		algo = TEE_ALG_SHA256;
+		mode = TEE_MODE_DIGEST;
+		break;
+	case TA_SHA512:
+		algo = TEE_ALG_SHA512;
+		mode = TEE_MODE_DIGEST;
+		break;
+	case TA_HMAC_SHA256:
+		algo = TEE_ALG_HMAC_SHA256;
+		mode = TEE_MODE_MAC;
+		key_type = TEE_TYPE_HMAC_SHA256;
+		break;
+	case TA_AES_CMAC:
+		algo = TEE_ALG_AES_CMAC;
+		mode = TEE_MODE_MAC;
+		break;
 	default:
 		return TEE_ERROR_BAD_PARAMETERS;
 	}
 
-	if (crypto_op)
-		TEE_FreeOperation(crypto_op);
+	s->op_mode = mode;
 
-	res = TEE_AllocateOperation(&crypto_op, algo, mode, op_keysize);
+	if (mode == TEE_MODE_DIGEST) {
+		res = TEE_AllocateOperation(&s->crypto_op, algo, mode, 0);
+		CHECK(res, "TEE_AllocateOperation", return res;);
+		return TEE_SUCCESS;
+	}
+
+	res = TEE_AllocateOperation(&s->crypto_op, algo, mode, op_keysize);
 	CHECK(res, "TEE_AllocateOperation", return res;);
 
-	res = TEE_AllocateTransientObject(TEE_TYPE_AES, keysize, &hkey);
+	res = TEE_AllocateTransientObject(key_type, keysize, &hkey);
 	CHECK(res, "TEE_AllocateTransientObject", return res;);
 
 	attr.attributeID = TEE_ATTR_SECRET_VALUE;
@@ -214,21 +495,64 @@ TEE_Result cmd_prepare_key(uint32_t param_types, TEE_Param params[4])
 		res = TEE_PopulateTransientObject(hkey2, &attr, 1);
 		CHECK(res, "TEE_PopulateTransientObject", return res;);
 
-		res = TEE_SetOperationKey2(crypto_op, hkey, hkey2);
+		res = TEE_SetOperationKey2(s->crypto_op, hkey, hkey2);
 		CHECK(res, "TEE_SetOperationKey2", return res;);
 
 		TEE_FreeTransientObject(hkey2);
 	} else {
-		res = TEE_SetOperationKey(crypto_op, hkey);
+		res = TEE_SetOperationKey(s->crypto_op, hkey);
 		CHECK(res, "TEE_SetOperationKey", return res;);
 	}
 
 	TEE_FreeTransientObject(hkey);
 
-	if (use_iv)
-		TEE_CipherInit(crypto_op, iv, sizeof(iv));
+	if (mode == TEE_MODE_MAC)
+		TEE_MACInit(s->crypto_op, NULL, 0);
+	else if (s->use_iv)
+		TEE_CipherInit(s->crypto_op, iv, sizeof(iv));
 	else
-		TEE_CipherInit(crypto_op, NULL, 0);
+		TEE_CipherInit(s->crypto_op, NULL, 0);
+
+	return TEE_SUCCESS;
+}
+
+/*
+ * Fill the output buffer with TEE_GenerateRandom(), params[2].value.a times.
+ * Takes the same parameters as cmd_process(), the input buffer is not used.
+ */
+TEE_Result cmd_random(uint32_t param_types, TEE_Param params[4])
+{
+	int n;
+	uint32_t exp_param_types = TEE_PARAM_TYPES(TEE_PARAM_TYPE_MEMREF_INOUT,
+						   TEE_PARAM_TYPE_MEMREF_INOUT,
+						   TEE_PARAM_TYPE_VALUE_INPUT,
+						   TEE_PARAM_TYPE_NONE);
+
+	if (param_types != exp_param_types)
+		return TEE_ERROR_BAD_PARAMETERS;
+
+	n = params[2].value.a;
+	while (n--)
+		TEE_GenerateRandom(params[1].memref.buffer,
+				   params[1].memref.size);
+	return TEE_SUCCESS;
+}
+
+/*
+ * Return the number of sessions opened on this instance, and the memory
+ * reserved for each instance (data and stack)
+ */
+TEE_Result cmd_get_info(struct aes_perf_session *s, uint32_t param_types,
+			TEE_Param params[4])
+{
+	uint32_t exp_param_types = TEE_PARAM_TYPES(TEE_PARAM_TYPE_VALUE_OUTPUT,
+						   TEE_PARAM_TYPE_NONE,
+						   TEE_PARAM_TYPE_NONE,
+						   TEE_PARAM_TYPE_NONE);
+	if (param_types != exp_param_types)
+		return TEE_ERROR_BAD_PARAMETERS;
 
+	params[0].value.a = s->single ? si_sessions : 1;
+	params[0].value.b = TA_DATA_SIZE + TA_STACK_SIZE;
 	return TEE_SUCCESS;
 }
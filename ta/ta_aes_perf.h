@@ -31,20 +31,91 @@
 #define TA_AES_PERF_UUID { 0xe626662e, 0xc0e2, 0x485c, \
 	{ 0xb8, 0xc8, 0x09, 0xfb, 0xce, 0x6e, 0xdf, 0x3d } }
 
+/* Single-instance, multi-session variant (CFG_TA_SINGLE_INSTANCE=y) */
+#define TA_AES_PERF_SI_UUID { 0x11c2aa48, 0xfd12, 0x485c, \
+	{ 0x82, 0x1f, 0xcd, 0x7c, 0xfa, 0xc0, 0xeb, 0xa5 } }
+
 /*
  * Commands implemented by the TA
  */
 
 #define TA_AES_PERF_CMD_PREPARE_KEY	0
 #define TA_AES_PERF_CMD_PROCESS		1
+#define TA_AES_PERF_CMD_GET_INFO	2
+#define TA_AES_PERF_CMD_PROCESS_COPY	3
+#define TA_AES_PERF_CMD_RANDOM		4
+#define TA_AES_PERF_CMD_STORAGE		5
+
+/*
+ * Flags of TA_AES_PERF_CMD_PROCESS (params[2].value.b). With
+ * TA_PROCESS_CANCELLABLE, ciphers unmask cancellation and check
+ * TEE_GetCancellationFlag() before each update; a cancelled invocation
+ * returns TEE_ERROR_CANCEL.
+ */
+
+#define TA_PROCESS_CANCELLABLE	(1 << 0)
 
 /*
- * Supported AES modes of operation
+ * Flags of TA_AES_PERF_CMD_PROCESS_COPY, returned in params[2].value.b along
+ * with the size of the working buffer. TA_COPY_COARSE: the stage times come
+ * from TEE_GetSystemTime(), which counts in milliseconds. TA_COPY_SATURATED:
+ * a stage time did not fit in 32 bits of ns and was capped.
+ */
+
+#define TA_COPY_COARSE		(1U << 31)
+#define TA_COPY_SATURATED	(1U << 30)
+#define TA_COPY_SIZE_MASK	(TA_COPY_SATURATED - 1)
+
+/*
+ * Secure storage operations (TA_AES_PERF_CMD_STORAGE), on one persistent
+ * object per session
+ */
+
+#define TA_STORAGE_CREATE	0
+#define TA_STORAGE_WRITE	1
+#define TA_STORAGE_READ		2
+#define TA_STORAGE_SEEK		3
+#define TA_STORAGE_TRUNCATE	4
+#define TA_STORAGE_DELETE	5
+
+/*
+ * Supported algorithms: AES modes of operation, digests and MACs
  */
 
 #define TA_AES_ECB	0
 #define TA_AES_CBC	1
 #define TA_AES_CTR	2
 #define TA_AES_XTS	3
+#define TA_SHA1		4
+#define TA_SHA256	5
+#define TA_SHA512	6
+#define TA_HMAC_SHA256	7
+#define TA_AES_CMAC	8
+#define TA_RSA_SIGN	9	/* RSASSA-PKCS1-v1_5 SHA-256 */
+#define TA_RSA_VERIFY	10
+#define TA_RSA_ENCRYPT	11	/* RSAES-OAEP SHA-256 */
+#define TA_RSA_DECRYPT	12
+#define TA_ECDSA_SIGN	13	/* P-256 or P-384 depending on the key size */
+#define TA_ECDSA_VERIFY	14
+#define TA_ECDH		15	/* P-256 */
+
+/*
+ * Keys and IV used by the TA. They are fixed so that the host can check the
+ * output against a reference implementation. TA_AES_PERF_KEY2 is the XTS
+ * tweak key.
+ */
+
+#define TA_AES_PERF_KEY { 0x00, 0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07, \
+			  0x08, 0x09, 0x0A, 0x0B, 0x0C, 0x0D, 0x0E, 0x0F, \
+			  0x10, 0x11, 0x12, 0x13, 0x14, 0x15, 0x16, 0x17, \
+			  0x18, 0x19, 0x1A, 0x1B, 0x1C, 0x1D, 0x1E, 0x1F }
+
+#define TA_AES_PERF_KEY2 { 0x20, 0x21, 0x22, 0x23, 0x24, 0x25, 0x26, 0x27, \
+			   0x28, 0x29, 0x2A, 0x2B, 0x2C, 0x2D, 0x2E, 0x2F, \
+			   0x30, 0x31, 0x32, 0x33, 0x34, 0x35, 0x36, 0x37, \
+			   0x38, 0x39, 0x3A, 0x3B, 0x3C, 0x3D, 0x3E, 0x3F }
+
+#define TA_AES_PERF_IV { 0xA0, 0xA1, 0xA2, 0xA3, 0xA4, 0xA5, 0xA6, 0xA7, \
+			 0xA8, 0xA9, 0xAA, 0xAB, 0xAC, 0xAD, 0xAE, 0xAF }
 
 #endif /* TA_AES_PERF_H */
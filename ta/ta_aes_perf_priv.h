@@ -30,7 +30,56 @@
 
 #include <tee_api.h>
 
-TEE_Result cmd_prepare_key(uint32_t param_types, TEE_Param params[4]);
-TEE_Result cmd_process(uint32_t param_types, TEE_Param params[4]);
+#define CHECK(res, name, action) do {			\
+		if ((res) != TEE_SUCCESS) {		\
+			DMSG(name ": 0x%08x", (res));	\
+			action				\
+		}					\
+	} while(0)
+
+/* Per-session state */
+struct aes_perf_session {
+	TEE_OperationHandle crypto_op;
+	uint32_t op_mode;	/* TEE_MODE_ENCRYPT, _DECRYPT, _MAC, _DIGEST */
+	int use_iv;
+	int final;		/* Digests/MACs: one message per loop */
+	void *buf;		/* Working buffer of cmd_process_copy() */
+	uint32_t buf_size;
+	int single;		/* Session of the single-instance variant */
+
+	/* Asymmetric operations (ta_asym.c) */
+	uint32_t alg;		/* TA_RSA_SIGN, ... or 0 */
+	TEE_ObjectHandle key;	/* Key pair generated by cmd_prepare_key() */
+	TEE_ObjectHandle secret;	/* ECDH: derived secret */
+	TEE_Attribute peer[2];	/* ECDH: public key of the peer */
+	uint8_t peer_x[48];
+	uint8_t peer_y[48];
+	uint8_t digest[48];	/* Digest to sign, or message to encrypt */
+	uint32_t digest_len;
+	uint8_t in[512];	/* Signature to verify, ciphertext to decrypt */
+	uint32_t in_len;
+	uint8_t out[512];
+
+	/* Secure storage (ta_storage.c) */
+	TEE_ObjectHandle obj;	/* Persistent object of cmd_storage() */
+};
+
+TEE_Result cmd_prepare_key(struct aes_perf_session *s, uint32_t param_types,
+			   TEE_Param params[4]);
+TEE_Result cmd_process(struct aes_perf_session *s, uint32_t param_types,
+		       TEE_Param params[4]);
+TEE_Result cmd_process_copy(struct aes_perf_session *s, uint32_t param_types,
+			    TEE_Param params[4]);
+TEE_Result cmd_random(uint32_t param_types, TEE_Param params[4]);
+TEE_Result cmd_storage(struct aes_perf_session *s, uint32_t param_types,
+		       TEE_Param params[4]);
+TEE_Result cmd_get_info(struct aes_perf_session *s, uint32_t param_types,
+			TEE_Param params[4]);
+
+TEE_Result prepare_asym(struct aes_perf_session *s, uint32_t alg,
+			uint32_t keysize);
+TEE_Result process_asym(struct aes_perf_session *s, int n);
+void free_asym(struct aes_perf_session *s);
+void free_storage(struct aes_perf_session *s);
 
 #endif /* TA_EAS_PERF_PRIV_H */
@@ -0,0 +1,262 @@
+/*
+ * Copyright (c) 2015, Linaro Limited
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * Asymmetric operations: RSA sign/verify/encrypt/decrypt, ECDSA sign/verify
+ * and ECDH key derivation. The key pair is generated once by
+ * cmd_prepare_key(), then cmd_process() repeats the operation on a fixed
+ * input; the memref parameters are not used.
+ */
+
+#include <tee_internal_api.h>
+#include <string.h>
+#include <trace.h>
+
+#include "ta_aes_perf.h"
+#include "ta_aes_perf_priv.h"
+
+static TEE_Result generate_key(uint32_t type, uint32_t keysize, uint32_t curve,
+			       TEE_ObjectHandle *key)
+{
+	TEE_Result res;
+	TEE_Attribute attr;
+
+	res = TEE_AllocateTransientObject(type, keysize, key);
+	CHECK(res, "TEE_AllocateTransientObject", return res;);
+	if (curve) {
+		TEE_InitValueAttribute(&attr, TEE_ATTR_ECC_CURVE, curve, 0);
+		res = TEE_GenerateKey(*key, keysize, &attr, 1);
+	} else {
+		res = TEE_GenerateKey(*key, keysize, NULL, 0);
+	}
+	CHECK(res, "TEE_GenerateKey", goto err;);
+	return TEE_SUCCESS;
+err:
+	TEE_FreeTransientObject(*key);
+	*key = TEE_HANDLE_NULL;
+	return res;
+}
+
+/* Sign or encrypt s->digest with a temporary operation, into s->in */
+static TEE_Result make_input(struct aes_perf_session *s, uint32_t algo,
+			     uint32_t mode, uint32_t keysize)
+{
+	TEE_Result res;
+	TEE_OperationHandle op;
+
+	res = TEE_AllocateOperation(&op, algo, mode, keysize);
+	CHECK(res, "TEE_AllocateOperation", return res;);
+	res = TEE_SetOperationKey(op, s->key);
+	CHECK(res, "TEE_SetOperationKey", goto out;);
+	s->in_len = sizeof(s->in);
+	if (mode == TEE_MODE_SIGN)
+		res = TEE_AsymmetricSignDigest(op, NULL, 0, s->digest,
+					       s->digest_len, s->in,
+					       &s->in_len);
+	else
+		res = TEE_AsymmetricEncrypt(op, NULL, 0, s->digest,
+					    s->digest_len, s->in, &s->in_len);
+	CHECK(res, "TEE_Asymmetric{SignDigest,Encrypt}", goto out;);
+out:
+	TEE_FreeOperation(op);
+	return res;
+}
+
+/* Generate the key pair of the peer and keep its public value */
+static TEE_Result make_peer(struct aes_perf_session *s, uint32_t keysize)
+{
+	TEE_Result res;
+	TEE_ObjectHandle peer;
+	uint32_t x_len = sizeof(s->peer_x);
+	uint32_t y_len = sizeof(s->peer_y);
+
+	res = generate_key(TEE_TYPE_ECDH_KEYPAIR, keysize,
+			   TEE_ECC_CURVE_NIST_P256, &peer);
+	if (res != TEE_SUCCESS)
+		return res;
+	res = TEE_GetObjectBufferAttribute(peer, TEE_ATTR_ECC_PUBLIC_VALUE_X,
+					   s->peer_x, &x_len);
+	CHECK(res, "TEE_GetObjectBufferAttribute", goto out;);
+	res = TEE_GetObjectBufferAttribute(peer, TEE_ATTR_ECC_PUBLIC_VALUE_Y,
+					   s->peer_y, &y_len);
+	CHECK(res, "TEE_GetObjectBufferAttribute", goto out;);
+	TEE_InitRefAttribute(&s->peer[0], TEE_ATTR_ECC_PUBLIC_VALUE_X,
+			     s->peer_x, x_len);
+	TEE_InitRefAttribute(&s->peer[1], TEE_ATTR_ECC_PUBLIC_VALUE_Y,
+			     s->peer_y, y_len);
+	res = TEE_AllocateTransientObject(TEE_TYPE_GENERIC_SECRET, keysize,
+					  &s->secret);
+	CHECK(res, "TEE_AllocateTransientObject", goto out;);
+out:
+	TEE_FreeTransientObject(peer);
+	return res;
+}
+
+void free_asym(struct aes_perf_session *s)
+{
+	if (s->key)
+		TEE_FreeTransientObject(s->key);
+	if (s->secret)
+		TEE_FreeTransientObject(s->secret);
+	s->key = TEE_HANDLE_NULL;
+	s->secret = TEE_HANDLE_NULL;
+	s->alg = 0;
+}
+
+/* keysize is the RSA modulus or ECC curve size in bits */
+TEE_Result prepare_asym(struct aes_perf_session *s, uint32_t alg,
+			uint32_t keysize)
+{
+	TEE_Result res;
+	uint32_t algo;
+	uint32_t mode;
+	uint32_t type;
+	uint32_t curve = 0;
+
+	switch (alg) {
+	case TA_RSA_SIGN:
+	case TA_RSA_VERIFY:
+		algo = TEE_ALG_RSASSA_PKCS1_V1_5_SHA256;
+		mode = alg == TA_RSA_SIGN ? TEE_MODE_SIGN : TEE_MODE_VERIFY;
+		type = TEE_TYPE_RSA_KEYPAIR;
+		break;
+	case TA_RSA_ENCRYPT:
+	case TA_RSA_DECRYPT:
+		algo = TEE_ALG_RSAES_PKCS1_OAEP_MGF1_SHA256;
+		mode = alg == TA_RSA_ENCRYPT ? TEE_MODE_ENCRYPT :
+					       TEE_MODE_DECRYPT;
+		type = TEE_TYPE_RSA_KEYPAIR;
+		break;
+	case TA_ECDSA_SIGN:
+	case TA_ECDSA_VERIFY:
+		if (keysize == 256) {
+			algo = TEE_ALG_ECDSA_P256;
+			curve = TEE_ECC_CURVE_NIST_P256;
+		} else if (keysize == 384) {
+			algo = TEE_ALG_ECDSA_P384;
+			curve = TEE_ECC_CURVE_NIST_P384;
+		} else {
+			return TEE_ERROR_NOT_SUPPORTED;
+		}
+		mode = alg == TA_ECDSA_SIGN ? TEE_MODE_SIGN : TEE_MODE_VERIFY;
+		type = TEE_TYPE_ECDSA_KEYPAIR;
+		break;
+	case TA_ECDH:
+		if (keysize != 256)
+			return TEE_ERROR_NOT_SUPPORTED;
+		algo = TEE_ALG_ECDH_P256;
+		mode = TEE_MODE_DERIVE;
+		type = TEE_TYPE_ECDH_KEYPAIR;
+		curve = TEE_ECC_CURVE_NIST_P256;
+		break;
+	default:
+		return TEE_ERROR_BAD_PARAMETERS;
+	}
+
+	free_asym(s);
+	/* SHA-256 sized, or SHA-384 for P-384 */
+	s->digest_len = keysize == 384 ? 48 : 32;
+	memset(s->digest, 0xA5, s->digest_len);
+
+	res = generate_key(type, keysize, curve, &s->key);
+	if (res != TEE_SUCCESS)
+		goto err;
+
+	if (mode == TEE_MODE_VERIFY)
+		res = make_input(s, algo, TEE_MODE_SIGN, keysize);
+	else if (mode == TEE_MODE_DECRYPT)
+		res = make_input(s, algo, TEE_MODE_ENCRYPT, keysize);
+	else if (mode == TEE_MODE_DERIVE)
+		res = make_peer(s, keysize);
+	if (res != TEE_SUCCESS)
+		goto err;
+
+	res = TEE_AllocateOperation(&s->crypto_op, algo, mode, keysize);
+	CHECK(res, "TEE_AllocateOperation", goto err;);
+	res = TEE_SetOperationKey(s->crypto_op, s->key);
+	CHECK(res, "TEE_SetOperationKey", goto err;);
+	s->alg = alg;
+	return TEE_SUCCESS;
+err:
+	if (s->crypto_op) {
+		TEE_FreeOperation(s->crypto_op);
+		s->crypto_op = TEE_HANDLE_NULL;
+	}
+	free_asym(s);
+	return res;
+}
+
+TEE_Result process_asym(struct aes_perf_session *s, int n)
+{
+	TEE_Result res = TEE_SUCCESS;
+	uint32_t len;
+
+	while (n--) {
+		len = sizeof(s->out);
+		switch (s->alg) {
+		case TA_RSA_SIGN:
+		case TA_ECDSA_SIGN:
+			res = TEE_AsymmetricSignDigest(s->crypto_op, NULL, 0,
+						       s->digest,
+						       s->digest_len, s->out,
+						       &len);
+			break;
+		case TA_RSA_VERIFY:
+		case TA_ECDSA_VERIFY:
+			res = TEE_AsymmetricVerifyDigest(s->crypto_op, NULL, 0,
+							 s->digest,
+							 s->digest_len, s->in,
+							 s->in_len);
+			break;
+		case TA_RSA_ENCRYPT:
+			res = TEE_AsymmetricEncrypt(s->crypto_op, NULL, 0,
+						    s->digest, s->digest_len,
+						    s->out, &len);
+			break;
+		case TA_RSA_DECRYPT:
+			res = TEE_AsymmetricDecrypt(s->crypto_op, NULL, 0,
+						    s->in, s->in_len, s->out,
+						    &len);
+			break;
+		case TA_ECDH:
+			/* The derived key object must be empty */
+			TEE_ResetTransientObject(s->secret);
+			TEE_DeriveKey(s->crypto_op, s->peer, 2, s->secret);
+			/* No result: check that the secret was set */
+			res = TEE_GetObjectBufferAttribute(s->secret,
+					TEE_ATTR_SECRET_VALUE, s->out, &len);
+			if (res == TEE_SUCCESS &&
+			    len != s->peer[0].content.ref.length)
+				res = TEE_ERROR_GENERIC;
+			break;
+		default:
+			return TEE_ERROR_BAD_STATE;
+		}
+		CHECK(res, "asymmetric operation", return res;);
+	}
+	return TEE_SUCCESS;
+}
@@ -0,0 +1,140 @@
+/*
+ * Copyright (c) 2015, Linaro Limited
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * Secure storage: each invocation of cmd_storage() performs one operation on
+ * a persistent object private to the session, so that the host can time the
+ * create, write, read, seek, truncate and delete paths (and the round trips
+ * to tee-supplicant behind them) individually.
+ */
+
+#include <tee_internal_api.h>
+#include <string.h>
+#include <trace.h>
+
+#include "ta_aes_perf.h"
+#include "ta_aes_perf_priv.h"
+
+#define OBJ_FLAGS	(TEE_DATA_FLAG_ACCESS_READ | \
+			 TEE_DATA_FLAG_ACCESS_WRITE | \
+			 TEE_DATA_FLAG_ACCESS_WRITE_META | \
+			 TEE_DATA_FLAG_OVERWRITE)
+
+/* The object ID includes the session so that sessions do not collide */
+struct obj_id {
+	char name[8];
+	struct aes_perf_session *s;
+};
+
+static TEE_Result create_object(struct aes_perf_session *s)
+{
+	struct obj_id id;
+
+	if (s->obj)
+		return TEE_ERROR_BAD_STATE;
+	memset(&id, 0, sizeof(id));
+	memcpy(id.name, "aesperf", 7);
+	id.s = s;
+	return TEE_CreatePersistentObject(TEE_STORAGE_PRIVATE, &id, sizeof(id),
+					  OBJ_FLAGS, TEE_HANDLE_NULL, NULL, 0,
+					  &s->obj);
+}
+
+/*
+ * params[0].value.a: operation (TA_STORAGE_CREATE, ...), params[0].value.b:
+ * offset for TA_STORAGE_WRITE, _READ and _SEEK, new size for
+ * TA_STORAGE_TRUNCATE. params[1]: data written or read. Returned: number of
+ * bytes read (params[2].value.a).
+ */
+TEE_Result cmd_storage(struct aes_perf_session *s, uint32_t param_types,
+		       TEE_Param params[4])
+{
+	TEE_Result res;
+	uint32_t op;
+	uint32_t arg;
+	uint32_t count = 0;
+	uint32_t exp_param_types = TEE_PARAM_TYPES(TEE_PARAM_TYPE_VALUE_INPUT,
+						   TEE_PARAM_TYPE_MEMREF_INOUT,
+						   TEE_PARAM_TYPE_VALUE_OUTPUT,
+						   TEE_PARAM_TYPE_NONE);
+
+	if (param_types != exp_param_types)
+		return TEE_ERROR_BAD_PARAMETERS;
+
+	op = params[0].value.a;
+	arg = params[0].value.b;
+	if (op == TA_STORAGE_CREATE) {
+		res = create_object(s);
+		CHECK(res, "TEE_CreatePersistentObject", return res;);
+		return TEE_SUCCESS;
+	}
+	if (!s->obj)
+		return TEE_ERROR_BAD_STATE;
+
+	switch (op) {
+	case TA_STORAGE_WRITE:
+		res = TEE_SeekObjectData(s->obj, arg, TEE_DATA_SEEK_SET);
+		CHECK(res, "TEE_SeekObjectData", return res;);
+		res = TEE_WriteObjectData(s->obj, params[1].memref.buffer,
+					  params[1].memref.size);
+		CHECK(res, "TEE_WriteObjectData", return res;);
+		break;
+	case TA_STORAGE_READ:
+		res = TEE_SeekObjectData(s->obj, arg, TEE_DATA_SEEK_SET);
+		CHECK(res, "TEE_SeekObjectData", return res;);
+		res = TEE_ReadObjectData(s->obj, params[1].memref.buffer,
+					 params[1].memref.size, &count);
+		CHECK(res, "TEE_ReadObjectData", return res;);
+		break;
+	case TA_STORAGE_SEEK:
+		res = TEE_SeekObjectData(s->obj, arg, TEE_DATA_SEEK_SET);
+		CHECK(res, "TEE_SeekObjectData", return res;);
+		break;
+	case TA_STORAGE_TRUNCATE:
+		res = TEE_TruncateObjectData(s->obj, arg);
+		CHECK(res, "TEE_TruncateObjectData", return res;);
+		break;
+	case TA_STORAGE_DELETE:
+		TEE_CloseAndDeletePersistentObject(s->obj);
+		s->obj = TEE_HANDLE_NULL;
+		break;
+	default:
+		return TEE_ERROR_BAD_PARAMETERS;
+	}
+
+	params[2].value.a = count;
+	return TEE_SUCCESS;
+}
+
+/* Delete the object if the host did not */
+void free_storage(struct aes_perf_session *s)
+{
+	if (s->obj) {
+		TEE_CloseAndDeletePersistentObject(s->obj);
+		s->obj = TEE_HANDLE_NULL;
+	}
+}
@@ -30,9 +30,17 @@
 
 #include "ta_aes_perf.h"
 
+#ifdef CFG_TA_SINGLE_INSTANCE
+#define TA_UUID TA_AES_PERF_SI_UUID
+
+#define TA_FLAGS		(TA_FLAG_USER_MODE | TA_FLAG_EXEC_DDR | \
+				 TA_FLAG_SINGLE_INSTANCE | \
+				 TA_FLAG_MULTI_SESSION)
+#else
 #define TA_UUID TA_AES_PERF_UUID
 
 #define TA_FLAGS		(TA_FLAG_USER_MODE | TA_FLAG_EXEC_DDR)
+#endif
 #define TA_STACK_SIZE		(2 * 1024)
 #define TA_DATA_SIZE		(32 * 1024)
 